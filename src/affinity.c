@@ -0,0 +1,366 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "affinity.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| thread and rank affinity from the /sys topology. The cpus a rank may run
+| on (sched_getaffinity, i.e. after any binding by mpirun) are classified 
+| by package, NUMA node, L3 domain, core and SMT sibling index. 
+|
+| compact: the physical cores (first SMT sibling) of the node, ordered by
+| package, NUMA node, L3 domain and core, are cut into contiguous blocks 
+| per node local rank. If mpirun already restricted the rank to a subset
+| of the node, the rank keeps that subset. Thread t of a rank is pinned to
+| the t-th core of its block, SMT siblings of the block follow the cores.
+|
+| A core (PROGRESS_CORE) or the SMT sibling of a core (PROGRESS_SMT) of 
+| the block can be reserved for a communication progress thread, 
+| see get_progress_cpu.
+----------------------------------------------------------------------------*/
+
+#define MAX_NUMA_NODES 64
+
+typedef struct
+{
+  int cpu;
+  int package;
+  int node;
+  int l3;
+  int core;
+  int smt;
+} hw_thread;
+
+static int progress_cpu = -1;
+
+
+const char* affinity_name(int mode)
+{
+  switch (mode)
+    {
+    case AFFINITY_COMPACT:
+      return "compact";
+    default:
+      return "off";
+    }
+}
+
+const char* progress_name(int progress)
+{
+  switch (progress)
+    {
+    case PROGRESS_CORE:
+      return "core";
+    case PROGRESS_SMT:
+      return "smt";
+    default:
+      return "none";
+    }
+}
+
+int get_progress_cpu(void)
+{
+  return progress_cpu;
+}
+
+
+/* first integer of a sysfs file (also the first cpu of a cpu list) */
+static int read_sys_int(const char *fmt, int i, int j, int def)
+{
+  char fname[128];
+  int val = def;
+  snprintf(fname, sizeof(fname), fmt, i, j);
+  FILE *fp = fopen(fname, "r");
+  if (fp != NULL)
+    {
+      if (fscanf(fp, "%d", &val) != 1)
+	{
+	  val = def;
+	}
+      fclose(fp);
+    }
+  return val;
+}
+
+static void read_topology(hw_thread *hw, int cpu)
+{
+  char fname[128];
+  int n, k;
+
+  hw->cpu = cpu;
+  hw->package = read_sys_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id"
+			     , cpu, 0, 0);
+  hw->core = read_sys_int("/sys/devices/system/cpu/cpu%d/topology/core_id"
+			  , cpu, 0, cpu);
+
+  hw->node = 0;
+  for (n = 0; n < MAX_NUMA_NODES; n++)
+    {
+      snprintf(fname, sizeof(fname), "/sys/devices/system/cpu/cpu%d/node%d", cpu, n);
+      if (f_exist(fname))
+	{
+	  hw->node = n;
+	  break;
+	}
+    }
+
+  /* L3 domain by its first cpu, the package without L3 info */
+  hw->l3 = -1;
+  for (k = 0; k < 8 && hw->l3 < 0; k++)
+    {
+      if (read_sys_int("/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, k, 0) == 3)
+	{
+	  hw->l3 = read_sys_int("/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list"
+				, cpu, k, -1);
+	}
+    }
+  if (hw->l3 < 0)
+    {
+      hw->l3 = hw->package;
+    }
+  hw->smt = 0;
+}
+
+static int cmp_hw_thread(const void *a, const void *b)
+{
+  const hw_thread *x = (const hw_thread *) a;
+  const hw_thread *y = (const hw_thread *) b;
+  if (x->package != y->package)
+    {
+      return x->package - y->package;
+    }
+  if (x->node != y->node)
+    {
+      return x->node - y->node;
+    }
+  if (x->l3 != y->l3)
+    {
+      return x->l3 - y->l3;
+    }
+  if (x->core != y->core)
+    {
+      return x->core - y->core;
+    }
+  return x->cpu - y->cpu;
+}
+
+
+static void pin_to_cpu(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  ASSERT(sched_setaffinity(0, sizeof(set), &set) == 0);
+}
+
+
+static void print_affinity(comm_data *cd
+			   , int nthreads
+			   , const int *thread_cpu
+			   , const int *thread_node
+			   )
+{
+  int *all_cpu = NULL, *all_node = NULL, *all_progress = NULL;
+  int r, t;
+
+  if (cd->iProc == 0)
+    {
+      all_cpu = check_malloc(cd->nProc * nthreads * sizeof(int));
+      all_node = check_malloc(cd->nProc * nthreads * sizeof(int));
+      all_progress = check_malloc(cd->nProc * sizeof(int));
+    }
+  MPI_Gather((void *) thread_cpu, nthreads, MPI_INT
+	     , all_cpu, nthreads, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Gather((void *) thread_node, nthreads, MPI_INT
+	     , all_node, nthreads, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Gather(&progress_cpu, 1, MPI_INT
+	     , all_progress, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (cd->iProc == 0)
+    {
+      for (r = 0; r < cd->nProc; r++)
+	{
+	  printf("rank %6d cpu/node:", r);
+	  for (t = 0; t < nthreads; t++)
+	    {
+	      printf(" %d/%d", all_cpu[r * nthreads + t], all_node[r * nthreads + t]);
+	    }
+	  if (all_progress[r] >= 0)
+	    {
+	      printf(" progress: %d", all_progress[r]);
+	    }
+	  printf("\n");
+	}
+      check_free(all_cpu);
+      check_free(all_node);
+      check_free(all_progress);
+    }
+}
+
+
+void init_affinity(comm_data *cd
+		   , int nthreads
+		   , int mode
+		   , int progress
+		   )
+{
+  cpu_set_t allowed;
+  int i, j, k;
+
+  if (mode == AFFINITY_OFF)
+    {
+      return;
+    }
+
+  /* node local rank */
+  MPI_Comm node_comm;
+  int node_rank, node_size;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, cd->iProc
+		      , MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+  MPI_Comm_free(&node_comm);
+
+  /* allowed cpus, classified */
+  CPU_ZERO(&allowed);
+  ASSERT(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+  const int ncpus = CPU_COUNT(&allowed);
+  hw_thread *hw = check_malloc(ncpus * sizeof(hw_thread));
+  int n = 0;
+  for (i = 0; i < CPU_SETSIZE && n < ncpus; i++)
+    {
+      if (CPU_ISSET(i, &allowed))
+	{
+	  read_topology(&hw[n++], i);
+	}
+    }
+  qsort(hw, n, sizeof(hw_thread), cmp_hw_thread);
+
+  /* SMT sibling index within the core, number of cores */
+  int ncores = 0;
+  for (i = 0; i < n; i++)
+    {
+      if (i > 0 && hw[i].package == hw[i-1].package && hw[i].core == hw[i-1].core)
+	{
+	  hw[i].smt = hw[i-1].smt + 1;
+	}
+      else
+	{
+	  ncores++;
+	}
+    }
+  int *core_first = check_malloc((ncores + 1) * sizeof(int));
+  for (i = 0, k = 0; i < n; i++)
+    {
+      if (hw[i].smt == 0)
+	{
+	  core_first[k++] = i;
+	}
+    }
+  core_first[ncores] = n;
+
+  /* block of cores of this rank. A rank restricted by mpirun keeps 
+     its subset */
+  const long nonline = sysconf(_SC_NPROCESSORS_ONLN);
+  int c0 = 0, c1 = ncores;
+  if (ncpus >= nonline && node_size > 1 && ncores >= node_size)
+    {
+      c0 = (node_rank * ncores) / node_size;
+      c1 = ((node_rank + 1) * ncores) / node_size;
+    }
+
+  /* reserve for progress */
+  progress_cpu = -1;
+  if (progress == PROGRESS_SMT && c1 > c0)
+    {
+      const int c = c1 - 1;
+      if (core_first[c + 1] - core_first[c] > 1)
+	{
+	  progress_cpu = hw[core_first[c + 1] - 1].cpu;
+	}
+      else
+	{
+	  progress = PROGRESS_CORE;
+	}
+    }
+  if (progress == PROGRESS_CORE && c1 - c0 > 1)
+    {
+      progress_cpu = hw[core_first[c1 - 1]].cpu;
+      c1--;
+    }
+
+  /* cores of the block first, then SMT siblings */
+  int *cpu_list = check_malloc(n * sizeof(int));
+  int *node_list = check_malloc(n * sizeof(int));
+  int ncpu_list = 0, smt;
+  for (smt = 0; smt < n; smt++)
+    {
+      int found = 0;
+      for (j = c0; j < c1; j++)
+	{
+	  i = core_first[j] + smt;
+	  if (i < core_first[j + 1] && hw[i].cpu != progress_cpu)
+	    {
+	      cpu_list[ncpu_list] = hw[i].cpu;
+	      node_list[ncpu_list] = hw[i].node;
+	      ncpu_list++;
+	      found = 1;
+	    }
+	}
+      if (!found)
+	{
+	  break;
+	}
+    }
+  ASSERT(ncpu_list > 0);
+
+  int *thread_cpu = check_malloc(nthreads * sizeof(int));
+  int *thread_node = check_malloc(nthreads * sizeof(int));
+  for (i = 0; i < nthreads; i++)
+    {
+      thread_cpu[i] = cpu_list[i % ncpu_list];
+      thread_node[i] = node_list[i % ncpu_list];
+    }
+
+#pragma omp parallel default (none) shared(thread_cpu, stderr)
+  {
+    pin_to_cpu(thread_cpu[omp_get_thread_num()]);
+  }
+
+  if (cd->iProc == 0)
+    {
+      printf("affinity: %s progress: %s ranks per node: %d rank 0: cpus: %d cores: %d pinned cpus: %d\n"
+	     , affinity_name(mode), progress_name((progress_cpu >= 0) ? progress : PROGRESS_NONE)
+	     , node_size, n, ncores, ncpu_list);
+    }
+  print_affinity(cd, nthreads, thread_cpu, thread_node);
+
+  check_free(thread_node);
+  check_free(thread_cpu);
+  check_free(node_list);
+  check_free(cpu_list);
+  check_free(core_first);
+  check_free(hw);
+}
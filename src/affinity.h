@@ -0,0 +1,28 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "comm_data.h"
+
+#define AFFINITY_OFF     0
+#define AFFINITY_COMPACT 1
+
+#define PROGRESS_NONE 0
+#define PROGRESS_CORE 1
+#define PROGRESS_SMT  2
+
+/* pin the OpenMP threads of this rank, print the map. Requires 
+   init_communication and omp_set_num_threads(nthreads) */
+void init_affinity(comm_data *cd
+		   , int nthreads
+		   , int mode
+		   , int progress
+		   );
+
+/* cpu reserved for communication progress, -1 if none */
+int get_progress_cpu(void);
+
+const char* affinity_name(int mode);
+
+const char* progress_name(int progress);
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "autotune.h"
+#include "gradients.h"
+#include "rangelist.h"
+#include "numa.h"
+#include "barrier.h"
+#include "error_handling.h"
+#include "util.h"
+
+/*----------------------------------------------------------------------------
+| color size autotuning. The candidates are derived from the L1d/L2 sizes
+| in /sys/devices/system/cpu/cpu0/cache and an estimate of the bytes per 
+| face in a color (face data plus var/grad/pvolume of the points of color). 
+| For every candidate the thread rangelist is rebuilt and the comm free 
+| gradients are timed, the fastest (max over ranks) is kept.
+|
+| thread balance refinement. Every thread times its own colors without 
+| barriers, time per modelled cost (get_thread_cost) gives a rate per 
+| thread, relative to the mean. The thread split is redone with these 
+| rates (rebalance_threads) and timed again.
+----------------------------------------------------------------------------*/
+
+#define MAX_CANDIDATES 16
+#define MIN_COLOR_SIZE 16
+#define MAX_COLOR_SIZE 8192
+#define N_TUNE 3
+
+/* fallback without sysfs cache info */
+static const int default_candidates[] = { 32, 64, 96, 128, 256, 512, 1024 };
+
+/* size in bytes of the given cache level/type of cpu0, 0 if unknown */
+static long read_cache_size(int level, const char *type)
+{
+  int i;
+  for (i = 0; i < 16; i++)
+    {
+      char fname[128], buf[64];
+      int lvl = -1;
+      long size = 0;
+      FILE *fp;
+
+      sprintf(fname, "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+      if ((fp = fopen(fname, "r")) == NULL)
+	{
+	  break;
+	}
+      if (fscanf(fp, "%d", &lvl) != 1)
+	{
+	  lvl = -1;
+	}
+      fclose(fp);
+      if (lvl != level)
+	{
+	  continue;
+	}
+
+      sprintf(fname, "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+      if ((fp = fopen(fname, "r")) == NULL)
+	{
+	  continue;
+	}
+      buf[0] = '\0';
+      if (fscanf(fp, "%63s", buf) != 1 || 
+	  (strcmp(buf, type) != 0 && strcmp(buf, "Unified") != 0))
+	{
+	  fclose(fp);
+	  continue;
+	}
+      fclose(fp);
+
+      sprintf(fname, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+      if ((fp = fopen(fname, "r")) == NULL)
+	{
+	  continue;
+	}
+      buf[0] = '\0';
+      if (fscanf(fp, "%63s", buf) == 1)
+	{
+	  char *unit;
+	  size = strtol(buf, &unit, 10);
+	  if (*unit == 'K')
+	    {
+	      size *= 1024;
+	    }
+	  else if (*unit == 'M')
+	    {
+	      size *= 1024 * 1024;
+	    }
+	}
+      fclose(fp);
+      return size;
+    }
+  return 0;
+}
+
+/* bytes touched per face in a color, from the current rangelist */
+static double bytes_per_face(solver_data *sd)
+{
+  long nfaces = 0, npoints = 0;
+
+#pragma omp parallel default (none) reduction(+:nfaces, npoints)
+  {
+    RangeList *color;
+    for (color = get_color(); color != NULL; color = get_next_color(color)) 
+      {
+	nfaces += color->stop - color->start;
+	npoints += color->nall_points_of_color;
+      }
+  }
+
+  const double face_bytes = 2 * sizeof(int) + 3 * sizeof(double);
+  const double point_bytes = (sd->var_dim + sd->grad_dim + 1) * sizeof(double);
+  return face_bytes + point_bytes * (double) npoints / MAX(nfaces, 1);
+}
+
+static int add_candidate(int *candidates, int ncandidates, int size)
+{
+  int i;
+  size = MAX(MIN_COLOR_SIZE, MIN(MAX_COLOR_SIZE, (size / 8) * 8));
+  for (i = 0; i < ncandidates; i++)
+    {
+      if (candidates[i] == size)
+	{
+	  return ncandidates;
+	}
+    }
+  ASSERT(ncandidates < MAX_CANDIDATES);
+  for (i = ncandidates; i > 0 && candidates[i - 1] > size; i--)
+    {
+      candidates[i] = candidates[i - 1];
+    }
+  candidates[i] = size;
+  return ncandidates + 1;
+}
+
+/* median time of the comm free gradients, max over all ranks */
+static double time_comm_free(solver_data *sd)
+{
+  int k;
+  double time, median[N_TUNE], gtime;
+
+  for (k = 0; k < N_TUNE; ++k)
+    {
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+#pragma omp parallel default (none) shared(sd)
+      {
+	int i;
+	for (i = 0; i < sd->niter; ++i)
+	  {
+	    compute_gradients_gg_comm_free(sd);
+	  }
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[k] = time;
+    }
+  sort_median(&median[0], &median[N_TUNE-1]);
+
+  MPI_Allreduce(&median[N_TUNE/2], &gtime, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return gtime;
+}
+
+static void set_color_size(comm_data *cd
+			   , solver_data *sd
+			   , int color_size
+			   )
+{
+  if (color_size != get_faces_in_color())
+    {
+      rebuild_threads(cd, sd, color_size);
+      set_color_kernels();
+    }
+}
+
+
+void tune_color_size(comm_data *cd
+		     , solver_data *sd
+		     , int color_size
+		     )
+{
+  int i, ncandidates = 0;
+  int candidates[MAX_CANDIDATES];
+
+  if (color_size != COLOR_SIZE_AUTO)
+    {
+      set_color_size(cd, sd, color_size);
+      if (cd->iProc == 0)
+	{
+	  printf("color size: %d faces\n", get_faces_in_color());
+	  fflush(stdout);
+	}
+      return;
+    }
+
+  /* candidates */
+  const long l1 = read_cache_size(1, "Data");
+  const long l2 = read_cache_size(2, "Data");
+  const double bpf = bytes_per_face(sd);
+
+  ncandidates = add_candidate(candidates, ncandidates, get_faces_in_color());
+  if (l1 > 0 && l2 > 0)
+    {
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l1 / 4 / bpf));
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l1 / 2 / bpf));
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l1 / bpf));
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l2 / 8 / bpf));
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l2 / 4 / bpf));
+      ncandidates = add_candidate(candidates, ncandidates, (int) (l2 / 2 / bpf));
+    }
+  else
+    {
+      for (i = 0; i < (int) (sizeof(default_candidates) / sizeof(int)); i++)
+	{
+	  ncandidates = add_candidate(candidates, ncandidates, default_candidates[i]);
+	}
+    }
+
+  if (cd->iProc == 0)
+    {
+      printf("color size: L1d %ldK L2 %ldK, %.1f bytes per face\n"
+	     , l1 / 1024, l2 / 1024, bpf);
+      fflush(stdout);
+    }
+
+  /* time candidates */
+  int best = get_faces_in_color();
+  double tbest = -1.0;
+  for (i = 0; i < ncandidates; i++)
+    {
+      set_color_size(cd, sd, candidates[i]);
+      const double time = time_comm_free(sd);
+      if (tbest < 0.0 || time < tbest)
+	{
+	  tbest = time;
+	  best = candidates[i];
+	}
+      if (cd->iProc == 0)
+	{
+	  printf("color size: %6d faces comm_free: %10.6f\n", candidates[i], time);
+	  fflush(stdout);
+	}
+    }
+
+  set_color_size(cd, sd, best);
+  if (cd->iProc == 0)
+    {
+      printf("color size: %d faces (autotuned)\n", best);
+      fflush(stdout);
+    }
+}
+
+
+/* one sweep over the own colors, returns the compute time of the thread. 
+   The reduce colors read the cross slots of the neighbor threads, which 
+   are zeroed by the next cross pass: syncs after the cross pass and the 
+   colors (compute_cross_faces), not timed */
+static double time_sweep(solver_data *sd)
+{
+  RangeList *color;
+  double t = -now();
+  compute_gradients_gg_cross(sd);
+  t += now();
+  thread_sync(0);
+
+  t -= now();
+  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+    {
+      color->kernel(color, sd);
+    }
+  t += now();
+  thread_sync(0);
+  return t;
+}
+
+/* sweeps over the own colors per thread, the time without waits. The 
+   cross faces computed once are timed with their writer */
+static void time_threads(solver_data *sd, double *time)
+{
+#pragma omp parallel default (none) shared(sd, time)
+  {
+    int i;
+    double t = 0.0;
+
+    /* warm up */
+    time_sweep(sd);
+    for (i = 0; i < sd->niter; ++i)
+      {
+	t += time_sweep(sd);
+      }
+    time[omp_get_thread_num()] = t;
+  }
+}
+
+
+void tune_thread_balance(comm_data *cd
+			 , solver_data *sd
+			 )
+{
+  const int nthreads = omp_get_max_threads();
+  double limb[2], gimb[2];
+  int i, n = 0;
+
+  if (get_balance_mode() != BALANCE_MEASURED)
+    {
+      return;
+    }
+
+  double *time = check_malloc(nthreads * sizeof(double));
+  double *cost = check_malloc(nthreads * sizeof(double));
+  double *rate = check_malloc(nthreads * sizeof(double));
+
+  time_threads(sd, time);
+  limb[0] = thread_imbalance(time, nthreads);
+
+  /* time per modelled cost, relative to the mean */
+  get_thread_cost(sd, get_thread_pid(), nthreads, cost);
+  double mean = 0.0;
+  for (i = 0; i < nthreads; i++)
+    {
+      rate[i] = (cost[i] > 0.0) ? time[i] / cost[i] : 0.0;
+      if (cost[i] > 0.0)
+	{
+	  mean += rate[i];
+	  n++;
+	}
+    }
+  mean /= MAX(n, 1);
+  for (i = 0; i < nthreads; i++)
+    {
+      rate[i] = (cost[i] > 0.0 && mean > 0.0) ? rate[i] / mean : 1.0;
+    }
+
+  rebalance_threads(cd, sd, rate);
+  set_color_kernels();
+  place_point_data(sd);
+
+  time_threads(sd, time);
+  limb[1] = thread_imbalance(time, nthreads);
+
+  MPI_Allreduce(limb, gimb, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  if (cd->iProc == 0)
+    {
+      printf("          thread time imbalance before: %10.3f\n", gimb[0]);
+      printf("           thread time imbalance after: %10.3f\n", gimb[1]);
+      fflush(stdout);
+    }
+
+  check_free(time);
+  check_free(cost);
+  check_free(rate);
+}
@@ -0,0 +1,21 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+/* -color_size auto */
+#define COLOR_SIZE_AUTO 0
+
+void tune_color_size(comm_data *cd
+		     , solver_data *sd
+		     , int color_size
+		     );
+
+/* -balance measured: per thread times of the own colors, the thread 
+   split is rebuilt with the measured cost rates */
+void tune_thread_balance(comm_data *cd
+			 , solver_data *sd
+			 );
+
+#endif
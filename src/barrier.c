@@ -0,0 +1,528 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <omp.h>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "barrier.h"
+#include "threads.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| thread barriers and elections. The central mode is the original scheme:
+| all threads count on one shared counter (this_is_the_first_thread, 
+| this_is_the_last_thread in threads.c) and meet in an omp barrier. 
+|
+| The tree mode replaces the shared counter by a combining tree with the 
+| levels thread group (at most BARRIER_RADIX threads of one NUMA node), 
+| NUMA node and rank. A thread counts at its group, only the last (first)
+| one of a group climbs to the node and from there to the rank level, 
+| the cross-socket traffic is one counter update per node. The barrier 
+| releases top down through the same nodes, every thread spins on the 
+| release flag of its own group.
+|
+| The dissemination mode ranks the threads by NUMA node, round r signals 
+| the rank 2^r ahead. The first rounds stay within a node. Its elections 
+| are the tree elections.
+|
+| The neighbor mode ends a sweep (thread_sync) with point-to-point 
+| progress flags instead of a barrier: a thread publishes its sweep 
+| count and waits for the threads whose points its cross faces (ftype 2/3)
+| touch. After a halo exchange the threads which write send or halo points
+| also wait for all others, the elected thread of the exchange may still 
+| pack or unpack these points. All other threads do not touch them and 
+| start the next sweep early. Barriers and elections are the tree ones.
+|
+| Counters only grow, round e of a node is complete at e * fanin 
+| arrivals. An election waits until the previous round of a node is 
+| complete before it counts, as the central scheme does. Waiting threads
+| yield after BARRIER_SPIN spins. Epochs and counters are unsigned and 
+| wrap, they are compared for equality or by their wrapping difference 
+| (reached), all values in flight are a few rounds apart.
+----------------------------------------------------------------------------*/
+
+#ifndef BARRIER_RADIX
+#define BARRIER_RADIX  8
+#endif
+#define BARRIER_LEVELS 3
+#define MAX_ROUNDS     16
+
+/* spins before a waiting thread yields its core (oversubscription) */
+#define BARRIER_SPIN   4096
+
+typedef struct
+{
+  volatile unsigned count;
+  volatile unsigned release;
+  unsigned fanin;
+} __attribute__((aligned(64))) tree_node;
+
+typedef struct
+{
+  tree_node *node[BARRIER_LEVELS];
+} combining_tree;
+
+typedef struct
+{
+  volatile unsigned flag[MAX_ROUNDS];
+} __attribute__((aligned(64))) dissemination_flags;
+
+static int barrier_mode = BARRIER_CENTRAL;
+
+static int nthreads_bar = 0;
+static int nnodes_bar[BARRIER_LEVELS];
+
+/* node per level, per thread */
+static int *path[BARRIER_LEVELS] = { NULL, NULL, NULL };
+
+/* rank ordered by NUMA node, per thread */
+static int *rank = NULL;
+static int nrounds = 0;
+
+typedef struct
+{
+  volatile unsigned epoch;
+} __attribute__((aligned(64))) progress_flag;
+
+typedef struct
+{
+  int nneighbors;
+  int *neighbor;
+  int comm;
+} thread_neighbors;
+
+static combining_tree tree_bar, tree_first, tree_last;
+static dissemination_flags *dflags = NULL;
+static progress_flag *pflags = NULL;
+static thread_neighbors *nbr = NULL;
+
+static unsigned epoch_bar = 0;
+static unsigned epoch_first = 0;
+static unsigned epoch_last = 0;
+static unsigned epoch_sync = 0;
+#pragma omp threadprivate(epoch_bar, epoch_first, epoch_last, epoch_sync)
+
+
+void set_barrier_mode(int mode)
+{
+  barrier_mode = mode;
+}
+
+int get_barrier_mode(void)
+{
+  return (nthreads_bar > 0) ? barrier_mode : BARRIER_CENTRAL;
+}
+
+const char* barrier_name(int mode)
+{
+  switch (mode)
+    {
+    case BARRIER_TREE:
+      return "tree";
+    case BARRIER_DISSEMINATION:
+      return "dissemination";
+    case BARRIER_NEIGHBOR:
+      return "neighbor";
+    default:
+      return "central";
+    }
+}
+
+
+/* a >= b for wrapping epochs and counters */
+static inline bool reached(unsigned a, unsigned b)
+{
+  return a - b <= UINT_MAX / 2;
+}
+
+/* until *ptr >= val */
+static inline void spin_until(volatile unsigned *ptr, unsigned val)
+{
+  int spin = 0;
+  while (!reached(*ptr, val))
+    {
+      if (++spin < BARRIER_SPIN)
+	{
+	  _mm_pause();
+	}
+      else
+	{
+	  sched_yield();
+	  spin = 0;
+	}
+    }
+}
+
+
+static int current_node(void)
+{
+  unsigned cpu = 0, node = 0;
+#ifdef __linux__
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    {
+      node = 0;
+    }
+#endif
+  return (int) node;
+}
+
+static void alloc_tree(combining_tree *t)
+{
+  int l, i;
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      t->node[l] = check_malloc_aligned(nnodes_bar[l] * sizeof(tree_node));
+      for(i = 0; i < nnodes_bar[l]; i++)
+	{
+	  t->node[l][i].count = 0;
+	  t->node[l][i].release = 0;
+	  t->node[l][i].fanin = 0;
+	}
+    }
+
+  /* fanin: threads per group, groups per NUMA node, NUMA nodes */
+  for(i = 0; i < nthreads_bar; i++)
+    {
+      t->node[0][path[0][i]].fanin++;
+    }
+  for(l = 1; l < BARRIER_LEVELS; l++)
+    {
+      int *seen = check_malloc(nnodes_bar[l - 1] * sizeof(int));
+      for(i = 0; i < nnodes_bar[l - 1]; i++)
+	{
+	  seen[i] = 0;
+	}
+      for(i = 0; i < nthreads_bar; i++)
+	{
+	  if (!seen[path[l - 1][i]])
+	    {
+	      seen[path[l - 1][i]] = 1;
+	      t->node[l][path[l][i]].fanin++;
+	    }
+	}
+      check_free(seen);
+    }
+}
+
+static void free_tree(combining_tree *t)
+{
+  int l;
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      check_free(t->node[l]);
+      t->node[l] = NULL;
+    }
+}
+
+
+void init_barrier(void)
+{
+  const int nthreads = omp_get_max_threads();
+  int *node = check_malloc(nthreads * sizeof(int));
+  int i, j;
+
+  free_barrier();
+
+#pragma omp parallel default (none) shared(node)
+  {
+    node[omp_get_thread_num()] = current_node();
+    epoch_bar = 0;
+    epoch_first = 0;
+    epoch_last = 0;
+    epoch_sync = 0;
+  }
+
+  /* rank by (NUMA node, thread id) */
+  rank = check_malloc(nthreads * sizeof(int));
+  for(i = 0; i < nthreads; i++)
+    {
+      rank[i] = 0;
+      for(j = 0; j < nthreads; j++)
+	{
+	  if (node[j] < node[i] || (node[j] == node[i] && j < i))
+	    {
+	      rank[i]++;
+	    }
+	}
+    }
+
+  /* group, NUMA node and root per thread, nodes numbered in rank order */
+  for(i = 0; i < BARRIER_LEVELS; i++)
+    {
+      path[i] = check_malloc(nthreads * sizeof(int));
+      nnodes_bar[i] = 0;
+    }
+  int *by_rank = check_malloc(nthreads * sizeof(int));
+  for(i = 0; i < nthreads; i++)
+    {
+      by_rank[rank[i]] = i;
+    }
+  int size = 0;
+  for(j = 0; j < nthreads; j++)
+    {
+      const int t = by_rank[j];
+      const int new_node = (j == 0 || node[t] != node[by_rank[j - 1]]);
+      if (new_node)
+	{
+	  nnodes_bar[1]++;
+	}
+      if (new_node || size == BARRIER_RADIX)
+	{
+	  nnodes_bar[0]++;
+	  size = 0;
+	}
+      size++;
+      path[0][t] = nnodes_bar[0] - 1;
+      path[1][t] = nnodes_bar[1] - 1;
+      path[2][t] = 0;
+    }
+  nnodes_bar[2] = 1;
+  check_free(by_rank);
+  check_free(node);
+
+  nthreads_bar = nthreads;
+  alloc_tree(&tree_bar);
+  alloc_tree(&tree_first);
+  alloc_tree(&tree_last);
+
+  nrounds = 0;
+  while ((1 << nrounds) < nthreads)
+    {
+      nrounds++;
+    }
+  ASSERT(nrounds <= MAX_ROUNDS);
+  dflags = check_malloc_aligned(nthreads * sizeof(dissemination_flags));
+  for(i = 0; i < nthreads; i++)
+    {
+      for(j = 0; j < MAX_ROUNDS; j++)
+	{
+	  dflags[i].flag[j] = 0;
+	}
+    }
+
+  /* no neighbors until set_thread_neighbors, thread_sync then waits 
+     for all threads */
+  pflags = check_malloc_aligned(nthreads * sizeof(progress_flag));
+  nbr = check_malloc(nthreads * sizeof(thread_neighbors));
+  for(i = 0; i < nthreads; i++)
+    {
+      pflags[i].epoch = 0;
+      nbr[i].nneighbors = 0;
+      nbr[i].neighbor = NULL;
+      nbr[i].comm = 1;
+    }
+}
+
+
+void set_thread_neighbors(int tid
+			  , int nneighbors
+			  , const int *neighbor
+			  , int comm
+			  )
+{
+  if (nbr == NULL)
+    {
+      return;
+    }
+  ASSERT(tid >= 0 && tid < nthreads_bar);
+  thread_neighbors *n = &(nbr[tid]);
+  check_free(n->neighbor);
+  n->neighbor = check_malloc(MAX(nneighbors, 1) * sizeof(int));
+  memcpy(n->neighbor, neighbor, nneighbors * sizeof(int));
+  n->nneighbors = nneighbors;
+  n->comm = comm;
+}
+
+
+void free_barrier(void)
+{
+  int l;
+  if (nthreads_bar > 0)
+    {
+      free_tree(&tree_bar);
+      free_tree(&tree_first);
+      free_tree(&tree_last);
+    }
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      check_free(path[l]);
+      path[l] = NULL;
+    }
+  if (nbr != NULL)
+    {
+      for(l = 0; l < nthreads_bar; l++)
+	{
+	  check_free(nbr[l].neighbor);
+	}
+    }
+  check_free(rank);
+  check_free(dflags);
+  check_free(pflags);
+  check_free(nbr);
+  rank = NULL;
+  dflags = NULL;
+  pflags = NULL;
+  nbr = NULL;
+  nthreads_bar = 0;
+}
+
+
+static void tree_barrier(int tid, unsigned e)
+{
+  int l, k;
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      tree_node *n = &(tree_bar.node[l][path[l][tid]]);
+      if (__sync_add_and_fetch(&(n->count), 1) != e * n->fanin)
+	{
+	  spin_until(&(n->release), e);
+	  break;
+	}
+    }
+  /* release the nodes this thread completed, top down */
+  for(k = l - 1; k >= 0; k--)
+    {
+      tree_bar.node[k][path[k][tid]].release = e;
+    }
+  __sync_synchronize();
+}
+
+static void dissemination_barrier(int tid, unsigned e)
+{
+  const int me = rank[tid];
+  int r;
+  for(r = 0; r < nrounds; r++)
+    {
+      const int partner = (me + (1 << r)) % nthreads_bar;
+      __sync_synchronize();
+      dflags[partner].flag[r] = e;
+      spin_until(&(dflags[me].flag[r]), e);
+    }
+  __sync_synchronize();
+}
+
+void thread_barrier(void)
+{
+  const int mode = get_barrier_mode();
+  if (mode == BARRIER_CENTRAL || omp_get_num_threads() == 1)
+    {
+#pragma omp barrier
+      return;
+    }
+  ASSERT(omp_get_num_threads() == nthreads_bar);
+  const int tid = omp_get_thread_num();
+  const unsigned e = ++epoch_bar;
+  if (mode == BARRIER_DISSEMINATION)
+    {
+      dissemination_barrier(tid, e);
+    }
+  else
+    {
+      tree_barrier(tid, e);
+    }
+}
+
+
+void thread_sync(int exchange)
+{
+  if (get_barrier_mode() != BARRIER_NEIGHBOR || omp_get_num_threads() == 1)
+    {
+      thread_barrier();
+      return;
+    }
+  ASSERT(omp_get_num_threads() == nthreads_bar);
+  const int tid = omp_get_thread_num();
+  const unsigned e = ++epoch_sync;
+  const thread_neighbors *n = &(nbr[tid]);
+  int i;
+
+  /* publish the sweep, after all writes of the sweep */
+  __sync_synchronize();
+  pflags[tid].epoch = e;
+
+  if (n->comm && (exchange || n->neighbor == NULL))
+    {
+      for(i = 0; i < nthreads_bar; i++)
+	{
+	  spin_until(&(pflags[i].epoch), e);
+	}
+    }
+  else
+    {
+      for(i = 0; i < n->nneighbors; i++)
+	{
+	  spin_until(&(pflags[n->neighbor[i]].epoch), e);
+	}
+    }
+  __sync_synchronize();
+}
+
+
+int elect_first_thread(void)
+{
+  const int tid = omp_get_thread_num();
+  const unsigned e = ++epoch_first;
+  int l;
+
+  if (omp_get_num_threads() == 1)
+    {
+      return 1;
+    }
+  ASSERT(omp_get_num_threads() == nthreads_bar);
+
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      tree_node *n = &(tree_first.node[l][path[l][tid]]);
+      spin_until(&(n->count), (e - 1) * n->fanin);
+      if (__sync_fetch_and_add(&(n->count), 1) != (e - 1) * n->fanin)
+	{
+	  return 0;
+	}
+    }
+  return 1;
+}
+
+int elect_last_thread(void)
+{
+  const int tid = omp_get_thread_num();
+  const unsigned e = ++epoch_last;
+  int l;
+
+  if (omp_get_num_threads() == 1)
+    {
+      return 1;
+    }
+  ASSERT(omp_get_num_threads() == nthreads_bar);
+
+  for(l = 0; l < BARRIER_LEVELS; l++)
+    {
+      tree_node *n = &(tree_last.node[l][path[l][tid]]);
+      spin_until(&(n->count), (e - 1) * n->fanin);
+      if (__sync_add_and_fetch(&(n->count), 1) != e * n->fanin)
+	{
+	  return 0;
+	}
+    }
+  return 1;
+}
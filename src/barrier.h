@@ -0,0 +1,47 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#define BARRIER_CENTRAL       0
+#define BARRIER_TREE          1
+#define BARRIER_DISSEMINATION 2
+#define BARRIER_NEIGHBOR      3
+#define N_BARRIER             4
+
+void set_barrier_mode(int mode);
+
+int get_barrier_mode(void);
+
+const char* barrier_name(int mode);
+
+/* NUMA node per thread (getcpu), after the threads are pinned 
+   (init_affinity). Until then the mode is central */
+void init_barrier(void);
+
+void free_barrier(void);
+
+/* full barrier of all threads, omp barrier in the central mode */
+void thread_barrier(void);
+
+/* exactly one thread per call returns 1, the first/last arriving one.
+   The others return 0 without waiting. Used by 
+   this_is_the_first_thread/this_is_the_last_thread in the tree and 
+   dissemination modes */
+int elect_first_thread(void);
+
+int elect_last_thread(void);
+
+/* thread neighbor graph of the neighbor mode, from the cross faces of 
+   thread tid (init_thread_rangelist). comm: the thread writes send or 
+   halo points */
+void set_thread_neighbors(int tid
+			  , int nneighbors
+			  , const int *neighbor
+			  , int comm
+			  );
+
+/* end of a sweep. In the neighbor mode a thread waits for its neighbor 
+   threads only, after a halo exchange (exchange != 0) the comm threads 
+   wait for all threads. Otherwise thread_barrier */
+void thread_sync(int exchange);
+
+#endif
@@ -65,6 +65,9 @@ static void init_communication_data(int iProc, int nProc, comm_data *cd)
   cd->local_send_offset = NULL;
   cd->notification = NULL;
 
+  cd->max_elem_sz = 0;
+  cd->layout = NULL;
+
   cd->send_stage = 0;
   cd->recv_stage = 0;
 
@@ -275,7 +278,7 @@ void init_communication(int argc, char *argv[], comm_data *cd)
 
 }
 
-static void compute_offset_tables(comm_data *cd)
+static void compute_offset_tables(comm_data *cd, int max_elem_sz)
 {
   int i;
 
@@ -298,7 +301,6 @@ static void compute_offset_tables(comm_data *cd)
   cd->notification       
     = check_malloc(nProc * sizeof(gaspi_notification_id_t));
 
-  const int max_elem_sz = NGRAD * 3;
   const size_t szd = sizeof(double);
 
   /* determine offsets */
@@ -405,7 +407,7 @@ static void compute_offset_tables(comm_data *cd)
 }
 
 
-void compute_communication_tables(comm_data *cd)
+void compute_communication_tables(comm_data *cd, solver_data *sd)
 {
 
 
@@ -416,6 +418,12 @@ void compute_communication_tables(comm_data *cd)
   ASSERT(cd->commpartner != NULL);
   ASSERT(cd->sendcount != NULL);
   ASSERT(cd->recvcount != NULL);
+  ASSERT(sd->grad_dim > 0);
+
+  /* grad is the largest field we exchange */
+  const int max_elem_sz = sd->grad_dim;
+  cd->max_elem_sz = max_elem_sz;
+  cd->layout = &(sd->layout);
 
   create_recvsend_index(cd);
 
@@ -431,7 +439,7 @@ void compute_communication_tables(comm_data *cd)
     }
 #endif
 
-  compute_offset_tables(cd);
+  compute_offset_tables(cd, max_elem_sz);
 
 #ifdef DEBUG
   for(i = 0; i < cd->ncommdomains; i++)
@@ -442,8 +450,6 @@ void compute_communication_tables(comm_data *cd)
     }
 #endif
 
-  const int max_elem_sz = NGRAD * 3;
-
   /* allocate requests, statuses and buffer */
   init_mpi_requests(cd, max_elem_sz);
 
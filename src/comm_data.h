@@ -2,6 +2,7 @@
 #define COMM_DATA_H
 
 #include <mpi.h>
+#include <stdatomic.h>
 
 #ifdef USE_GASPI
 #include <GASPI.h>
@@ -47,16 +48,22 @@ typedef struct
   gaspi_offset_t *local_send_offset;
   gaspi_notification_id_t *notification;
 
-  /* global stage counter */
-  volatile int recv_stage;
-  volatile int send_stage;
+  /* slot size per exchanged element, any dim2 <= max_elem_sz */
+  int max_elem_sz;
+
+  /* memory layout of exchanged data */
+  const data_layout *layout;
+
+  /* global stage counter, unsigned: wraps, parity stays valid */
+  atomic_uint recv_stage;
+  atomic_uint send_stage;
 
 } comm_data ;
 
 
 void init_communication(int argc, char *argv[], comm_data *cd);
 void read_communication_data(int ncid, comm_data *cd);
-void compute_communication_tables(comm_data *cd);
+void compute_communication_tables(comm_data *cd, solver_data *sd);
 void free_communication_ressources(void);
 
 #endif
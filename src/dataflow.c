@@ -0,0 +1,482 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+#include <mpi.h>
+
+#include "dataflow.h"
+#include "gradients.h"
+#include "rangelist.h"
+#include "threads.h"
+#include "exchange_data_mpi.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| OpenMP task dataflow over the gradient iterations. Every color is a task,
+| the halo exchange is one send and one receive task per comm partner. 
+| The dependencies are given by depend clauses on a token per color, per 
+| send partner and per recv partner:
+|
+| - a color depends on all preceding colors of its thread which write one 
+|   of its points (zeroing, accumulation and finalization keep the list 
+|   order, also against the next iteration), on the send tasks of the 
+|   partners of its written send points (the last send has read them) and
+|   on the recv tasks of its written halo points (the halo value of the 
+|   last iteration is overwritten only after the unpack).
+| - a send task depends on the colors which write its send points, it 
+|   waits for the previous send of the partner and sends.
+| - a recv task depends on the colors which write its halo points and on 
+|   all sends of the iteration. It waits for the message, unpacks it 
+|   and reposts the receive. Blocking receives run only after the own 
+|   sends have been issued, the partners can always progress.
+|
+| No barrier separates the iterations, the interior colors of the next 
+| iteration start as soon as their points are free. A color runs with 
+| the face data of its owner (set_solver_data). The segmented kernels 
+| keep a per thread color buffer, the colors of a thread are then chained.
+|
+| With CROSS_BUFFER every thread has a cross task per iteration, a color 
+| depends on the cross tasks of the writers of its reduce points. The 
+| next cross task of a writer runs after these colors (inout after in).
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  RangeList *color;
+  solver_data_local *local;
+  int ndep;
+  int *dep;  // token ids
+} df_task;
+
+typedef struct
+{
+  int ndep;
+  int *dep;  // color token ids
+} df_partner;
+
+static int ntask = 0;
+static int npartner = 0;
+static df_task *task = NULL;
+static df_partner *send_part = NULL;
+static df_partner *recv_part = NULL;
+
+/* face data per thread for the cross tasks, CROSS_BUFFER */
+static int ncross_task = 0;
+static solver_data_local **cross_local = NULL;
+
+/* [ntask] colors, [npartner] send, [npartner] recv, [ncross_task] cross */
+static char *token = NULL;
+
+#define SEND_TOKEN(i) (ntask + (i))
+#define RECV_TOKEN(i) (ntask + npartner + (i))
+#define CROSS_TOKEN(i) (ntask + 2 * npartner + (i))
+
+
+static void add_dep(int *ndep, int **dep, int id)
+{
+  int i;
+  for(i = 0; i < *ndep; i++)
+    {
+      if ((*dep)[i] == id)
+	{
+	  return;
+	}
+    }
+  *dep = check_realloc(*dep, (*ndep + 1) * sizeof(int));
+  (*dep)[(*ndep)++] = id;
+}
+
+static inline int written(RangeList *color, int k)
+{
+  return !((k == 0 && color->ftype == 3) || (k == 1 && color->ftype == 2));
+}
+
+/* writer thread of a cross buffer slot */
+static int slot_writer(const cross_buffers *xb, int slot)
+{
+  int w = 0;
+  while (slot >= xb->wstart[w + 1])
+    {
+      w++;
+    }
+  return w;
+}
+
+
+void init_dataflow(comm_data *cd, solver_data *sd)
+{
+  const int nthreads = omp_get_max_threads();
+  const int nallpoints = sd->nallpoints;
+  int *task_start = check_malloc((nthreads + 1) * sizeof(int));
+  int i, j, p;
+
+  free_dataflow();
+  npartner = cd->ncommdomains;
+  ncross_task = (get_cross_faces() == CROSS_BUFFER) ? nthreads : 0;
+  cross_local = check_malloc(nthreads * sizeof(solver_data_local*));
+  send_part = check_malloc(MAX(npartner, 1) * sizeof(df_partner));
+  recv_part = check_malloc(MAX(npartner, 1) * sizeof(df_partner));
+  for(i = 0; i < npartner; i++)
+    {
+      send_part[i].ndep = 0;
+      send_part[i].dep = NULL;
+      recv_part[i].ndep = 0;
+      recv_part[i].dep = NULL;
+    }
+
+  /* recv partner per halo point, send partners per own point (csr) */
+  int *recv_of = check_malloc(nallpoints * sizeof(int));
+  int *send_start = check_malloc((nallpoints + 1) * sizeof(int));
+  for(p = 0; p < nallpoints; p++)
+    {
+      recv_of[p] = -1;
+      send_start[p] = 0;
+    }
+  send_start[nallpoints] = 0;
+  for(i = 0; i < npartner; i++)
+    {
+      const int k = cd->commpartner[i];
+      for(j = 0; j < cd->recvcount[k]; j++)
+	{
+	  recv_of[cd->recvindex[k][j]] = i;
+	}
+      for(j = 0; j < cd->sendcount[k]; j++)
+	{
+	  send_start[cd->sendindex[k][j] + 1]++;
+	}
+    }
+  for(p = 0; p < nallpoints; p++)
+    {
+      send_start[p + 1] += send_start[p];
+    }
+  int *send_to = check_malloc(MAX(send_start[nallpoints], 1) * sizeof(int));
+  int *send_pos = check_malloc(nallpoints * sizeof(int));
+  for(p = 0; p < nallpoints; p++)
+    {
+      send_pos[p] = send_start[p];
+    }
+  for(i = 0; i < npartner; i++)
+    {
+      const int k = cd->commpartner[i];
+      for(j = 0; j < cd->sendcount[k]; j++)
+	{
+	  const int pnt = cd->sendindex[k][j];
+	  send_to[send_pos[pnt]++] = i;
+	}
+    }
+  check_free(send_pos);
+
+  for(i = 0; i <= nthreads; i++)
+    {
+      task_start[i] = 0;
+    }
+
+#pragma omp parallel default (none) shared(sd, nallpoints, ntask, npartner, task \
+					   , task_start, send_part, recv_part, recv_of \
+					   , send_start, send_to, ncross_task, cross_local \
+					   , stderr)
+  {
+    const int tid = omp_get_thread_num();
+    RangeList *color;
+    int jj, face, k;
+
+    task_start[tid + 1] = get_ncolors();
+#pragma omp barrier
+#pragma omp master
+    {
+      int t;
+      for(t = 0; t < omp_get_num_threads(); t++)
+	{
+	  task_start[t + 1] += task_start[t];
+	}
+      ntask = task_start[omp_get_num_threads()];
+      task = check_malloc(MAX(ntask, 1) * sizeof(df_task));
+    }
+#pragma omp barrier
+
+    solver_data_local *local = get_solver_data();
+    int (*fpoint)[2] = local->fpoint;
+    cross_local[tid] = local;
+    const int first = task_start[tid];
+    const int ncolors = task_start[tid + 1] - first;
+
+    /* colors of this thread per written point (csr), in list order */
+    int *mark = check_malloc(nallpoints * sizeof(int));
+    int *wstart = check_malloc((nallpoints + 1) * sizeof(int));
+    int *wpos = check_malloc(nallpoints * sizeof(int));
+    for(jj = 0; jj < nallpoints; jj++)
+      {
+	mark[jj] = -1;
+	wstart[jj] = 0;
+      }
+    wstart[nallpoints] = 0;
+    for (color = get_color(), jj = 0; color != NULL; color = get_next_color(color), jj++)
+      {
+	for(face = color->start; face < color->stop; face++)
+	  {
+	    for(k = 0; k < 2; k++)
+	      {
+		const int pnt = fpoint[face][k];
+		if (written(color, k) && mark[pnt] != jj)
+		  {
+		    mark[pnt] = jj;
+		    wstart[pnt + 1]++;
+		  }
+	      }
+	  }
+      }
+    for(jj = 0; jj < nallpoints; jj++)
+      {
+	wstart[jj + 1] += wstart[jj];
+	wpos[jj] = wstart[jj];
+	mark[jj] = -1;
+      }
+    int *writer = check_malloc(MAX(wstart[nallpoints], 1) * sizeof(int));
+    for (color = get_color(), jj = 0; color != NULL; color = get_next_color(color), jj++)
+      {
+	for(face = color->start; face < color->stop; face++)
+	  {
+	    for(k = 0; k < 2; k++)
+	      {
+		const int pnt = fpoint[face][k];
+		if (written(color, k) && mark[pnt] != jj)
+		  {
+		    mark[pnt] = jj;
+		    writer[wpos[pnt]++] = jj;
+		  }
+	      }
+	  }
+      }
+    for(jj = 0; jj < nallpoints; jj++)
+      {
+	mark[jj] = -1;
+      }
+
+    for (color = get_color(), jj = 0; color != NULL; color = get_next_color(color), jj++)
+      {
+	df_task *t = &task[first + jj];
+	t->color = color;
+	t->local = local;
+	t->ndep = 0;
+	t->dep = NULL;
+	if (get_segment_faces() && jj > 0)
+	  {
+	    add_dep(&(t->ndep), &(t->dep), first + jj - 1);
+	  }
+	for(face = color->start; face < color->stop; face++)
+	  {
+	    for(k = 0; k < 2; k++)
+	      {
+		const int pnt = fpoint[face][k];
+		int w, s;
+		if (!written(color, k) || mark[pnt] == jj)
+		  {
+		    continue;
+		  }
+		mark[pnt] = jj;
+		for(w = wstart[pnt]; w < wstart[pnt + 1] && writer[w] < jj; w++)
+		  {
+		    add_dep(&(t->ndep), &(t->dep), first + writer[w]);
+		  }
+		for(s = send_start[pnt]; s < send_start[pnt + 1]; s++)
+		  {
+		    add_dep(&(t->ndep), &(t->dep), SEND_TOKEN(send_to[s]));
+#pragma omp critical
+		    add_dep(&(send_part[send_to[s]].ndep), &(send_part[send_to[s]].dep), first + jj);
+		  }
+		if (recv_of[pnt] >= 0)
+		  {
+		    add_dep(&(t->ndep), &(t->dep), RECV_TOKEN(recv_of[pnt]));
+#pragma omp critical
+		    add_dep(&(recv_part[recv_of[pnt]].ndep), &(recv_part[recv_of[pnt]].dep), first + jj);
+		  }
+	      }
+	  }
+	if (ncross_task > 0)
+	  {
+	    const cross_buffers *xb = get_cross_buffers();
+	    int r;
+	    for(r = 0; r < color->nreduce_points; r++)
+	      {
+		const int pnt = color->reduce_points[r];
+		for(k = xb->start[pnt]; k < xb->start[pnt + 1]; k++)
+		  {
+		    add_dep(&(t->ndep), &(t->dep), CROSS_TOKEN(slot_writer(xb, xb->slot[k])));
+		  }
+	      }
+	  }
+      }
+    ASSERT(jj == ncolors);
+    check_free(writer);
+    check_free(wpos);
+    check_free(wstart);
+    check_free(mark);
+  }
+
+  token = check_malloc(ntask + 2 * npartner + ncross_task + 1);
+  check_free(send_to);
+  check_free(send_start);
+  check_free(recv_of);
+  check_free(task_start);
+}
+
+
+void free_dataflow(void)
+{
+  int i;
+  for(i = 0; i < ntask && task != NULL; i++)
+    {
+      check_free(task[i].dep);
+    }
+  for(i = 0; i < npartner && send_part != NULL; i++)
+    {
+      check_free(send_part[i].dep);
+      check_free(recv_part[i].dep);
+    }
+  check_free(task);
+  check_free(send_part);
+  check_free(recv_part);
+  check_free(cross_local);
+  check_free(token);
+  task = NULL;
+  send_part = NULL;
+  recv_part = NULL;
+  cross_local = NULL;
+  token = NULL;
+  ntask = 0;
+  npartner = 0;
+  ncross_task = 0;
+}
+
+
+static void wait_request(MPI_Request *req)
+{
+#ifdef USE_MPI_MULTI_THREADED
+  MPI_Wait(req, MPI_STATUS_IGNORE);
+#else
+  int flag = 0;
+  while (1)
+    {
+#pragma omp critical
+      MPI_Test(req, &flag, MPI_STATUS_IGNORE);
+      if (flag)
+	{
+	  break;
+	}
+      _mm_pause();
+    }
+#endif
+}
+
+
+void compute_gradients_gg_mpi_dataflow(comm_data *cd, solver_data *sd)
+{
+  ASSERT(task != NULL);
+  ASSERT(omp_get_num_threads() == omp_get_max_threads());
+
+#pragma omp single
+  {
+    MPI_Request *req = cd->req;
+    int it, j, i;
+
+    for(i = 0; i < npartner; i++)
+      {
+	req[npartner + i] = MPI_REQUEST_NULL;
+      }
+
+    for(it = 0; it < sd->niter; it++)
+      {
+	const int final = (it == sd->niter - 1);
+	for(j = 0; j < ncross_task; j++)
+	  {
+	    solver_data_local *local = cross_local[j];
+#pragma omp task default(none) firstprivate(local) shared(sd)	\
+  depend(inout: token[CROSS_TOKEN(j)])
+	    {
+	      set_solver_data(local);
+	      compute_gradients_gg_cross(sd);
+	      set_solver_data(NULL);
+	    }
+	  }
+
+	for(j = 0; j < ntask; j++)
+	  {
+	    df_task *t = &task[j];
+#pragma omp task default(none) firstprivate(t) shared(sd)		\
+  depend(iterator(k = 0:t->ndep), in: token[t->dep[k]])			\
+  depend(inout: token[j])
+	    {
+	      set_solver_data(t->local);
+	      t->color->kernel(t->color, sd);
+	      set_solver_data(NULL);
+	    }
+	  }
+
+	for(i = 0; i < npartner; i++)
+	  {
+	    df_partner *s = &send_part[i];
+#pragma omp task default(none) firstprivate(s, i) shared(cd, sd, req, npartner) \
+  depend(iterator(k = 0:s->ndep), in: token[s->dep[k]])			\
+  depend(inout: token[SEND_TOKEN(i)])
+	    {
+	      wait_request(&req[npartner + i]);
+#ifndef USE_MPI_MULTI_THREADED
+#pragma omp critical
+#endif
+	      {
+		exchange_dbl_mpi_send(cd
+				      , sd->grad
+				      , sd->grad_dim
+				      , i
+				      );
+	      }
+	    }
+	  }
+
+	for(i = 0; i < npartner; i++)
+	  {
+	    df_partner *r = &recv_part[i];
+#pragma omp task default(none) firstprivate(r, i, final) shared(cd, sd, req) \
+  depend(iterator(k = 0:r->ndep), in: token[r->dep[k]])			\
+  depend(iterator(k = 0:npartner), in: token[SEND_TOKEN(k)])		\
+  depend(inout: token[RECV_TOKEN(i)])
+	    {
+	      if (cd->recvcount[cd->commpartner[i]] > 0)
+		{
+		  wait_request(&req[i]);
+		  exchange_dbl_mpi_copy_out_partner(cd
+						    , sd->grad
+						    , sd->grad_dim
+						    , i
+						    );
+		  if (!final)
+		    {
+#ifndef USE_MPI_MULTI_THREADED
+#pragma omp critical
+#endif
+		      exchange_dbl_mpi_post_recv_partner(cd, i);
+		    }
+		}
+	    }
+	  }
+      }
+
+#pragma omp taskwait
+    for(i = 0; i < npartner; i++)
+      {
+	wait_request(&req[npartner + i]);
+      }
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+/* task graph over the colors of all threads and the halo partners, 
+   after the final rangelists (tune_color_size), freed by 
+   rebuild_threads */
+void init_dataflow(comm_data *cd, solver_data *sd);
+
+void free_dataflow(void);
+
+/* sd->niter MPI gradient iterations as OpenMP tasks. Called by all 
+   threads of a parallel region, after exchange_dbl_mpi_post_recv. 
+   Ends with a barrier */
+void compute_gradients_gg_mpi_dataflow(comm_data *cd, solver_data *sd);
+
+#endif
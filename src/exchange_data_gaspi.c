@@ -33,9 +33,9 @@ void init_gaspi_segments(comm_data *cd
 {
 
   int i, j;  
-  const int max_elem_sz = NGRAD * 3;
+  const int max_elem_sz = dim2;
   const size_t szd = sizeof(double);
-  ASSERT(dim2 == max_elem_sz);  
+  ASSERT(dim2 > 0);
 
   gaspi_number_t snum = 0; 
   SUCCESS_OR_DIE(gaspi_segment_num(&snum));
@@ -102,8 +102,7 @@ void exchange_dbl_gaspi_write(comm_data *cd
       for(j = 0; j < count; j++)
 	{
 	  int n1 = dim2 * j;
-	  int n2 = dim2 * sendindex[k][j];
-	  memcpy(&sbuf[n1], &data[n2], dim2 * sizeof(double));
+	  layout_copy_out(cd->layout, &sbuf[n1], data, dim2, sendindex[k][j]);
 	}
 
       gaspi_size_t size = count * dim2 * szd;
@@ -128,7 +127,8 @@ void exchange_dbl_gaspi_write(comm_data *cd
 }
 
 
-static void exchange_dbl_gaspi_copy_out(int recvcount
+static void exchange_dbl_gaspi_copy_out(const data_layout *layout
+					, int recvcount
 					, int *recvindex
 					, gaspi_offset_t local_recv_offset
 					, double *data
@@ -148,8 +148,7 @@ static void exchange_dbl_gaspi_copy_out(int recvcount
       for(j = 0; j < recvcount; j++)
 	{
 	  int n1 = dim2 * j;
-	  int n2 = dim2 * recvindex[j];
-	  memcpy(&data[n2], &rbuf[n1], dim2 * sizeof(double));
+	  layout_copy_in(layout, data, &rbuf[n1], dim2, recvindex[j]);
 	}
     }
 
@@ -226,7 +225,8 @@ void exchange_dbl_gaspi_bulk_sync(comm_data *cd
       for(i = 0; i < ncommdomains; i++)
 	{
 	  int k = commpartner[i];
-	  exchange_dbl_gaspi_copy_out(recvcount[k]
+	  exchange_dbl_gaspi_copy_out(cd->layout
+				      , recvcount[k]
 				      , recvindex[k]
 				      , local_recv_offset[k]
 				      , data
@@ -295,7 +295,8 @@ void exchange_dbl_gaspi_async(comm_data *cd
 	  int k = commpartner[id];	  
 	  ASSERT(recvcount[k] > 0);	  
 	  /* copy the data from the recvbuffer into out data field */
-	  exchange_dbl_gaspi_copy_out( recvcount[k]
+	  exchange_dbl_gaspi_copy_out(cd->layout
+				      , recvcount[k]
 				      , recvindex[k]
 				      , local_recv_offset[k]
 				      , data
@@ -28,8 +28,8 @@
 void init_mpi_requests(comm_data *cd, int dim2)
 {
   int i;
-  const int max_elem_sz = NGRAD * 3;
-  ASSERT(dim2 == max_elem_sz);  
+  const int max_elem_sz = dim2;
+  ASSERT(dim2 > 0);
   size_t szd = sizeof(double);
 
   ASSERT(cd->nrecv == 0);
@@ -42,12 +42,14 @@ void init_mpi_requests(comm_data *cd, int dim2)
   cd->stat  = (MPI_Status  *)check_malloc(szs);
   cd->nreq  = cd->ncommdomains;
 
-  int rsz = 0, ssz = 0;
+  /* one slot of max_elem_sz per element and partner, 
+     see local_send_offset/local_recv_offset */
+  size_t rsz = 0, ssz = 0;
   for(i = 0; i < cd->ncommdomains; i++)
     {
       int k = cd->commpartner[i];
-      ssz += dim2 * cd->sendcount[k] * max_elem_sz * szd;
-      rsz += dim2 * cd->recvcount[k] * max_elem_sz * szd;
+      ssz += cd->sendcount[k] * max_elem_sz * szd;
+      rsz += cd->recvcount[k] * max_elem_sz * szd;
     }  
 
   cd->sendbuf = check_malloc(ssz);
@@ -69,7 +71,7 @@ static void exchange_dbl_mpi_copy_out(comm_data *cd
   int **recvindex   = cd->recvindex;
 
   int j;
-  double *rbuf = cd->recvbuf;
+  double *rbuf = (double*) ((char*) cd->recvbuf + cd->local_recv_offset[k]);
   int count = recvcount[k];
 
   if(count > 0)
@@ -77,10 +79,8 @@ static void exchange_dbl_mpi_copy_out(comm_data *cd
       for(j = 0; j < count; j++)
 	{
 	  int n1 = dim2 * j;
-	  int n2 = dim2 * recvindex[k][j];
-	  memcpy(&data[n2], &rbuf[n1], dim2 * sizeof(double));
+	  layout_copy_in(cd->layout, data, &rbuf[n1], dim2, recvindex[k][j]);
 	}
-      rbuf += dim2 * count;
     }
 
 }
@@ -98,19 +98,20 @@ void exchange_dbl_mpi_send(comm_data *cd
 
   int j;
   size_t size, szd = sizeof(double);
-  double *sbuf = cd->sendbuf;
+
+  ASSERT(dim2 <= cd->max_elem_sz);
 
   /* send */
   int k = commpartner[i];
   int count = sendcount[k];
+  double *sbuf = (double*) ((char*) cd->sendbuf + cd->local_send_offset[k]);
  
   if(count > 0)
     {
       for(j = 0; j < count; j++)
 	{
 	  int n1 = dim2 * j;
-	  int n2 = dim2 * sendindex[k][j];
-	  memcpy(&sbuf[n1], &data[n2], dim2 * sizeof(double));
+	  layout_copy_out(cd->layout, &sbuf[n1], data, dim2, sendindex[k][j]);
 	}
 
       count *= dim2;
@@ -124,8 +125,6 @@ void exchange_dbl_mpi_send(comm_data *cd
 		, MPI_COMM_WORLD
 		, &(cd->req[ncommdomains + i])
 		);
-
-      sbuf += count;
     }
 }
 
@@ -141,13 +140,17 @@ void exchange_dbl_mpi_post_recv(comm_data *cd
 
   int i;
   size_t size, szd = sizeof(double);
-  double *rbuf = cd->recvbuf; 
+
+  /* posted for the full slot, so the next exchange may be of any 
+     field with dim2 <= max_elem_sz (e.g. var and grad alternating) */
+  ASSERT(dim2 > 0 && dim2 <= cd->max_elem_sz);
 
   /* recv */
   for(i = 0; i < ncommdomains; i++)
     { 
       int k = commpartner[i];
-      int count = recvcount[k] * dim2;
+      int count = recvcount[k] * cd->max_elem_sz;
+      double *rbuf = (double*) ((char*) cd->recvbuf + cd->local_recv_offset[k]);
 
       if(count > 0)
 	{
@@ -160,13 +163,44 @@ void exchange_dbl_mpi_post_recv(comm_data *cd
 		   , MPI_COMM_WORLD
 		    , &(cd->req[i])
 		   );
-	  rbuf += count;
 	}
     }
 
 }
 
 
+/* single partner, i is the commdomain index. For the task mode */
+void exchange_dbl_mpi_post_recv_partner(comm_data *cd
+					, int i
+					)
+{
+  int k = cd->commpartner[i];
+  int count = cd->recvcount[k] * cd->max_elem_sz;
+  double *rbuf = (double*) ((char*) cd->recvbuf + cd->local_recv_offset[k]);
+
+  if(count > 0)
+    {
+      MPI_Irecv(rbuf
+		, count * sizeof(double)
+		, MPI_BYTE
+		, k
+		, DATAKEY
+		, MPI_COMM_WORLD
+		, &(cd->req[i])
+		);
+    }
+}
+
+void exchange_dbl_mpi_copy_out_partner(comm_data *cd
+				       , double *data
+				       , int dim2
+				       , int i
+				       )
+{
+  exchange_dbl_mpi_copy_out(cd, data, dim2, cd->commpartner[i]);
+}
+
+
 void exchange_dbl_mpi_bulk_sync(comm_data *cd
 				, double *data
 				, int dim2
@@ -282,7 +316,7 @@ void exchange_dbl_mpi_early_recv(comm_data *cd
       if (! final)
 	{
 	  /* start next round */
-	  exchange_dbl_mpi_post_recv(cd, NGRAD * 3);
+	  exchange_dbl_mpi_post_recv(cd, dim2);
 	}
 
     }
@@ -358,7 +392,7 @@ void exchange_dbl_mpi_async(comm_data *cd
       if (! final)
 	{
 	/* start next round */
-	  exchange_dbl_mpi_post_recv(cd, NGRAD * 3);
+	  exchange_dbl_mpi_post_recv(cd, dim2);
 	}
 
     }
@@ -391,7 +425,7 @@ void exchange_dbl_mpi_async(comm_data *cd
       if (! final)
 	{
 	  /* start next round */
-	  exchange_dbl_mpi_post_recv(cd, NGRAD * 3);
+	  exchange_dbl_mpi_post_recv(cd, dim2);
 	}
     }
 
@@ -35,5 +35,16 @@ void exchange_dbl_mpi_post_recv(comm_data *cd
 				, int dim2
 				);
 
+/* single partner, i is the commdomain index */
+void exchange_dbl_mpi_post_recv_partner(comm_data *cd
+					, int i
+					);
+
+void exchange_dbl_mpi_copy_out_partner(comm_data *cd
+				       , double *data
+				       , int dim2
+				       , int i
+				       );
+
 #endif
 
@@ -35,9 +35,9 @@ void init_mpidma_buffers(comm_data *cd
 			 )
 {
   int i;
-  const int max_elem_sz = NGRAD * 3;
+  const int max_elem_sz = dim2;
   const size_t szd = sizeof(double);
-  ASSERT(dim2 == max_elem_sz);  
+  ASSERT(dim2 > 0);
 
   int rsz = 0, ssz = 0;
   for(i = 0; i < cd->ncommdomains; i++)
@@ -104,8 +104,7 @@ void exchange_dbl_mpidma_write(comm_data *cd
       for(j = 0; j < count; j++)
         {
           int n1 = dim2 * j;
-          int n2 = dim2 * sendindex[k][j];
-          memcpy(&sbuf[n1], &data[n2], dim2 * sizeof(double));
+	  layout_copy_out(cd->layout, &sbuf[n1], data, dim2, sendindex[k][j]);
         }
 
       int size = count * dim2 * szd;
@@ -123,7 +122,8 @@ void exchange_dbl_mpidma_write(comm_data *cd
 }
 
 
-void exchange_dbl_mpidma_copy_out(int recvcount
+void exchange_dbl_mpidma_copy_out(const data_layout *layout
+				 , int recvcount
 				 , int *recvindex
 				 , gaspi_offset_t local_recv_offset
 				 , double *data
@@ -139,8 +139,7 @@ void exchange_dbl_mpidma_copy_out(int recvcount
       for(j = 0; j < recvcount; j++)
         {
           int n1 = dim2 * j;
-          int n2 = dim2 * recvindex[j];
-          memcpy(&data[n2], &rbuf[n1], dim2 * sizeof(double));
+	  layout_copy_in(layout, data, &rbuf[n1], dim2, recvindex[j]);
         }
     }
 
@@ -183,7 +182,8 @@ void exchange_dbl_mpifence_bulk_sync(comm_data *cd
     for(i = 0; i < ncommdomains; i++)
       {
         int k = commpartner[i];
-        exchange_dbl_mpidma_copy_out(recvcount[k]
+	exchange_dbl_mpidma_copy_out(cd->layout
+				    , recvcount[k]
                                     , recvindex[k]
                                     , local_recv_offset[k]
                                     , data
@@ -218,20 +218,25 @@ void exchange_dbl_mpifence_async(comm_data *cd
     ASSERT(recvindex != NULL);
     ASSERT(local_recv_offset != NULL);
 
-    MPI_Win_fence(MPI_MODE_NOSTORE , rcvwin); // make sure data has arrived AND start next round
+    MPI_Win_fence(MPI_MODE_NOSUCCEED | MPI_MODE_NOSTORE , rcvwin); // make sure data has arrived
 
     int i;
     for (i = 0; i < ncommdomains; ++i)
       {
         int k = commpartner[i];
         /* copy the data from the recvbuffer into out data field */
-        exchange_dbl_mpidma_copy_out(recvcount[k]
+	exchange_dbl_mpidma_copy_out(cd->layout
+				    , recvcount[k]
                                     , recvindex[k]
                                     , local_recv_offset[k]
                                     , data
                                     , dim2
                                     );
       }
+
+    /* start next round only after the copy, partners put into recvbuf 
+       as soon as the epoch is open */
+    MPI_Win_fence(MPI_MODE_NOPRECEDE | MPI_MODE_NOSTORE , rcvwin);
     // inc stage counter
     cd->send_stage++;
     cd->recv_stage++;
@@ -276,7 +281,8 @@ void exchange_dbl_mpipscw_bulk_sync(comm_data *cd
     for(i = 0; i < ncommdomains; i++)
       {
         int k = commpartner[i];
-        exchange_dbl_mpidma_copy_out(recvcount[k]
+	exchange_dbl_mpidma_copy_out(cd->layout
+				    , recvcount[k]
                                     , recvindex[k]
                                     , local_recv_offset[k]
                                     , data
@@ -324,7 +330,8 @@ void exchange_dbl_mpipscw_async(comm_data *cd
       {
         int k = commpartner[i];
         /* copy the data from the recvbuffer into out data field */
-        exchange_dbl_mpidma_copy_out(recvcount[k]
+	exchange_dbl_mpidma_copy_out(cd->layout
+				    , recvcount[k]
                                     , recvindex[k]
                                     , local_recv_offset[k]
                                     , data
@@ -371,7 +378,8 @@ void exchange_dbl_mpipscw_async(comm_data *cd
       {
         int k = commpartner[i];
         /* copy the data from the recvbuffer into out data field */
-        exchange_dbl_mpidma_copy_out(recvcount[k]
+	exchange_dbl_mpidma_copy_out(cd->layout
+				    , recvcount[k]
                                     , recvindex[k]
                                     , local_recv_offset[k]
                                     , data
@@ -14,272 +14,572 @@
 #include <stdlib.h>
 #include "comm_data.h"
 #include "solver_data.h"
+#include "gradients.h"
+#include "gradients_simd.h"
 #include "rangelist.h"
 #include "threads.h"
+#include "schedule.h"
+#include "barrier.h"
+#include "progress.h"
 #include "exchange_data_mpi.h"
 #include "exchange_data_mpidma.h"
+#include "error_handling.h"
+#include "util.h"
 #ifdef USE_GASPI
 #include "exchange_data_gaspi.h"
 #endif
 
-static void compute_gradients_gg(RangeList *color, solver_data *sd)
+/*----------------------------------------------------------------------------
+| loop over all faces in the current grid domain and calculating the gradients
+| for the primitive variables except for the turbulence variables 
+| these gradients are calculated with the Gauss divergence theorem
+| first loop over all colors - second loop over colored inner faces
+| strip mining is applied to first and last points of color
+| 
+| the face kernel is instantiated per data layout, ftype and number of 
+| equations (gradients_kernel.h), for the padded AoS layout there are 
+| AVX2/AVX-512 kernels (gradients_simd.c). The instance is stored per color.
+|
+| ENGINE_CSR replaces the face loop by a gather over the faces of every 
+| own point (init_point_faces). A color then computes the final gradient 
+| of its last points, so the halo triggers per color are unchanged.
+|
+| CROSS_BUFFER computes the cross thread faces once: every sweep starts 
+| with the cross pass of each thread into its accumulation slots and a 
+| sync with the thread neighbors, the ftype 2/3 colors then only reduce 
+| the slots of their points (see rangelist.c). Other face kernels (WLSQ) 
+| and ENGINE_CSR run with the duplicated cross faces.
+----------------------------------------------------------------------------*/
+
+/* cross pass of the calling thread, see compute_gradients_gg_cross */
+typedef void (*cross_kernel)(solver_data *sd);
+
+/* equation counts with specialized kernel instances, 0 is generic */
+#define GG_FOR_EACH_NGRAD(X) X(0) X(5) X(6) X(7) X(8) X(12)
+#define GG_NGRAD_VALUE(ng) ng,
+static const int gg_ngrad[] = { GG_FOR_EACH_NGRAD(GG_NGRAD_VALUE) };
+#define GG_NGRAD_COUNT ((int) (sizeof(gg_ngrad) / sizeof(gg_ngrad[0])))
+
+/* [point][eq][dir] */
+#define GG_KERNEL  compute_gradients_gg_aos
+#define GG_VAR_DIM(ngrad) (ngrad)
+#define GG_VAR(pnt, eq) ((pnt) * var_dim + (eq))
+#define GG_GRAD(pnt, c) ((pnt) * grad_dim + (c))
+#include "gradients_kernel.h"
+
+/* [point][eq][dir], eq padded to SIMD_WIDTH */
+#define GG_KERNEL  compute_gradients_gg_aos_padded
+#define GG_VAR_DIM(ngrad) ((((ngrad) + SIMD_WIDTH - 1) / SIMD_WIDTH) * SIMD_WIDTH)
+#define GG_VAR(pnt, eq) ((pnt) * var_dim + (eq))
+#define GG_GRAD(pnt, c) ((pnt) * grad_dim + (c))
+#include "gradients_kernel.h"
+
+/* [eq][dir][point] */
+#define GG_KERNEL  compute_gradients_gg_soa
+#define GG_VAR_DIM(ngrad) (ngrad)
+#define GG_VAR(pnt, eq) ((eq) * cstride + (pnt))
+#define GG_GRAD(pnt, c) ((c) * cstride + (pnt))
+#include "gradients_kernel.h"
+
+/* [block][eq][dir][AOSOA_BLOCK] */
+#define GG_KERNEL  compute_gradients_gg_aosoa
+#define GG_VAR_DIM(ngrad) (ngrad)
+#define GG_VAR(pnt, eq) (((pnt) / AOSOA_BLOCK) * AOSOA_BLOCK * var_dim	\
+			 + (eq) * AOSOA_BLOCK + ((pnt) % AOSOA_BLOCK))
+#define GG_GRAD(pnt, c) (((pnt) / AOSOA_BLOCK) * AOSOA_BLOCK * grad_dim	\
+			 + (c) * AOSOA_BLOCK + ((pnt) % AOSOA_BLOCK))
+#include "gradients_kernel.h"
+
+
+/* kernel instances of the selected layout and ngrad, indexed by ftype */
+static const face_kernel *gg_kernels = NULL;
+
+/* segmented face order: scatter and segmented instances, see 
+   select_segmented_kernels */
+static const face_kernel *gg_scatter_kernels = NULL;
+static const face_kernel *gg_segmented_kernels = NULL;
+
+/* cross faces computed once: cross pass and ftype 2/3 reduce kernels of 
+   the selected layout and ngrad. gg_cross is the active cross pass, NULL
+   for the duplicated cross faces */
+static const face_kernel *gg_face_kernels = NULL;
+static cross_kernel gg_cross_kernel = NULL;
+static const face_kernel *gg_reduce_kernels = NULL;
+static cross_kernel gg_cross = NULL;
+
+static int ngrad_instance(int ngrad)
 {
-  solver_data_local* solver_local = get_solver_data();
-  int    (*fpoint)[2]        = solver_local->fpoint;
-  double  (*fnormal)[3]      = solver_local->fnormal; 
-
-  double (*var)[NGRAD]       = sd->var;
-  double (*grad)[NGRAD][3]   = sd->grad;
-  const double *pvolume      = sd->pvolume;
-  int i, eq, pnt;
-
-  /*----------------------------------------------------------------------------
-  | loop over all faces in the current grid domain and calculating the gradients
-  | for the primitive variables except for the turbulence variables 
-  | these gradients are calculated with the Gauss divergence theorem
-  | first loop over all colors - second loop over colored inner faces
-  | strip mining is applied to first and last points of color
-  ----------------------------------------------------------------------------*/
-
-  int  nfirst_points_of_color  = color->nfirst_points_of_color;
-  int  *first_points_of_color  = color->first_points_of_color;
-  int  nlast_points_of_color = color->nlast_points_of_color;
-  int  *last_points_of_color = color->last_points_of_color;
-
-  const int       start = color->start;
-  const int       stop  = color->stop;      
-  const int       ftype = color->ftype;
-  int face;
-
-  for(i = 0; i < nfirst_points_of_color; i++) 
+  int i;
+  for (i = 1; i < GG_NGRAD_COUNT; i++)
     {
-      pnt = first_points_of_color[i];
-      for(eq = 0; eq < NGRAD; eq++)
+      if (gg_ngrad[i] == ngrad)
 	{
-	  grad[pnt][eq][0] = 0.0;
-	  grad[pnt][eq][1] = 0.0;
-	  grad[pnt][eq][2] = 0.0;
+	  return i;
 	}
     }
+  return 0;
+}
+
+/* dispatch once per color, again after rebuild_threads */
+void set_color_kernels(void)
+{
+  ASSERT(gg_kernels != NULL);
+#pragma omp parallel default (none) shared(gg_kernels, gg_cross, gg_reduce_kernels, stderr)
+  {
+    RangeList *color;
+    for (color = get_color(); color != NULL; color = get_next_color(color)) 
+      {
+	ASSERT(color->ftype >= 1 && color->ftype <= 3);
+	color->kernel = (gg_cross != NULL && color->ftype != 1) 
+	  ? gg_reduce_kernels[color->ftype] : gg_kernels[color->ftype];
+      }
+  }
+}
 
-  for(face = start; face < stop; face++)
+/* CSR adjacency of the own points, every face appears once at p0 with 
+   +fnormal and once at p1 with -fnormal. Built once */
+void init_point_faces(solver_data *sd)
+{
+  const int npoints = sd->nownpoints;
+  int i, face;
+
+  if (sd->pfaces.start != NULL)
     {
-      const int  p0    = fpoint[face][0];
-      const int  p1    = fpoint[face][1];
-      const double anx = fnormal[face][0];
-      const double any = fnormal[face][1];
-      const double anz = fnormal[face][2];
+      return;
+    }
 
-      for(eq = 0; eq < NGRAD; eq++)
+  int *start = check_malloc((npoints + 1) * sizeof(int));
+  for(i = 0; i <= npoints; i++)
+    {
+      start[i] = 0;
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (p0 < npoints)
+	{
+	  start[p0 + 1]++;
+	}
+      if (p1 < npoints)
 	{
-	  const double val = 0.5 * (var[p0][eq] + var[p1][eq]);
-	  const double vx = anx * val, vy = any * val, vz = anz * val;
-
-	  if (ftype != 3)
-	    {
-	      grad[p0][eq][0] += vx; 
-	      grad[p0][eq][1] += vy;
-	      grad[p0][eq][2] += vz;
-	    }
-	  if (ftype != 2)
-	    {
-	      grad[p1][eq][0] -= vx;
-	      grad[p1][eq][1] -= vy;
-	      grad[p1][eq][2] -= vz; 
-	    }
+	  start[p1 + 1]++;
 	}
     }
+  for(i = 0; i < npoints; i++)
+    {
+      start[i + 1] += start[i];
+    }
 
-  for(i = 0; i < nlast_points_of_color; i++) 
+  const int nentries = start[npoints];
+  int *point = check_malloc(MAX(nentries, 1) * sizeof(int));
+  double (*normal)[3] = check_malloc(MAX(nentries, 1) * 3 * sizeof(double));
+  int *pos = check_malloc(MAX(npoints, 1) * sizeof(int));
+  for(i = 0; i < npoints; i++)
+    {
+      pos[i] = start[i];
+    }
+  for(face = 0; face < sd->nfaces; face++)
     {
-      pnt = last_points_of_color[i];
-      const double tmp = 1 / pvolume[pnt];
-      for(eq = 0; eq < NGRAD; eq++)
-	{  
-	  grad[pnt][eq][0] *= tmp;
-	  grad[pnt][eq][1] *= tmp;
-	  grad[pnt][eq][2] *= tmp;
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (p0 < npoints)
+	{
+	  const int k = pos[p0]++;
+	  point[k] = p1;
+	  normal[k][0] = sd->fnormal[face][0];
+	  normal[k][1] = sd->fnormal[face][1];
+	  normal[k][2] = sd->fnormal[face][2];
+	}
+      if (p1 < npoints)
+	{
+	  const int k = pos[p1]++;
+	  point[k] = p0;
+	  normal[k][0] = -sd->fnormal[face][0];
+	  normal[k][1] = -sd->fnormal[face][1];
+	  normal[k][2] = -sd->fnormal[face][2];
 	}
     }
+  check_free(pos);
 
+  sd->pfaces.start = start;
+  sd->pfaces.point = point;
+  sd->pfaces.normal = normal;
 }
 
 
+void init_gradients(comm_data *cd
+		    , solver_data *sd
+		    , int isa
+		    , int engine
+		    )
+{
+  const char *kname = "scalar";
+  const int ng = ngrad_instance(sd->ngrad);
 
+#ifdef HAVE_SIMD_KERNELS
+  if (isa == ISA_AUTO)
+    {
+      isa = simd_isa_supported(ISA_AVX512) ? ISA_AVX512
+	: simd_isa_supported(ISA_AVX2) ? ISA_AVX2 : ISA_SCALAR;
+    }
+#endif
 
-void compute_gradients_gg_comm_free(solver_data *sd)
-{
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+  switch (sd->layout.type)
     {
-      compute_gradients_gg(color, sd);
+    case LAYOUT_AOS_PADDED:
+      ASSERT(sd->var_dim % SIMD_WIDTH == 0);
+      gg_kernels = compute_gradients_gg_aos_padded_table[ng];
+#ifdef HAVE_SIMD_KERNELS
+      if (isa == ISA_AVX512 && simd_isa_supported(ISA_AVX512))
+	{
+	  gg_kernels = simd_kernels_avx512(sd->var_dim);
+	  kname = "avx512";
+	}
+      else if (isa == ISA_AVX2 && simd_isa_supported(ISA_AVX2))
+	{
+	  gg_kernels = simd_kernels_avx2(sd->var_dim);
+	  kname = "avx2";
+	}
+#endif
+      break;
+    case LAYOUT_SOA:
+      gg_kernels = compute_gradients_gg_soa_table[ng];
+      break;
+    case LAYOUT_AOSOA:
+      gg_kernels = compute_gradients_gg_aosoa_table[ng];
+      break;
+    default:
+      gg_kernels = compute_gradients_gg_aos_table[ng];
+      break;
+    }
+
+  /* conflict free face batches, gather/scatter over faces. Without a 
+     matching isa the batched face order is processed by the kernels above */
+#ifdef HAVE_SIMD_KERNELS
+  if (get_batch_width() == 8 && isa == ISA_AVX512 && simd_isa_supported(ISA_AVX512))
+    {
+      gg_kernels = simd_batch_kernels_avx512();
+      kname = "avx512 batch 8";
+    }
+  else if (get_batch_width() == 4 && (isa == ISA_AVX512 || isa == ISA_AVX2)
+	   && simd_isa_supported(ISA_AVX2))
+    {
+      gg_kernels = simd_batch_kernels_avx2();
+      kname = "avx2 batch 4";
+    }
+#endif
+
+  /* segmented face order, register accumulation per point */
+  if (get_segment_faces())
+    {
+      switch (sd->layout.type)
+	{
+	case LAYOUT_AOS_PADDED:
+	  gg_segmented_kernels = compute_gradients_gg_aos_padded_seg_table[ng];
+	  break;
+	case LAYOUT_SOA:
+	  gg_segmented_kernels = compute_gradients_gg_soa_seg_table[ng];
+	  break;
+	case LAYOUT_AOSOA:
+	  gg_segmented_kernels = compute_gradients_gg_aosoa_seg_table[ng];
+	  break;
+	default:
+	  gg_segmented_kernels = compute_gradients_gg_aos_seg_table[ng];
+	  break;
+	}
+      gg_scatter_kernels = gg_kernels;
+      gg_kernels = gg_segmented_kernels;
+      kname = "segmented";
+    }
+
+  /* point based, gather only */
+  if (engine == ENGINE_CSR)
+    {
+      init_point_faces(sd);
+      switch (sd->layout.type)
+	{
+	case LAYOUT_AOS_PADDED:
+	  gg_kernels = compute_gradients_gg_aos_padded_csr_table[ng];
+	  break;
+	case LAYOUT_SOA:
+	  gg_kernels = compute_gradients_gg_soa_csr_table[ng];
+	  break;
+	case LAYOUT_AOSOA:
+	  gg_kernels = compute_gradients_gg_aosoa_csr_table[ng];
+	  break;
+	default:
+	  gg_kernels = compute_gradients_gg_aos_csr_table[ng];
+	  break;
+	}
+      kname = "csr gather";
+    }
+
+  /* cross faces computed once, face engine only */
+  gg_face_kernels = gg_kernels;
+  gg_cross_kernel = NULL;
+  gg_reduce_kernels = NULL;
+  if (get_cross_faces() == CROSS_BUFFER && engine != ENGINE_CSR)
+    {
+      switch (sd->layout.type)
+	{
+	case LAYOUT_AOS_PADDED:
+	  gg_cross_kernel = compute_gradients_gg_aos_padded_cross_table[ng];
+	  gg_reduce_kernels = compute_gradients_gg_aos_padded_reduce_table[ng];
+	  break;
+	case LAYOUT_SOA:
+	  gg_cross_kernel = compute_gradients_gg_soa_cross_table[ng];
+	  gg_reduce_kernels = compute_gradients_gg_soa_reduce_table[ng];
+	  break;
+	case LAYOUT_AOSOA:
+	  gg_cross_kernel = compute_gradients_gg_aosoa_cross_table[ng];
+	  gg_reduce_kernels = compute_gradients_gg_aosoa_reduce_table[ng];
+	  break;
+	default:
+	  gg_cross_kernel = compute_gradients_gg_aos_cross_table[ng];
+	  gg_reduce_kernels = compute_gradients_gg_aos_reduce_table[ng];
+	  break;
+	}
+    }
+  gg_cross = gg_cross_kernel;
+
+  set_color_kernels();
+
+  if (cd->iProc == 0)
+    {
+      printf("layout: %s gradient kernel: %s ngrad: %d (%s)\n"
+	     , layout_name(sd->layout.type), kname, sd->ngrad
+	     , ng > 0 ? "specialized" : "generic");
+      printf("cross thread faces: %s\n"
+	     , (gg_cross != NULL) ? "buffer" : "duplicate");
+      fflush(stdout);
     }
-#pragma omp barrier
 }
 
+const face_kernel *get_gradient_kernels(void)
+{
+  return gg_kernels;
+}
 
-void compute_gradients_gg_mpi_bulk_sync(comm_data *cd, solver_data *sd)
+/* run other face kernels (e.g. WLSQ) through all comm variants, with the
+   duplicated cross faces. The GG kernels restore the cross face mode */
+void set_gradient_kernels(const face_kernel *kernels)
+{
+  const bool gg = (kernels == gg_face_kernels || kernels == gg_scatter_kernels
+		   || kernels == gg_segmented_kernels);
+  gg_kernels = kernels;
+  gg_cross = gg ? gg_cross_kernel : NULL;
+  set_color_kernels();
+}
+
+/* switch between the segmented kernels and the kernels init_gradients 
+   would use otherwise, both valid for the segmented face order */
+void select_segmented_kernels(bool segmented)
+{
+  ASSERT(gg_segmented_kernels != NULL && gg_scatter_kernels != NULL);
+  gg_kernels = segmented ? gg_segmented_kernels : gg_scatter_kernels;
+  set_color_kernels();
+}
+
+/* switch between the cross faces computed once and the duplicated cross
+   faces, both valid for the CROSS_BUFFER rangelist */
+void select_cross_buffers(bool buffered)
+{
+  ASSERT(gg_cross_kernel != NULL);
+  gg_cross = buffered ? gg_cross_kernel : NULL;
+  set_color_kernels();
+}
+
+bool cross_buffers_available(void)
+{
+  return gg_cross_kernel != NULL;
+}
+
+/* cross pass of the calling thread, no sync. A no-op for the duplicated 
+   cross faces */
+void compute_gradients_gg_cross(solver_data *sd)
+{
+  if (gg_cross != NULL)
+    {
+      gg_cross(sd);
+    }
+}
+
+/* cross pass before the colors, the reduce kernels wait for the writers 
+   of their points. Stolen colors read the slots of any thread */
+void compute_cross_faces(solver_data *sd, bool stealing)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+  if (gg_cross != NULL)
     {
-      compute_gradients_gg(color, sd);
+      gg_cross(sd);
+      if (stealing)
+	{
+	  thread_barrier();
+	}
+      else
+	{
+	  thread_sync(0);
+	}
     }
+}
+
+static inline void compute_gradients_gg(RangeList *color, solver_data *sd)
+{
+  color->kernel(color, sd);
+}
+
+/* color_hook of the progress variant, the progress thread sends */
+static void initiate_progress(RangeList *color
+			      , comm_data *cd
+			      , double *data __attribute__((unused))
+			      , int dim2 __attribute__((unused))
+			      )
+{
+  initiate_thread_comm_progress(color, cd);
+}
+
+
+
+
+void compute_gradients_gg_comm_free(solver_data *sd)
+{
+  /* static or work stealing, see schedule.c. The comm variants 
+     below use the same schedule */
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors(sd, compute_gradients_gg);
+}
+
+
+void compute_gradients_gg_mpi_bulk_sync(comm_data *cd, solver_data *sd)
+{
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, NULL
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpi_bulk_sync(cd
-			     , &(sd->grad[0][0][0])
-			     , NGRAD * 3
+			     , sd->grad
+			     , sd->grad_dim
 			     );
-#pragma omp barrier
+  thread_sync(1);
 }
 
 
 
 void compute_gradients_gg_mpi_early_recv(comm_data *cd, solver_data *sd, int final)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
-    {
-      compute_gradients_gg(color, sd);
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, NULL
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpi_early_recv(cd
-			      , &(sd->grad[0][0][0])
-			      , NGRAD * 3
+			      , sd->grad
+			      , sd->grad_dim
 			      , final
 			      );
-#pragma omp barrier  
+  thread_sync(1);
 }
 
 void compute_gradients_gg_mpi_async(comm_data *cd, solver_data *sd, int final)
 {
-  RangeList *color;
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
-    {
-      compute_gradients_gg(color, sd);
-      /* async comm - MPI_Isend */
-      initiate_thread_comm_mpi(color
-			       , cd
-			       , &(sd->grad[0][0][0])
-			       , NGRAD * 3
-			       );      
-
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, initiate_thread_comm_mpi
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpi_async(cd
-			 , &(sd->grad[0][0][0])
-			 , NGRAD * 3
+			 , sd->grad
+			 , sd->grad_dim
 			 , final
 			 );
-#pragma omp barrier  
+  thread_sync(1);
+}
+
+
+/* sends, receives and unpacking by the progress thread, after 
+   progress_post_recv. No barrier, exchange_dbl_progress returns when 
+   all threads are done and the halo is complete */
+void compute_gradients_gg_mpi_progress(comm_data *cd, solver_data *sd, int final)
+{
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, initiate_progress
+		       , cd, sd->grad, sd->grad_dim);
+  exchange_dbl_progress(final);
 }
 
 
 #ifdef USE_GASPI
 void compute_gradients_gg_gaspi_bulk_sync(comm_data *cd, solver_data *sd)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
-    {
-      compute_gradients_gg(color, sd);
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, NULL
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_gaspi_bulk_sync(cd
-			       , &(sd->grad[0][0][0])
-			       , NGRAD * 3
+			       , sd->grad
+			       , sd->grad_dim
 			       );
-#pragma omp barrier
+  thread_sync(1);
 }
 
 
 void compute_gradients_gg_gaspi_async(comm_data *cd, solver_data *sd)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color)) 
-    {
-      compute_gradients_gg(color, sd);
-      /* async comm - gaspi_write_notify */
-      initiate_thread_comm_gaspi(color
-				 , cd
-				 , &(sd->grad[0][0][0])
-				 , NGRAD * 3
-				 );      
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, initiate_thread_comm_gaspi
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_gaspi_async(cd
-			   , &(sd->grad[0][0][0])
-			   , NGRAD * 3
+			   , sd->grad
+			   , sd->grad_dim
 			   );
-#pragma omp barrier
+  thread_sync(1);
 }
 #endif
 
 
 void compute_gradients_gg_mpifence_bulk_sync(comm_data *cd, solver_data *sd)
 {
-  RangeList *color;
-  
-  for (color = get_color(); color != NULL; color = get_next_color(color))
-    {
-      compute_gradients_gg(color, sd);
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, NULL
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpifence_bulk_sync(cd
-				  , &(sd->grad[0][0][0])
-				  , NGRAD * 3
+				  , sd->grad
+				  , sd->grad_dim
 				  );
-#pragma omp barrier
+  thread_sync(1);
 }
 
 void compute_gradients_gg_mpifence_async(comm_data *cd, solver_data *sd)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color))
-    {
-      compute_gradients_gg(color, sd);
-      /* async comm - MPI_Put */
-      initiate_thread_comm_mpifence(color
-				    , cd
-				    , &(sd->grad[0][0][0])
-				    , NGRAD * 3
-				    );
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, initiate_thread_comm_mpifence
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpifence_async(cd
-			      , &(sd->grad[0][0][0])
-			      , NGRAD * 3
+			      , sd->grad
+			      , sd->grad_dim
 			      );  
-#pragma omp barrier
+  thread_sync(1);
 }
 
 
 void compute_gradients_gg_mpipscw_bulk_sync(comm_data *cd, solver_data *sd)
 {
-  RangeList *color;
-  for (color = get_color(); color != NULL; color = get_next_color(color))
-    {
-      compute_gradients_gg(color, sd);
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, NULL
+		       , cd, sd->grad, sd->grad_dim);
 
   exchange_dbl_mpipscw_bulk_sync(cd
-				 , &(sd->grad[0][0][0])
-				 , NGRAD * 3
+				 , sd->grad
+				 , sd->grad_dim
 				 );
-#pragma omp barrier  
+  thread_sync(1);
 }
 
 void compute_gradients_gg_mpipscw_async(comm_data *cd, solver_data *sd, int final)
 {
-  RangeList *color;  
-  for (color = get_color(); color != NULL; color = get_next_color(color))
-    {
-      compute_gradients_gg(color, sd);
-      /* async comm - MPI_Put, MPI_Win_complete, if required */
-      initiate_thread_comm_mpipscw(color
-				   , cd
-				   , &(sd->grad[0][0][0])
-				   , NGRAD * 3
-				   );
-    }
+  compute_cross_faces(sd, get_schedule() == SCHEDULE_STEAL);
+  schedule_colors_comm(sd, compute_gradients_gg, initiate_thread_comm_mpipscw
+		       , cd, sd->grad, sd->grad_dim);
   exchange_dbl_mpipscw_async(cd
-			     , &(sd->grad[0][0][0])
-			     , NGRAD * 3
+			     , sd->grad
+			     , sd->grad_dim
 			     , final
 			     );  
-#pragma omp barrier
+  thread_sync(1);
 }
 
 
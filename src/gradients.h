@@ -1,15 +1,52 @@
 #ifndef GRADIENTS_H
 #define GRADIENTS_H
 
+#include <stdbool.h>
+
 #include "comm_data.h"
 #include "solver_data.h"
 
+/* face based scatter kernels or point based gather only kernels */
+#define ENGINE_FACE 0
+#define ENGINE_CSR  1
+
+void init_gradients(comm_data *cd
+		    , solver_data *sd
+		    , int isa
+		    , int engine
+		    );
+
+void set_color_kernels(void);
+
+void init_point_faces(solver_data *sd);
+
+const face_kernel *get_gradient_kernels(void);
+
+void set_gradient_kernels(const face_kernel *kernels);
+
+void select_segmented_kernels(bool segmented);
+
+/* cross faces computed once (CROSS_BUFFER rangelist, face engine) */
+bool cross_buffers_available(void);
+
+void select_cross_buffers(bool buffered);
+
+/* cross pass of the calling thread, a no-op for duplicated cross faces */
+void compute_gradients_gg_cross(solver_data *sd);
+
+/* cross pass and sync before a color sweep of the face kernels, the 
+   reduce colors read the slots of the neighbor threads. stealing: the 
+   sweep is work stealing, full barrier */
+void compute_cross_faces(solver_data *sd, bool stealing);
+
 void compute_gradients_gg_comm_free(solver_data *sd);
 
 void compute_gradients_gg_mpi_bulk_sync(comm_data *cd, solver_data *sd);
 
 void compute_gradients_gg_mpi_early_recv(comm_data *cd, solver_data *sd, int final);
 
+void compute_gradients_gg_mpi_progress(comm_data *cd, solver_data *sd, int final);
+
 void compute_gradients_gg_gaspi_bulk_sync(comm_data *cd, solver_data *sd);
 
 void compute_gradients_gg_mpi_async(comm_data *cd, solver_data *sd, int final);
@@ -0,0 +1,501 @@
+/*
+ * Green-Gauss face kernel template.
+ *
+ * Included by gradients.c once per data layout, with 
+ *   GG_KERNEL              name of the generated kernel
+ *   GG_VAR_DIM(ngrad)      doubles per point in var
+ *   GG_VAR(pnt, eq)        offset of var  (pnt, eq) 
+ *   GG_GRAD(pnt, c)        offset of grad (pnt, c), c = 3 * eq + dir
+ * defined. GG_VAR/GG_GRAD may refer to the locals var_dim, grad_dim 
+ * and cstride.
+ *
+ * Face type and number of equations are compile time constants of 
+ * every instance. GG_KERNEL_table[i][ftype] holds the instances for 
+ * ftype 1, 2, 3 and the i-th equation count of GG_FOR_EACH_NGRAD, 
+ * where count 0 is the generic fallback using sd->ngrad.
+ *
+ * GG_KERNEL_seg is the segmented variant for the face order of 
+ * set_segment_faces: the faces of a color are sorted by their written 
+ * point, the contributions to that point are accumulated in registers 
+ * and stored once per segment. For ftype 1 the p1 contributions go 
+ * to the small color local buffer solver_local->fbuffer, which is 
+ * added to grad once per color. Instances in GG_KERNEL_seg_table.
+ *
+ * GG_KERNEL_csr is the gather only kernel of ENGINE_CSR: the final 
+ * gradient of the last points of a color is gathered over sd->pfaces, 
+ * independent of ftype. Instances in GG_KERNEL_csr_table.
+ *
+ * GG_KERNEL_cross and GG_KERNEL_reduce compute the cross thread faces 
+ * once (CROSS_BUFFER): the cross pass of a thread accumulates both sides
+ * of its cross faces into its slots of get_cross_buffers(), the reduce 
+ * kernel replaces the ftype 2/3 kernels and adds the slots of its reduce 
+ * points between zeroing and scaling. Instances in GG_KERNEL_cross_table
+ * and GG_KERNEL_reduce_table.
+ */
+
+#define GG_CAT_(a, b) a ## b
+#define GG_CAT(a, b) GG_CAT_(a, b)
+#define GG_NAME(ng, ft) GG_CAT(GG_KERNEL, _##ng##_##ft)
+#define GG_SEG_NAME(ng, ft) GG_CAT(GG_KERNEL, _seg_##ng##_##ft)
+#define GG_CSR_NAME(ng) GG_CAT(GG_KERNEL, _csr_##ng)
+#define GG_CROSS_NAME(ng) GG_CAT(GG_KERNEL, _cross_##ng)
+#define GG_REDUCE_NAME(ng) GG_CAT(GG_KERNEL, _reduce_##ng)
+
+static inline __attribute__((always_inline))
+void GG_KERNEL(RangeList *color
+	       , solver_data *sd
+	       , const int ftype
+	       , const int ngrad
+	       )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim  __attribute__((unused)) = GG_VAR_DIM(ngrad);
+  const int grad_dim __attribute__((unused)) = 3 * var_dim;
+  const int cstride  __attribute__((unused)) = sd->layout.cstride;
+  int i, eq, pnt;
+
+  int  nfirst_points_of_color  = color->nfirst_points_of_color;
+  int  *first_points_of_color  = color->first_points_of_color;
+  int  nlast_points_of_color = color->nlast_points_of_color;
+  int  *last_points_of_color = color->last_points_of_color;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;      
+  int face;
+
+  for(i = 0; i < nfirst_points_of_color; i++) 
+    {
+      pnt = first_points_of_color[i];
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] = 0.0;
+	}
+    }
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const double anx = fnormal[face][0];
+      const double any = fnormal[face][1];
+      const double anz = fnormal[face][2];
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double val = 0.5 * (var[GG_VAR(p0, eq)] + var[GG_VAR(p1, eq)]);
+	  const double vx = anx * val, vy = any * val, vz = anz * val;
+
+	  if (ftype != 3)
+	    {
+	      grad[GG_GRAD(p0, 3 * eq + 0)] += vx; 
+	      grad[GG_GRAD(p0, 3 * eq + 1)] += vy;
+	      grad[GG_GRAD(p0, 3 * eq + 2)] += vz;
+	    }
+	  if (ftype != 2)
+	    {
+	      grad[GG_GRAD(p1, 3 * eq + 0)] -= vx;
+	      grad[GG_GRAD(p1, 3 * eq + 1)] -= vy;
+	      grad[GG_GRAD(p1, 3 * eq + 2)] -= vz; 
+	    }
+	}
+    }
+
+  for(i = 0; i < nlast_points_of_color; i++) 
+    {
+      pnt = last_points_of_color[i];
+      const double tmp = 1 / pvolume[pnt];
+      for(eq = 0; eq < ngrad; eq++)
+	{  
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] *= tmp;
+	}
+    }
+
+}
+
+static inline __attribute__((always_inline))
+void GG_CAT(GG_KERNEL, _seg)(RangeList *color
+			     , solver_data *sd
+			     , const int ftype
+			     , const int ngrad
+			     )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+  const int *fslot           = solver_local->fslot;
+  double *buffer             = solver_local->fbuffer;
+
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim  __attribute__((unused)) = GG_VAR_DIM(ngrad);
+  const int grad_dim __attribute__((unused)) = 3 * var_dim;
+  const int cstride  __attribute__((unused)) = sd->layout.cstride;
+  const int side             = (ftype == 3) ? 1 : 0;
+  const double sign          = (ftype == 3) ? -1.0 : 1.0;
+  double acc[3 * ngrad];
+  int i, c, eq, pnt;
+
+  int  nfirst_points_of_color  = color->nfirst_points_of_color;
+  int  *first_points_of_color  = color->first_points_of_color;
+  int  nlast_points_of_color = color->nlast_points_of_color;
+  int  *last_points_of_color = color->last_points_of_color;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;      
+  int face;
+
+  for(i = 0; i < nfirst_points_of_color; i++) 
+    {
+      pnt = first_points_of_color[i];
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] = 0.0;
+	}
+    }
+
+  if (ftype == 1)
+    {
+      for(i = 0; i < color->nbuffer_points * 3 * ngrad; i++)
+	{
+	  buffer[i] = 0.0;
+	}
+    }
+
+  face = start;
+  while (face < stop)
+    {
+      /* segment of faces writing pnt */
+      pnt = fpoint[face][side];
+      for(c = 0; c < 3 * ngrad; c++)
+	{
+	  acc[c] = 0.0;
+	}
+
+      for(; face < stop && fpoint[face][side] == pnt; face++)
+	{
+	  const int  p0    = fpoint[face][0];
+	  const int  p1    = fpoint[face][1];
+	  const double anx = fnormal[face][0];
+	  const double any = fnormal[face][1];
+	  const double anz = fnormal[face][2];
+	  double *b = (ftype == 1) ? &buffer[fslot[face] * 3 * ngrad] : NULL;
+
+	  for(eq = 0; eq < ngrad; eq++)
+	    {
+	      const double val = 0.5 * (var[GG_VAR(p0, eq)] + var[GG_VAR(p1, eq)]);
+	      const double vx = anx * val, vy = any * val, vz = anz * val;
+
+	      acc[3 * eq + 0] += sign * vx;
+	      acc[3 * eq + 1] += sign * vy;
+	      acc[3 * eq + 2] += sign * vz;
+	      if (ftype == 1)
+		{
+		  b[3 * eq + 0] -= vx;
+		  b[3 * eq + 1] -= vy;
+		  b[3 * eq + 2] -= vz;
+		}
+	    }
+	}
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] += acc[3 * eq + 0];
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] += acc[3 * eq + 1];
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] += acc[3 * eq + 2];
+	}
+    }
+
+  if (ftype == 1)
+    {
+      for(i = 0; i < color->nbuffer_points; i++) 
+	{
+	  const double *b = &buffer[i * 3 * ngrad];
+	  pnt = color->buffer_points[i];
+	  for(eq = 0; eq < ngrad; eq++)
+	    {
+	      grad[GG_GRAD(pnt, 3 * eq + 0)] += b[3 * eq + 0];
+	      grad[GG_GRAD(pnt, 3 * eq + 1)] += b[3 * eq + 1];
+	      grad[GG_GRAD(pnt, 3 * eq + 2)] += b[3 * eq + 2];
+	    }
+	}
+    }
+
+  for(i = 0; i < nlast_points_of_color; i++) 
+    {
+      pnt = last_points_of_color[i];
+      const double tmp = 1 / pvolume[pnt];
+      for(eq = 0; eq < ngrad; eq++)
+	{  
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] *= tmp;
+	}
+    }
+
+}
+
+static inline __attribute__((always_inline))
+void GG_CAT(GG_KERNEL, _csr)(RangeList *color
+			     , solver_data *sd
+			     , const int ngrad
+			     )
+{
+  const int *pstart          = sd->pfaces.start;
+  const int *ppoint          = sd->pfaces.point;
+  double  (*pnormal)[3]      = sd->pfaces.normal;
+
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim  __attribute__((unused)) = GG_VAR_DIM(ngrad);
+  const int grad_dim __attribute__((unused)) = 3 * var_dim;
+  const int cstride  __attribute__((unused)) = sd->layout.cstride;
+  double acc[3 * ngrad];
+  int i, k, c, eq;
+
+  int  nlast_points_of_color = color->nlast_points_of_color;
+  int  *last_points_of_color = color->last_points_of_color;
+
+  for(i = 0; i < nlast_points_of_color; i++) 
+    {
+      const int pnt = last_points_of_color[i];
+      for(c = 0; c < 3 * ngrad; c++)
+	{
+	  acc[c] = 0.0;
+	}
+
+      for(k = pstart[pnt]; k < pstart[pnt + 1]; k++)
+	{
+	  const int  q     = ppoint[k];
+	  const double anx = pnormal[k][0];
+	  const double any = pnormal[k][1];
+	  const double anz = pnormal[k][2];
+	  for(eq = 0; eq < ngrad; eq++)
+	    {
+	      const double val = 0.5 * (var[GG_VAR(pnt, eq)] + var[GG_VAR(q, eq)]);
+	      acc[3 * eq + 0] += anx * val;
+	      acc[3 * eq + 1] += any * val;
+	      acc[3 * eq + 2] += anz * val;
+	    }
+	}
+
+      const double tmp = 1 / pvolume[pnt];
+      for(eq = 0; eq < ngrad; eq++)
+	{  
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] = acc[3 * eq + 0] * tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] = acc[3 * eq + 1] * tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] = acc[3 * eq + 2] * tmp;
+	}
+    }
+}
+
+static inline __attribute__((always_inline))
+void GG_CAT(GG_KERNEL, _cross)(solver_data *sd
+			       , const int ngrad
+			       )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+  const int ncross           = solver_local->ncross;
+  const int *cross_face      = solver_local->cross_face;
+  int    (*cross_slot)[2]    = solver_local->cross_slot;
+  double *buffer             = get_cross_buffers()->buffer;
+
+  const double *var          = sd->var;
+  const int var_dim  __attribute__((unused)) = GG_VAR_DIM(ngrad);
+  const int cstride  __attribute__((unused)) = sd->layout.cstride;
+  int i, eq;
+
+  for(i = solver_local->cross_slots[0] * 3 * ngrad
+	; i < solver_local->cross_slots[1] * 3 * ngrad; i++)
+    {
+      buffer[i] = 0.0;
+    }
+
+  for(i = 0; i < ncross; i++)
+    {
+      const int  face  = cross_face[i];
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const double anx = fnormal[face][0];
+      const double any = fnormal[face][1];
+      const double anz = fnormal[face][2];
+      double *b0 = &buffer[cross_slot[i][0] * 3 * ngrad];
+      double *b1 = &buffer[cross_slot[i][1] * 3 * ngrad];
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double val = 0.5 * (var[GG_VAR(p0, eq)] + var[GG_VAR(p1, eq)]);
+	  const double vx = anx * val, vy = any * val, vz = anz * val;
+
+	  b0[3 * eq + 0] += vx;
+	  b0[3 * eq + 1] += vy;
+	  b0[3 * eq + 2] += vz;
+	  b1[3 * eq + 0] -= vx;
+	  b1[3 * eq + 1] -= vy;
+	  b1[3 * eq + 2] -= vz;
+	}
+    }
+}
+
+static inline __attribute__((always_inline))
+void GG_CAT(GG_KERNEL, _reduce)(RangeList *color
+				, solver_data *sd
+				, const int ngrad
+				)
+{
+  const cross_buffers *xb    = get_cross_buffers();
+  const double *buffer       = xb->buffer;
+
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim  __attribute__((unused)) = GG_VAR_DIM(ngrad);
+  const int grad_dim __attribute__((unused)) = 3 * var_dim;
+  const int cstride  __attribute__((unused)) = sd->layout.cstride;
+  int i, k, eq, pnt;
+
+  int  nfirst_points_of_color  = color->nfirst_points_of_color;
+  int  *first_points_of_color  = color->first_points_of_color;
+  int  nlast_points_of_color = color->nlast_points_of_color;
+  int  *last_points_of_color = color->last_points_of_color;
+
+  for(i = 0; i < nfirst_points_of_color; i++) 
+    {
+      pnt = first_points_of_color[i];
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] = 0.0;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] = 0.0;
+	}
+    }
+
+  for(i = 0; i < color->nreduce_points; i++) 
+    {
+      pnt = color->reduce_points[i];
+      for(k = xb->start[pnt]; k < xb->start[pnt + 1]; k++)
+	{
+	  const double *b = &buffer[xb->slot[k] * 3 * ngrad];
+	  for(eq = 0; eq < ngrad; eq++)
+	    {
+	      grad[GG_GRAD(pnt, 3 * eq + 0)] += b[3 * eq + 0];
+	      grad[GG_GRAD(pnt, 3 * eq + 1)] += b[3 * eq + 1];
+	      grad[GG_GRAD(pnt, 3 * eq + 2)] += b[3 * eq + 2];
+	    }
+	}
+    }
+
+  for(i = 0; i < nlast_points_of_color; i++) 
+    {
+      pnt = last_points_of_color[i];
+      const double tmp = 1 / pvolume[pnt];
+      for(eq = 0; eq < ngrad; eq++)
+	{  
+	  grad[GG_GRAD(pnt, 3 * eq + 0)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 1)] *= tmp;
+	  grad[GG_GRAD(pnt, 3 * eq + 2)] *= tmp;
+	}
+    }
+}
+
+#define GG_INSTANCE(ng, ft)						\
+  static void GG_NAME(ng, ft)(RangeList *color, solver_data *sd)	\
+  {									\
+    GG_KERNEL(color, sd, ft, (ng) ? (ng) : sd->ngrad);			\
+  }									\
+  static void GG_SEG_NAME(ng, ft)(RangeList *color, solver_data *sd)	\
+  {									\
+    GG_CAT(GG_KERNEL, _seg)(color, sd, ft, (ng) ? (ng) : sd->ngrad);	\
+  }
+
+#define GG_INSTANCES(ng)						\
+  GG_INSTANCE(ng, 1)							\
+  GG_INSTANCE(ng, 2)							\
+  GG_INSTANCE(ng, 3)							\
+  static void GG_CSR_NAME(ng)(RangeList *color, solver_data *sd)	\
+  {									\
+    GG_CAT(GG_KERNEL, _csr)(color, sd, (ng) ? (ng) : sd->ngrad);	\
+  }									\
+  static void GG_CROSS_NAME(ng)(solver_data *sd)			\
+  {									\
+    GG_CAT(GG_KERNEL, _cross)(sd, (ng) ? (ng) : sd->ngrad);		\
+  }									\
+  static void GG_REDUCE_NAME(ng)(RangeList *color, solver_data *sd)	\
+  {									\
+    GG_CAT(GG_KERNEL, _reduce)(color, sd, (ng) ? (ng) : sd->ngrad);	\
+  }
+
+#define GG_TABLE_ROW(ng)						\
+  { NULL, GG_NAME(ng, 1), GG_NAME(ng, 2), GG_NAME(ng, 3) },
+
+#define GG_SEG_TABLE_ROW(ng)						\
+  { NULL, GG_SEG_NAME(ng, 1), GG_SEG_NAME(ng, 2), GG_SEG_NAME(ng, 3) },
+
+#define GG_CSR_TABLE_ROW(ng)						\
+  { NULL, GG_CSR_NAME(ng), GG_CSR_NAME(ng), GG_CSR_NAME(ng) },
+
+#define GG_CROSS_TABLE_ROW(ng)						\
+  GG_CROSS_NAME(ng),
+
+#define GG_REDUCE_TABLE_ROW(ng)						\
+  { NULL, NULL, GG_REDUCE_NAME(ng), GG_REDUCE_NAME(ng) },
+
+GG_FOR_EACH_NGRAD(GG_INSTANCES)
+
+static const face_kernel GG_CAT(GG_KERNEL, _table)[][4] = 
+  {
+    GG_FOR_EACH_NGRAD(GG_TABLE_ROW)
+  };
+
+static const face_kernel GG_CAT(GG_KERNEL, _seg_table)[][4] = 
+  {
+    GG_FOR_EACH_NGRAD(GG_SEG_TABLE_ROW)
+  };
+
+static const face_kernel GG_CAT(GG_KERNEL, _csr_table)[][4] = 
+  {
+    GG_FOR_EACH_NGRAD(GG_CSR_TABLE_ROW)
+  };
+
+static const cross_kernel GG_CAT(GG_KERNEL, _cross_table)[] = 
+  {
+    GG_FOR_EACH_NGRAD(GG_CROSS_TABLE_ROW)
+  };
+
+static const face_kernel GG_CAT(GG_KERNEL, _reduce_table)[][4] = 
+  {
+    GG_FOR_EACH_NGRAD(GG_REDUCE_TABLE_ROW)
+  };
+
+#undef GG_INSTANCE
+#undef GG_INSTANCES
+#undef GG_TABLE_ROW
+#undef GG_SEG_TABLE_ROW
+#undef GG_CSR_TABLE_ROW
+#undef GG_CROSS_TABLE_ROW
+#undef GG_REDUCE_TABLE_ROW
+#undef GG_KERNEL
+#undef GG_VAR_DIM
+#undef GG_VAR
+#undef GG_GRAD
+#undef GG_NAME
+#undef GG_SEG_NAME
+#undef GG_CSR_NAME
+#undef GG_CROSS_NAME
+#undef GG_REDUCE_NAME
+#undef GG_CAT
+#undef GG_CAT_
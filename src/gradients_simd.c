@@ -0,0 +1,596 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include "gradients_simd.h"
+
+#ifdef HAVE_SIMD_KERNELS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <immintrin.h>
+
+#include "solver_data.h"
+#include "rangelist.h"
+
+/*----------------------------------------------------------------------------
+| Green-Gauss face kernels for the padded AoS layout. The eq dimension is 
+| vectorized: var[p][eq] is loaded as a full vector, grad[p][eq][dir] is 
+| updated in chunks of 3 vectors. Lane c of a grad chunk holds (eq, dir) 
+| = (c / 3, c % 3), so val and the face normal are permuted accordingly.
+----------------------------------------------------------------------------*/
+
+int simd_isa_supported(int isa)
+{
+  __builtin_cpu_init();
+  switch (isa)
+    {
+    case ISA_AVX512:
+      return __builtin_cpu_supports("avx512f");
+    case ISA_AVX2:
+      return __builtin_cpu_supports("avx2");
+    default:
+      return 1;
+    }
+}
+
+static inline void scale_points(double *grad
+				, const double *pvolume
+				, int grad_dim
+				, int npoints
+				, const int *points
+				)
+{
+  int i, c;
+  for(i = 0; i < npoints; i++) 
+    {
+      int pnt = points[i];
+      const double tmp = 1 / pvolume[pnt];
+      double *g = &grad[pnt * grad_dim];
+      for(c = 0; c < grad_dim; c++)
+	{  
+	  g[c] *= tmp;
+	}
+    }
+}
+
+static inline void zero_points(double *grad
+			       , int grad_dim
+			       , int npoints
+			       , const int *points
+			       )
+{
+  int i, c;
+  for(i = 0; i < npoints; i++) 
+    {
+      double *g = &grad[points[i] * grad_dim];
+      for(c = 0; c < grad_dim; c++)
+	{  
+	  g[c] = 0.0;
+	}
+    }
+}
+
+static inline __attribute__((always_inline, target("avx512f")))
+void compute_gradients_gg_avx512(RangeList *color
+				, solver_data *sd
+				, const int ftype
+				, const int vdim
+				)
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const int var_dim          = vdim ? vdim : sd->var_dim;
+  const int grad_dim         = 3 * var_dim;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;      
+  int face, eq;
+
+  /* lane -> eq for the three grad vectors of a chunk of 8 eqs */
+  const __m512i idx0 = _mm512_set_epi64(2, 2, 1, 1, 1, 0, 0, 0);
+  const __m512i idx1 = _mm512_set_epi64(5, 4, 4, 4, 3, 3, 3, 2);
+  const __m512i idx2 = _mm512_set_epi64(7, 7, 7, 6, 6, 6, 5, 5);
+  const __m512d half = _mm512_set1_pd(0.5);
+
+  zero_points(grad, grad_dim
+	      , color->nfirst_points_of_color
+	      , color->first_points_of_color
+	      );
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const double anx = fnormal[face][0];
+      const double any = fnormal[face][1];
+      const double anz = fnormal[face][2];
+
+      /* lane -> dir for the three grad vectors of a chunk */
+      const __m512d n0 = _mm512_set_pd(any, anx, anz, any, anx, anz, any, anx);
+      const __m512d n1 = _mm512_set_pd(anx, anz, any, anx, anz, any, anx, anz);
+      const __m512d n2 = _mm512_set_pd(anz, any, anx, anz, any, anx, anz, any);
+
+      for(eq = 0; eq < var_dim; eq += 8)
+	{
+	  const __m512d val = _mm512_mul_pd(half
+					    , _mm512_add_pd(_mm512_loadu_pd(&var[p0 * var_dim + eq])
+							    , _mm512_loadu_pd(&var[p1 * var_dim + eq])));
+	  const __m512d v0 = _mm512_mul_pd(n0, _mm512_permutexvar_pd(idx0, val));
+	  const __m512d v1 = _mm512_mul_pd(n1, _mm512_permutexvar_pd(idx1, val));
+	  const __m512d v2 = _mm512_mul_pd(n2, _mm512_permutexvar_pd(idx2, val));
+
+	  if (ftype != 3)
+	    {
+	      double *g0 = &grad[p0 * grad_dim + 3 * eq];
+	      _mm512_storeu_pd(g0,      _mm512_add_pd(_mm512_loadu_pd(g0),      v0));
+	      _mm512_storeu_pd(g0 + 8,  _mm512_add_pd(_mm512_loadu_pd(g0 + 8),  v1));
+	      _mm512_storeu_pd(g0 + 16, _mm512_add_pd(_mm512_loadu_pd(g0 + 16), v2));
+	    }
+	  if (ftype != 2)
+	    {
+	      double *g1 = &grad[p1 * grad_dim + 3 * eq];
+	      _mm512_storeu_pd(g1,      _mm512_sub_pd(_mm512_loadu_pd(g1),      v0));
+	      _mm512_storeu_pd(g1 + 8,  _mm512_sub_pd(_mm512_loadu_pd(g1 + 8),  v1));
+	      _mm512_storeu_pd(g1 + 16, _mm512_sub_pd(_mm512_loadu_pd(g1 + 16), v2));
+	    }
+	}
+    }
+
+  scale_points(grad, sd->pvolume, grad_dim
+	       , color->nlast_points_of_color
+	       , color->last_points_of_color
+	       );
+}
+
+
+static inline __attribute__((always_inline, target("avx2")))
+void compute_gradients_gg_avx2(RangeList *color
+				, solver_data *sd
+				, const int ftype
+				, const int vdim
+				)
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const int var_dim          = vdim ? vdim : sd->var_dim;
+  const int grad_dim         = 3 * var_dim;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;      
+  int face, eq;
+
+  const __m256d half = _mm256_set1_pd(0.5);
+
+  zero_points(grad, grad_dim
+	      , color->nfirst_points_of_color
+	      , color->first_points_of_color
+	      );
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const __m256d nn = _mm256_set_pd(0.0
+				       , fnormal[face][2]
+				       , fnormal[face][1]
+				       , fnormal[face][0]);
+
+      /* lane -> dir for the three grad vectors of a chunk of 4 eqs */
+      const __m256d n0 = _mm256_permute4x64_pd(nn, _MM_SHUFFLE(0, 2, 1, 0));
+      const __m256d n1 = _mm256_permute4x64_pd(nn, _MM_SHUFFLE(1, 0, 2, 1));
+      const __m256d n2 = _mm256_permute4x64_pd(nn, _MM_SHUFFLE(2, 1, 0, 2));
+
+      for(eq = 0; eq < var_dim; eq += 4)
+	{
+	  const __m256d val = _mm256_mul_pd(half
+					    , _mm256_add_pd(_mm256_loadu_pd(&var[p0 * var_dim + eq])
+							    , _mm256_loadu_pd(&var[p1 * var_dim + eq])));
+	  /* lane -> eq */
+	  const __m256d v0 = _mm256_mul_pd(n0, _mm256_permute4x64_pd(val, _MM_SHUFFLE(1, 0, 0, 0)));
+	  const __m256d v1 = _mm256_mul_pd(n1, _mm256_permute4x64_pd(val, _MM_SHUFFLE(2, 2, 1, 1)));
+	  const __m256d v2 = _mm256_mul_pd(n2, _mm256_permute4x64_pd(val, _MM_SHUFFLE(3, 3, 3, 2)));
+
+	  if (ftype != 3)
+	    {
+	      double *g0 = &grad[p0 * grad_dim + 3 * eq];
+	      _mm256_storeu_pd(g0,     _mm256_add_pd(_mm256_loadu_pd(g0),     v0));
+	      _mm256_storeu_pd(g0 + 4, _mm256_add_pd(_mm256_loadu_pd(g0 + 4), v1));
+	      _mm256_storeu_pd(g0 + 8, _mm256_add_pd(_mm256_loadu_pd(g0 + 8), v2));
+	    }
+	  if (ftype != 2)
+	    {
+	      double *g1 = &grad[p1 * grad_dim + 3 * eq];
+	      _mm256_storeu_pd(g1,     _mm256_sub_pd(_mm256_loadu_pd(g1),     v0));
+	      _mm256_storeu_pd(g1 + 4, _mm256_sub_pd(_mm256_loadu_pd(g1 + 4), v1));
+	      _mm256_storeu_pd(g1 + 8, _mm256_sub_pd(_mm256_loadu_pd(g1 + 8), v2));
+	    }
+	}
+    }
+
+  scale_points(grad, sd->pvolume, grad_dim
+	       , color->nlast_points_of_color
+	       , color->last_points_of_color
+	       );
+}
+
+
+/*----------------------------------------------------------------------------
+| Batched Green-Gauss face kernels, any layout. The face dimension is 
+| vectorized: colors are reordered in init_thread_colors such that the faces 
+| [start, batch_stop) form batches of W = 8 (avx512) or W = 4 (avx2) faces 
+| which write pairwise distinct points. Per batch, var and grad are gathered 
+| for the W faces and grad is scattered back without conflicts. 
+| The remainder [batch_stop, stop) is scalar.
+----------------------------------------------------------------------------*/
+
+static inline void zero_points_layout(double *grad
+				      , const data_layout *l
+				      , int grad_dim
+				      , int ngrad
+				      , int npoints
+				      , const int *points
+				      )
+{
+  int i, c;
+  for(i = 0; i < npoints; i++) 
+    {
+      for(c = 0; c < 3 * ngrad; c++)
+	{  
+	  grad[layout_index(l, grad_dim, points[i], c)] = 0.0;
+	}
+    }
+}
+
+static inline void scale_points_layout(double *grad
+				       , const double *pvolume
+				       , const data_layout *l
+				       , int grad_dim
+				       , int ngrad
+				       , int npoints
+				       , const int *points
+				       )
+{
+  int i, c;
+  for(i = 0; i < npoints; i++) 
+    {
+      int pnt = points[i];
+      const double tmp = 1 / pvolume[pnt];
+      for(c = 0; c < 3 * ngrad; c++)
+	{  
+	  grad[layout_index(l, grad_dim, pnt, c)] *= tmp;
+	}
+    }
+}
+
+static inline __attribute__((always_inline))
+void faces_layout(solver_data *sd
+		  , const int ftype
+		  , int start
+		  , int stop
+		  )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const int var_dim          = sd->var_dim;
+  const int grad_dim         = sd->grad_dim;
+  const int ngrad            = sd->ngrad;
+  int face, eq, dir;
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double val = 0.5 * (var[layout_index(l, var_dim, p0, eq)]
+				    + var[layout_index(l, var_dim, p1, eq)]);
+	  for(dir = 0; dir < 3; dir++)
+	    {
+	      const double flux = fnormal[face][dir] * val;
+	      if (ftype != 3)
+		{
+		  grad[layout_index(l, grad_dim, p0, 3 * eq + dir)] += flux;
+		}
+	      if (ftype != 2)
+		{
+		  grad[layout_index(l, grad_dim, p1, 3 * eq + dir)] -= flux;
+		}
+	    }
+	}
+    }
+}
+
+/* layout_index(l, dim, p, 0) for 8 points */
+static inline __attribute__((always_inline, target("avx2")))
+__m256i layout_base8(const data_layout *l, int dim, __m256i p)
+{
+  const __m256i hi = _mm256_srl_epi32(p, _mm_cvtsi32_si128(l->shift));
+  const __m256i lo = _mm256_and_si256(p, _mm256_set1_epi32(l->mask));
+  return _mm256_add_epi32(_mm256_mullo_epi32(hi, _mm256_set1_epi32(l->block * dim)), lo);
+}
+
+/* layout_index(l, dim, p, 0) for 4 points */
+static inline __attribute__((always_inline, target("avx2")))
+__m128i layout_base4(const data_layout *l, int dim, __m128i p)
+{
+  const __m128i hi = _mm_srl_epi32(p, _mm_cvtsi32_si128(l->shift));
+  const __m128i lo = _mm_and_si128(p, _mm_set1_epi32(l->mask));
+  return _mm_add_epi32(_mm_mullo_epi32(hi, _mm_set1_epi32(l->block * dim)), lo);
+}
+
+static inline __attribute__((always_inline, target("avx512f")))
+void compute_gradients_gg_batch_avx512(RangeList *color
+				       , solver_data *sd
+				       , const int ftype
+				       )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const int ngrad            = sd->ngrad;
+  const size_t cstride       = l->cstride;
+
+  const int       start = color->start;
+  const int       batch_stop = color->batch_stop;
+  int face, eq, dir;
+
+  /* face -> offset in fpoint/fnormal */
+  const __m256i pidx = _mm256_set_epi32(14, 12, 10, 8, 6, 4, 2, 0);
+  const __m256i nidx = _mm256_set_epi32(21, 18, 15, 12, 9, 6, 3, 0);
+  const __m512d half = _mm512_set1_pd(0.5);
+
+  zero_points_layout(grad, l, sd->grad_dim, ngrad
+		     , color->nfirst_points_of_color
+		     , color->first_points_of_color
+		     );
+
+  for(face = start; face < batch_stop; face += 8)
+    {
+      const __m256i p0 = _mm256_i32gather_epi32(&fpoint[face][0], pidx, 4);
+      const __m256i p1 = _mm256_i32gather_epi32(&fpoint[face][1], pidx, 4);
+      const __m256i v0 = layout_base8(l, sd->var_dim, p0);
+      const __m256i v1 = layout_base8(l, sd->var_dim, p1);
+      const __m256i g0 = layout_base8(l, sd->grad_dim, p0);
+      const __m256i g1 = layout_base8(l, sd->grad_dim, p1);
+      const __m512d an[3] = { _mm512_i32gather_pd(nidx, &fnormal[face][0], 8)
+			      , _mm512_i32gather_pd(nidx, &fnormal[face][1], 8)
+			      , _mm512_i32gather_pd(nidx, &fnormal[face][2], 8) };
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double *ve = var + eq * cstride;
+	  const __m512d val = _mm512_mul_pd(half
+					    , _mm512_add_pd(_mm512_i32gather_pd(v0, ve, 8)
+							    , _mm512_i32gather_pd(v1, ve, 8)));
+	  for(dir = 0; dir < 3; dir++)
+	    {
+	      double *gc = grad + (3 * eq + dir) * cstride;
+	      const __m512d flux = _mm512_mul_pd(an[dir], val);
+	      if (ftype != 3)
+		{
+		  _mm512_i32scatter_pd(gc, g0, _mm512_add_pd(_mm512_i32gather_pd(g0, gc, 8), flux), 8);
+		}
+	      if (ftype != 2)
+		{
+		  _mm512_i32scatter_pd(gc, g1, _mm512_sub_pd(_mm512_i32gather_pd(g1, gc, 8), flux), 8);
+		}
+	    }
+	}
+    }
+
+  faces_layout(sd, ftype, batch_stop, color->stop);
+
+  scale_points_layout(grad, sd->pvolume, l, sd->grad_dim, ngrad
+		      , color->nlast_points_of_color
+		      , color->last_points_of_color
+		      );
+}
+
+
+/* avx2 has no scatter, the conflict free batch is stored lane by lane */
+static inline __attribute__((always_inline, target("avx2")))
+void scatter4(double *base, __m128i idx, __m256d val)
+{
+  int i[4];
+  double v[4];
+  _mm_storeu_si128((__m128i *) i, idx);
+  _mm256_storeu_pd(v, val);
+  base[i[0]] = v[0];
+  base[i[1]] = v[1];
+  base[i[2]] = v[2];
+  base[i[3]] = v[3];
+}
+
+static inline __attribute__((always_inline, target("avx2")))
+void compute_gradients_gg_batch_avx2(RangeList *color
+				     , solver_data *sd
+				     , const int ftype
+				     )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const int ngrad            = sd->ngrad;
+  const size_t cstride       = l->cstride;
+
+  const int       start = color->start;
+  const int       batch_stop = color->batch_stop;
+  int face, eq, dir;
+
+  /* face -> offset in fpoint/fnormal */
+  const __m128i pidx = _mm_set_epi32(6, 4, 2, 0);
+  const __m128i nidx = _mm_set_epi32(9, 6, 3, 0);
+  const __m256d half = _mm256_set1_pd(0.5);
+
+  zero_points_layout(grad, l, sd->grad_dim, ngrad
+		     , color->nfirst_points_of_color
+		     , color->first_points_of_color
+		     );
+
+  for(face = start; face < batch_stop; face += 4)
+    {
+      const __m128i p0 = _mm_i32gather_epi32(&fpoint[face][0], pidx, 4);
+      const __m128i p1 = _mm_i32gather_epi32(&fpoint[face][1], pidx, 4);
+      const __m128i v0 = layout_base4(l, sd->var_dim, p0);
+      const __m128i v1 = layout_base4(l, sd->var_dim, p1);
+      const __m128i g0 = layout_base4(l, sd->grad_dim, p0);
+      const __m128i g1 = layout_base4(l, sd->grad_dim, p1);
+      const __m256d an[3] = { _mm256_i32gather_pd(&fnormal[face][0], nidx, 8)
+			      , _mm256_i32gather_pd(&fnormal[face][1], nidx, 8)
+			      , _mm256_i32gather_pd(&fnormal[face][2], nidx, 8) };
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double *ve = var + eq * cstride;
+	  const __m256d val = _mm256_mul_pd(half
+					    , _mm256_add_pd(_mm256_i32gather_pd(ve, v0, 8)
+							    , _mm256_i32gather_pd(ve, v1, 8)));
+	  for(dir = 0; dir < 3; dir++)
+	    {
+	      double *gc = grad + (3 * eq + dir) * cstride;
+	      const __m256d flux = _mm256_mul_pd(an[dir], val);
+	      if (ftype != 3)
+		{
+		  scatter4(gc, g0, _mm256_add_pd(_mm256_i32gather_pd(gc, g0, 8), flux));
+		}
+	      if (ftype != 2)
+		{
+		  scatter4(gc, g1, _mm256_sub_pd(_mm256_i32gather_pd(gc, g1, 8), flux));
+		}
+	    }
+	}
+    }
+
+  faces_layout(sd, ftype, batch_stop, color->stop);
+
+  scale_points_layout(grad, sd->pvolume, l, sd->grad_dim, ngrad
+		      , color->nlast_points_of_color
+		      , color->last_points_of_color
+		      );
+}
+
+
+/* instances per ftype and var_dim, var_dim 0 is generic */
+#define GG_SIMD_INSTANCE(isa, target_isa, vdim, ftype)			\
+  __attribute__((target(target_isa)))					\
+  static void compute_gradients_gg_##isa##_##vdim##_##ftype(RangeList *color \
+							  , solver_data *sd) \
+  {									\
+    compute_gradients_gg_##isa(color, sd, ftype, vdim);			\
+  }
+
+#define GG_SIMD_INSTANCES(isa, target_isa, vdim)			\
+  GG_SIMD_INSTANCE(isa, target_isa, vdim, 1)				\
+  GG_SIMD_INSTANCE(isa, target_isa, vdim, 2)				\
+  GG_SIMD_INSTANCE(isa, target_isa, vdim, 3)				\
+  static const face_kernel compute_gradients_gg_##isa##_##vdim[4] =	\
+    { NULL								\
+      , compute_gradients_gg_##isa##_##vdim##_1				\
+      , compute_gradients_gg_##isa##_##vdim##_2				\
+      , compute_gradients_gg_##isa##_##vdim##_3				\
+    };
+
+GG_SIMD_INSTANCES(avx512, "avx512f", 0)
+GG_SIMD_INSTANCES(avx512, "avx512f", 8)
+GG_SIMD_INSTANCES(avx512, "avx512f", 16)
+GG_SIMD_INSTANCES(avx2, "avx2", 0)
+GG_SIMD_INSTANCES(avx2, "avx2", 8)
+GG_SIMD_INSTANCES(avx2, "avx2", 16)
+
+/* batched instances per ftype */
+#define GG_BATCH_INSTANCE(isa, target_isa, ftype)			\
+  __attribute__((target(target_isa)))					\
+  static void compute_gradients_gg_batch_##isa##_##ftype(RangeList *color \
+							 , solver_data *sd) \
+  {									\
+    compute_gradients_gg_batch_##isa(color, sd, ftype);			\
+  }
+
+GG_BATCH_INSTANCE(avx512, "avx512f", 1)
+GG_BATCH_INSTANCE(avx512, "avx512f", 2)
+GG_BATCH_INSTANCE(avx512, "avx512f", 3)
+GG_BATCH_INSTANCE(avx2, "avx2", 1)
+GG_BATCH_INSTANCE(avx2, "avx2", 2)
+GG_BATCH_INSTANCE(avx2, "avx2", 3)
+
+static const face_kernel compute_gradients_gg_batch_avx512_table[4] =
+  { NULL
+    , compute_gradients_gg_batch_avx512_1
+    , compute_gradients_gg_batch_avx512_2
+    , compute_gradients_gg_batch_avx512_3
+  };
+
+static const face_kernel compute_gradients_gg_batch_avx2_table[4] =
+  { NULL
+    , compute_gradients_gg_batch_avx2_1
+    , compute_gradients_gg_batch_avx2_2
+    , compute_gradients_gg_batch_avx2_3
+  };
+
+const face_kernel *simd_batch_kernels_avx512(void)
+{
+  return compute_gradients_gg_batch_avx512_table;
+}
+
+const face_kernel *simd_batch_kernels_avx2(void)
+{
+  return compute_gradients_gg_batch_avx2_table;
+}
+
+const face_kernel *simd_kernels_avx512(int var_dim)
+{
+  switch (var_dim)
+    {
+    case 8:
+      return compute_gradients_gg_avx512_8;
+    case 16:
+      return compute_gradients_gg_avx512_16;
+    default:
+      return compute_gradients_gg_avx512_0;
+    }
+}
+
+const face_kernel *simd_kernels_avx2(int var_dim)
+{
+  switch (var_dim)
+    {
+    case 8:
+      return compute_gradients_gg_avx2_8;
+    case 16:
+      return compute_gradients_gg_avx2_16;
+    default:
+      return compute_gradients_gg_avx2_0;
+    }
+}
+
+#endif
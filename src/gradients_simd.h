@@ -0,0 +1,31 @@
+#ifndef GRADIENTS_SIMD_H
+#define GRADIENTS_SIMD_H
+
+#include "solver_data.h"
+
+#if defined(GCC_EXTENSION) && defined(__x86_64__)
+#define HAVE_SIMD_KERNELS
+#endif
+
+#define ISA_AUTO    0
+#define ISA_SCALAR  1
+#define ISA_AVX2    2
+#define ISA_AVX512  3
+
+#ifdef HAVE_SIMD_KERNELS
+
+int simd_isa_supported(int isa);
+
+/* kernels for LAYOUT_AOS_PADDED, var_dim a multiple of 8 (avx512) or 4 (avx2),
+   indexed by ftype. Specialized for var_dim 8 and 16. */
+const face_kernel *simd_kernels_avx512(int var_dim);
+const face_kernel *simd_kernels_avx2(int var_dim);
+
+/* kernels for conflict free face batches (set_batch_width) of 8 (avx512) 
+   or 4 (avx2) faces, any layout, indexed by ftype */
+const face_kernel *simd_batch_kernels_avx512(void);
+const face_kernel *simd_batch_kernels_avx2(void);
+
+#endif
+
+#endif
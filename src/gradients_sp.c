@@ -0,0 +1,281 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gradients_sp.h"
+#include "rangelist.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| reduced precision Green-Gauss gradients. var, pvolume and the thread local
+| face normals are kept as float shadow copies ([point][eq]), grad is
+| accumulated in double (PRECISION_MIXED) or in float (PRECISION_FLOAT).
+| Only the comm free variant is provided, it is benchmarked against the
+| double precision kernel in test_precision (solver.c).
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  int    precision;
+  int    ngrad;
+  float  *var;
+  float  *pvolume;
+  double *grad_dp;  // PRECISION_MIXED
+  float  *grad_sp;  // PRECISION_FLOAT
+} solver_data_sp;
+
+static solver_data_sp sp = { PRECISION_DOUBLE, 0, NULL, NULL, NULL, NULL };
+
+
+const char* precision_name(int precision)
+{
+  switch (precision)
+    {
+    case PRECISION_MIXED:
+      return "mixed";
+    case PRECISION_FLOAT:
+      return "float";
+    default:
+      return "double";
+    }
+}
+
+static inline __attribute__((always_inline))
+void grad_update(double *grad_dp, float *grad_sp, const int mixed, int idx, float val)
+{
+  if (mixed)
+    {
+      grad_dp[idx] += val;
+    }
+  else
+    {
+      grad_sp[idx] += val;
+    }
+}
+
+static inline __attribute__((always_inline))
+void compute_gradients_gg_sp(RangeList *color
+			     , const int ftype
+			     , const int mixed
+			     )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  float   (*fnormal)[3]      = solver_local->fnormal_sp;
+
+  const float *var           = sp.var;
+  const float *pvolume       = sp.pvolume;
+  double *grad_dp            = sp.grad_dp;
+  float *grad_sp             = sp.grad_sp;
+  const int ngrad            = sp.ngrad;
+  const int grad_dim         = 3 * ngrad;
+  int i, c, eq, pnt;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;
+  int face;
+
+  for(i = 0; i < color->nfirst_points_of_color; i++)
+    {
+      pnt = color->first_points_of_color[i];
+      for(c = 0; c < grad_dim; c++)
+	{
+	  if (mixed)
+	    {
+	      grad_dp[pnt * grad_dim + c] = 0.0;
+	    }
+	  else
+	    {
+	      grad_sp[pnt * grad_dim + c] = 0.0f;
+	    }
+	}
+    }
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0   = fpoint[face][0];
+      const int  p1   = fpoint[face][1];
+      const float anx = fnormal[face][0];
+      const float any = fnormal[face][1];
+      const float anz = fnormal[face][2];
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const float val = 0.5f * (var[p0 * ngrad + eq] + var[p1 * ngrad + eq]);
+	  const float vx = anx * val, vy = any * val, vz = anz * val;
+
+	  if (ftype != 3)
+	    {
+	      grad_update(grad_dp, grad_sp, mixed, p0 * grad_dim + 3 * eq + 0, vx);
+	      grad_update(grad_dp, grad_sp, mixed, p0 * grad_dim + 3 * eq + 1, vy);
+	      grad_update(grad_dp, grad_sp, mixed, p0 * grad_dim + 3 * eq + 2, vz);
+	    }
+	  if (ftype != 2)
+	    {
+	      grad_update(grad_dp, grad_sp, mixed, p1 * grad_dim + 3 * eq + 0, -vx);
+	      grad_update(grad_dp, grad_sp, mixed, p1 * grad_dim + 3 * eq + 1, -vy);
+	      grad_update(grad_dp, grad_sp, mixed, p1 * grad_dim + 3 * eq + 2, -vz);
+	    }
+	}
+    }
+
+  for(i = 0; i < color->nlast_points_of_color; i++)
+    {
+      pnt = color->last_points_of_color[i];
+      const float tmp = 1.0f / pvolume[pnt];
+      for(c = 0; c < grad_dim; c++)
+	{
+	  if (mixed)
+	    {
+	      grad_dp[pnt * grad_dim + c] *= tmp;
+	    }
+	  else
+	    {
+	      grad_sp[pnt * grad_dim + c] *= tmp;
+	    }
+	}
+    }
+}
+
+/* instances per ftype, indexed by [mixed][ftype] */
+#define GG_SP_INSTANCE(ftype, mixed)					\
+  static void compute_gradients_gg_sp_##ftype##_##mixed(RangeList *color) \
+  {									\
+    compute_gradients_gg_sp(color, ftype, mixed);			\
+  }
+
+GG_SP_INSTANCE(1, 0)
+GG_SP_INSTANCE(2, 0)
+GG_SP_INSTANCE(3, 0)
+GG_SP_INSTANCE(1, 1)
+GG_SP_INSTANCE(2, 1)
+GG_SP_INSTANCE(3, 1)
+
+static void (*const gg_sp_kernels[2][4])(RangeList *color) =
+  {
+    { NULL
+      , compute_gradients_gg_sp_1_0
+      , compute_gradients_gg_sp_2_0
+      , compute_gradients_gg_sp_3_0
+    },
+    { NULL
+      , compute_gradients_gg_sp_1_1
+      , compute_gradients_gg_sp_2_1
+      , compute_gradients_gg_sp_3_1
+    }
+  };
+
+
+void update_var_sp(solver_data *sd)
+{
+  int i, eq;
+  ASSERT(sp.var != NULL);
+  for (i = 0; i < sd->nallpoints; ++i)
+    {
+      for (eq = 0; eq < sd->ngrad; ++eq)
+	{
+	  sp.var[i * sd->ngrad + eq]
+	    = (float) sd->var[layout_index(&(sd->layout), sd->var_dim, i, eq)];
+	}
+    }
+}
+
+
+void init_gradients_sp(solver_data *sd
+		       , int precision
+		       )
+{
+  int i;
+
+  sp.precision = precision;
+  if (precision == PRECISION_DOUBLE)
+    {
+      return;
+    }
+
+  const size_t npoints = sd->nallpoints;
+  sp.ngrad = sd->ngrad;
+  sp.var = check_malloc_aligned(npoints * sp.ngrad * sizeof(float));
+  sp.pvolume = check_malloc_aligned(npoints * sizeof(float));
+  if (precision == PRECISION_MIXED)
+    {
+      sp.grad_dp = check_malloc_aligned(npoints * 3 * sp.ngrad * sizeof(double));
+    }
+  else
+    {
+      sp.grad_sp = check_malloc_aligned(npoints * 3 * sp.ngrad * sizeof(float));
+    }
+
+  for (i = 0; i < sd->nallpoints; ++i)
+    {
+      sp.pvolume[i] = (float) sd->pvolume[i];
+    }
+  update_var_sp(sd);
+
+  /* thread local face normals */
+#pragma omp parallel default (none) shared(stderr)
+  {
+    solver_data_local* solver_local = get_solver_data();
+    RangeList *color;
+    int face, nfaces = 0;
+    for (color = get_color(); color != NULL; color = get_next_color(color))
+      {
+	nfaces = MAX(nfaces, color->stop);
+      }
+    if (nfaces > 0)
+      {
+	float (*fnormal_sp)[3] = check_malloc(nfaces * 3 * sizeof(float));
+	for (face = 0; face < nfaces; face++)
+	  {
+	    fnormal_sp[face][0] = (float) solver_local->fnormal[face][0];
+	    fnormal_sp[face][1] = (float) solver_local->fnormal[face][1];
+	    fnormal_sp[face][2] = (float) solver_local->fnormal[face][2];
+	  }
+	solver_local->fnormal_sp = fnormal_sp;
+      }
+  }
+}
+
+
+void compute_gradients_gg_sp_comm_free(solver_data *sd)
+{
+  RangeList *color;
+  const int mixed = (sp.precision == PRECISION_MIXED);
+  ASSERT(sp.ngrad == sd->ngrad);
+  for (color = get_color(); color != NULL; color = get_next_color(color))
+    {
+      gg_sp_kernels[mixed][color->ftype](color);
+    }
+#pragma omp barrier
+}
+
+
+/* own point gradients of the last sweep as double, into grad in the 
+   layout of sd->grad */
+void copy_gradients_sp(const solver_data *sd, double *grad)
+{
+  int i, c;
+  const int grad_dim = 3 * sp.ngrad;
+
+  for (i = 0; i < sd->nownpoints; ++i)
+    {
+      for (c = 0; c < grad_dim; ++c)
+	{
+	  grad[layout_index(&(sd->layout), sd->grad_dim, i, c)] 
+	    = (sp.precision == PRECISION_MIXED)
+	    ? sp.grad_dp[i * grad_dim + c] : (double) sp.grad_sp[i * grad_dim + c];
+	}
+    }
+}
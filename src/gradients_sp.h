@@ -0,0 +1,23 @@
+#ifndef GRADIENTS_SP_H
+#define GRADIENTS_SP_H
+
+#include "solver_data.h"
+
+/* storage precision of var, geometry and grad */
+#define PRECISION_DOUBLE 0  // all double
+#define PRECISION_MIXED  1  // float var/geometry, double grad
+#define PRECISION_FLOAT  2  // all float
+
+void init_gradients_sp(solver_data *sd
+		       , int precision
+		       );
+
+void update_var_sp(solver_data *sd);
+
+void compute_gradients_gg_sp_comm_free(solver_data *sd);
+
+void copy_gradients_sp(const solver_data *sd, double *grad);
+
+const char* precision_name(int precision);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "gradients_wlsq.h"
+#include "rangelist.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| weighted least-squares gradients. Per own point p 
+|
+|   grad(p) = M(p)^-1 sum_faces w d (var(q) - var(p)),  M(p) = sum w d d^T 
+|
+| with inverse distance squared weights w = 1 / |d|^2. The mesh has no 
+| coordinates, the edge vector d = x(q) - x(p) is modelled from the face 
+| normal n of the median dual: d = s n with length s |n| = V / |n|, 
+| V = (V(p) + V(q)) / 2. Then w d = n / V and w d d^T = n n^T / |n|^2.
+| M(p)^-1 is precomputed once. The face loop accumulates the right hand 
+| side in grad (both points of a face get + w d (var(p1) - var(p0))), 
+| the last points of a color are multiplied by M^-1 instead of the 
+| volume scaling of Green-Gauss. Colors, ftype and the halo triggers are 
+| the ones of the Green-Gauss kernels.
+----------------------------------------------------------------------------*/
+
+/* symmetric M^-1 per own point: xx, xy, xz, yy, yz, zz */
+static double (*minv)[6] = NULL;
+
+
+static inline __attribute__((always_inline))
+void compute_gradients_wlsq(RangeList *color
+			    , solver_data *sd
+			    , const int ftype
+			    )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim          = sd->var_dim;
+  const int grad_dim         = sd->grad_dim;
+  const int ngrad            = sd->ngrad;
+  int i, c, eq, pnt;
+
+  const int       start = color->start;
+  const int       stop  = color->stop;      
+  int face;
+
+  for(i = 0; i < color->nfirst_points_of_color; i++) 
+    {
+      pnt = color->first_points_of_color[i];
+      for(c = 0; c < 3 * ngrad; c++)
+	{
+	  grad[layout_index(l, grad_dim, pnt, c)] = 0.0;
+	}
+    }
+
+  for(face = start; face < stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const double w   = 2.0 / (pvolume[p0] + pvolume[p1]);
+      const double wdx = w * fnormal[face][0];
+      const double wdy = w * fnormal[face][1];
+      const double wdz = w * fnormal[face][2];
+
+      for(eq = 0; eq < ngrad; eq++)
+	{
+	  const double du = var[layout_index(l, var_dim, p1, eq)] 
+	    - var[layout_index(l, var_dim, p0, eq)];
+	  const double bx = wdx * du, by = wdy * du, bz = wdz * du;
+
+	  if (ftype != 3)
+	    {
+	      grad[layout_index(l, grad_dim, p0, 3 * eq + 0)] += bx;
+	      grad[layout_index(l, grad_dim, p0, 3 * eq + 1)] += by;
+	      grad[layout_index(l, grad_dim, p0, 3 * eq + 2)] += bz;
+	    }
+	  if (ftype != 2)
+	    {
+	      grad[layout_index(l, grad_dim, p1, 3 * eq + 0)] += bx;
+	      grad[layout_index(l, grad_dim, p1, 3 * eq + 1)] += by;
+	      grad[layout_index(l, grad_dim, p1, 3 * eq + 2)] += bz;
+	    }
+	}
+    }
+
+  for(i = 0; i < color->nlast_points_of_color; i++) 
+    {
+      pnt = color->last_points_of_color[i];
+      const double *m = minv[pnt];
+      for(eq = 0; eq < ngrad; eq++)
+	{  
+	  double *gx = &grad[layout_index(l, grad_dim, pnt, 3 * eq + 0)];
+	  double *gy = &grad[layout_index(l, grad_dim, pnt, 3 * eq + 1)];
+	  double *gz = &grad[layout_index(l, grad_dim, pnt, 3 * eq + 2)];
+	  const double bx = *gx, by = *gy, bz = *gz;
+	  *gx = m[0] * bx + m[1] * by + m[2] * bz;
+	  *gy = m[1] * bx + m[3] * by + m[4] * bz;
+	  *gz = m[2] * bx + m[4] * by + m[5] * bz;
+	}
+    }
+}
+
+/* instances per ftype */
+#define WLSQ_INSTANCE(ftype)						\
+  static void compute_gradients_wlsq_##ftype(RangeList *color		\
+					     , solver_data *sd)		\
+  {									\
+    compute_gradients_wlsq(color, sd, ftype);				\
+  }
+
+WLSQ_INSTANCE(1)
+WLSQ_INSTANCE(2)
+WLSQ_INSTANCE(3)
+
+static const face_kernel wlsq_kernels[4] =
+  { NULL
+    , compute_gradients_wlsq_1
+    , compute_gradients_wlsq_2
+    , compute_gradients_wlsq_3
+  };
+
+
+void init_gradients_wlsq(solver_data *sd)
+{
+  int i, face;
+  const int npoints = sd->nownpoints;
+  double (*m)[6] = check_malloc(MAX(npoints, 1) * 6 * sizeof(double));
+
+  for(i = 0; i < npoints; i++)
+    {
+      int j;
+      for(j = 0; j < 6; j++)
+	{
+	  m[i][j] = 0.0;
+	}
+    }
+
+  /* M = sum n n^T / |n|^2 */
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      const double *n = sd->fnormal[face];
+      const double nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+      const double mf[6] = { n[0] * n[0] / nn, n[0] * n[1] / nn, n[0] * n[2] / nn
+			     , n[1] * n[1] / nn, n[1] * n[2] / nn, n[2] * n[2] / nn };
+      int j;
+      ASSERT(nn > 0.0);
+      for(j = 0; j < 6; j++)
+	{
+	  if (p0 < npoints)
+	    {
+	      m[p0][j] += mf[j];
+	    }
+	  if (p1 < npoints)
+	    {
+	      m[p1][j] += mf[j];
+	    }
+	}
+    }
+
+  /* invert, a rank deficient stencil gets a zero gradient */
+  int nsingular = 0;
+  for(i = 0; i < npoints; i++)
+    {
+      const double a = m[i][0], b = m[i][1], c = m[i][2];
+      const double d = m[i][3], e = m[i][4], f = m[i][5];
+      const double c00 = d * f - e * e;
+      const double c01 = c * e - b * f;
+      const double c02 = b * e - c * d;
+      const double det = a * c00 + b * c01 + c * c02;
+      const double trace = a + d + f;
+      if (fabs(det) <= 1.e-12 * trace * trace * trace)
+	{
+	  int j;
+	  for(j = 0; j < 6; j++)
+	    {
+	      m[i][j] = 0.0;
+	    }
+	  nsingular++;
+	  continue;
+	}
+      m[i][0] = c00 / det;
+      m[i][1] = c01 / det;
+      m[i][2] = c02 / det;
+      m[i][3] = (a * f - c * c) / det;
+      m[i][4] = (b * c - a * e) / det;
+      m[i][5] = (a * d - b * b) / det;
+    }
+  if (nsingular > 0)
+    {
+      printf("wlsq: %d of %d points with a singular stencil\n", nsingular, npoints);
+      fflush(stdout);
+    }
+
+  check_free(minv);
+  minv = m;
+}
+
+
+const face_kernel *get_wlsq_kernels(void)
+{
+  ASSERT(minv != NULL);
+  return wlsq_kernels;
+}
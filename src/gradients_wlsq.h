@@ -0,0 +1,12 @@
+#ifndef GRADIENTS_WLSQ_H
+#define GRADIENTS_WLSQ_H
+
+#include "solver_data.h"
+
+void init_gradients_wlsq(solver_data *sd);
+
+/* WLSQ kernels, indexed by ftype. Replace the Green-Gauss kernels with 
+   set_gradient_kernels to run them through the comm variants */
+const face_kernel *get_wlsq_kernels(void);
+
+#endif
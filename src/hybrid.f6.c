@@ -16,7 +16,21 @@
 #include <netcdf.h>
 #include <mpi.h>
 
+#include "options.h"
 #include "solver.h"
+#include "gradients.h"
+#include "gradients_sp.h"
+#include "gradients_wlsq.h"
+#include "residual.h"
+#include "rk.h"
+#include "numa.h"
+#include "affinity.h"
+#include "schedule.h"
+#include "dataflow.h"
+#include "barrier.h"
+#include "progress.h"
+#include "renumber.h"
+#include "autotune.h"
 #include "comm_data.h"
 #include "solver_data.h"
 #include "read_netcdf.h"
@@ -30,31 +44,43 @@ int main(int argc, char *argv[])
   int retval, ncid;
   comm_data cd;
   solver_data sd;
+  solver_options opt;
 
-  if (argc != 4 || strcmp(argv[1],"-lvl") != 0)
-    {
-      printf("Usage: %s -lvl [1-4] GRID_PREFIX\n",argv[0]);
-      exit(EXIT_FAILURE);
-    }
+  parse_options(argc, argv, &opt);
+  startup_phase(NULL);
 
 
 #ifndef USE_NTHREADS
 #warning USE_NTHREADS undefined
-  const int NTHREADS = omp_get_num_procs();
+  const int NTHREADS = (opt.nthreads > 0) ? opt.nthreads : omp_get_num_procs();
 #else
-  const int NTHREADS = USE_NTHREADS;
-  omp_set_num_threads(NTHREADS);
+  const int NTHREADS = (opt.nthreads > 0) ? opt.nthreads : USE_NTHREADS;
 #endif
+  omp_set_num_threads(NTHREADS);
 
   /* init communication */
   init_communication(argc, argv, &cd);
 
+  /* pin threads, before any data is touched */
+  init_affinity(&cd, NTHREADS, opt.affinity, opt.progress);
+
+  /* NUMA hierarchical barriers and elections, on the pinned threads */
+  init_barrier();
+  set_barrier_mode(opt.barrier);
+
+  /* communication thread, on the reserved progress cpu */
+  if (opt.progress_thread)
+    {
+      init_progress_thread(&cd);
+    }
+  startup_phase("init_communication");
+
   /* open the file */
   char fname[80] = "";
   sprintf(fname, "%s_domain_%d_lvl_%d"
-	  ,argv[3]
+	  ,opt.grid_prefix
 	  ,cd.iProc
-	  ,atoi(argv[2])
+	  ,opt.lvl
 	  );
 
   ASSERT (f_exist(fname));
@@ -66,20 +92,93 @@ int main(int argc, char *argv[])
 
   /* init solver */
   const int NITER = 100;
-  init_solver_data(&sd, NITER);
+  init_solver_data(&sd, &opt, NITER);
 
   /* read comm data */
   read_communication_data(ncid, &cd);
+  startup_phase("read_data");
 
   /* compute comm tables */
-  compute_communication_tables(&cd);
+  compute_communication_tables(&cd, &sd);
+  startup_phase("comm_tables");
+
+  /* locality improving renumbering */
+  renumber_points(&cd, &sd, opt.renumber);
+  startup_phase("renumber");
 
   /* init thread range, rangelist */
+  set_batch_width(opt.batch);
+  set_segment_faces(opt.segmented);
+  set_balance_mode(opt.balance);
+  set_cross_faces(opt.cross_faces);
   init_threads(&cd, &sd, NTHREADS);
 
+  /* NUMA placement of the point data by the owner threads */
+  set_first_touch(opt.first_touch);
+  place_point_data(&sd);
+  if (opt.numa_report)
+    {
+      report_numa_pages(&cd, &sd);
+    }
+  startup_phase("first_touch");
+
+  /* select gradient kernels */
+  init_gradients(&cd, &sd, opt.isa, opt.engine);
+  startup_phase("init_gradients");
+
+  /* thread split from measured thread times */
+  tune_thread_balance(&cd, &sd);
+  startup_phase("thread_balance");
+
+  /* color size, fixed or autotuned */
+  tune_color_size(&cd, &sd, opt.color_size);
+  startup_phase("tune_color_size");
+
+  /* color schedule, on the final colors */
+  init_schedule(&sd);
+  set_schedule(opt.schedule);
+
+  /* task dataflow graph, on the final colors */
+  init_dataflow(&cd, &sd);
+  startup_phase("schedule_dataflow");
+
+  init_gradients_sp(&sd, opt.precision);
+
+  init_gradients_wlsq(&sd);
+
+  init_residual(&sd);
+
+  init_rk(&sd, opt.rk_stages);
+  startup_phase("init_solvers");
+  report_startup(&cd);
+
   /* run solver */
   test_solver(&cd, &sd);
 
+  /* reduced precision gradients */
+  test_precision(&cd, &sd, opt.precision);
+
+  /* segmented vs scatter kernels */
+  test_segmented(&cd, &sd);
+
+  /* cross thread faces computed once vs twice */
+  test_cross_faces(&cd, &sd);
+
+  /* limiter, reconstruction and flux, unfused vs fused */
+  test_residual(&cd, &sd);
+
+  /* RK time steps, grad and var exchange per stage */
+  test_rk(&cd, &sd);
+
+  /* static vs work stealing color schedule */
+  test_schedule(&cd, &sd);
+
+  /* barriers and elections per mode */
+  test_barrier(&cd, opt.barrier_bench);
+
+  free_progress_thread();
+  free_barrier();
+
   /* free comm ressources */
   free_communication_ressources();
 
@@ -0,0 +1,356 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+#include <omp.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "numa.h"
+#include "rangelist.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| NUMA aware placement of the point data. Linux places a page on the NUMA 
+| node of the thread which touches it first. The point fields are read and
+| initialized by the master thread, so they all end up on its node. 
+| place_point_data copies them into fresh allocations, every point is 
+| written by the thread which owns it (get_thread_pid), halo points of no 
+| thread domain are spread evenly. Pages shared by two thread domains go 
+| to either of them. The points are bucketed per owner thread once 
+| (histogram per chunk, prefix sum, scatter as init_face_buckets), every 
+| thread then touches its bucket only. The buckets are rebuilt by 
+| place_point_data and reused by alloc_point_field.
+|
+| report_numa_pages queries the node of every page of var and grad with 
+| move_pages(2) (no nodes given: query only) and counts the pages of own 
+| points which are on the node of their owner thread.
+----------------------------------------------------------------------------*/
+
+#define MAX_NUMA_NODES 64
+
+static bool first_touch = true;
+
+/* points per owner thread, incl. padding points of the layout */
+typedef struct
+{
+  int nthreads;
+  int npoints;
+  int *start;  // [nthreads + 1]
+  int *point;  // [npoints], ascending per thread
+} point_buckets;
+
+static point_buckets owner_points = { 0, 0, NULL, NULL };
+
+void set_first_touch(bool touch)
+{
+  first_touch = touch;
+}
+
+bool get_first_touch(void)
+{
+  return first_touch;
+}
+
+
+static inline int point_owner(const int *pid
+			      , int nallpoints
+			      , int npoints
+			      , int nthreads
+			      , int pnt
+			      )
+{
+  if (pid != NULL && pnt < nallpoints && pid[pnt] >= 0)
+    {
+      return pid[pnt];
+    }
+  return (int) (((long) pnt * nthreads) / npoints);
+}
+
+
+static void free_point_buckets(point_buckets *pb)
+{
+  check_free(pb->start);
+  check_free(pb->point);
+  pb->start = NULL;
+  pb->point = NULL;
+  pb->nthreads = 0;
+  pb->npoints = 0;
+}
+
+/* points of the layout (padded) by point_owner. One chunk of points per 
+   thread, counts per (chunk, owner), prefix sum over (owner, chunk) and 
+   scatter */
+static void init_point_buckets(point_buckets *pb, const solver_data *sd)
+{
+  const int nthreads   = omp_get_max_threads();
+  const int npoints    = layout_size(&(sd->layout), 1, sd->nallpoints) / sizeof(double);
+  const int nallpoints = sd->nallpoints;
+  const int *pid       = get_thread_pid();
+  int *count = check_malloc(nthreads * nthreads * sizeof(int));
+
+  free_point_buckets(pb);
+  pb->nthreads = nthreads;
+  pb->npoints = npoints;
+  pb->start = check_malloc((nthreads + 1) * sizeof(int));
+  pb->point = check_malloc(MAX(npoints, 1) * sizeof(int));
+
+#pragma omp parallel default (none) shared(pb, pid, count, nthreads, npoints, nallpoints, stderr)
+  {
+    const int c = omp_get_thread_num();
+    ASSERT(omp_get_num_threads() == nthreads);
+    const int q0 = (int) ((long) npoints * c / nthreads),
+	      q1 = (int) ((long) npoints * (c + 1) / nthreads);
+    int *pc = &count[c * nthreads];
+    int n, pnt;
+
+    /* histogram */
+    for(n = 0; n < nthreads; n++)
+      {
+	pc[n] = 0;
+      }
+    for(pnt = q0; pnt < q1; pnt++)
+      {
+	pc[point_owner(pid, nallpoints, npoints, nthreads, pnt)]++;
+      }
+
+#pragma omp barrier
+
+    /* prefix sum, counts become chunk offsets */
+#pragma omp single
+    {
+      int i, j, sum = 0;
+      for(i = 0; i < nthreads; i++)
+	{
+	  pb->start[i] = sum;
+	  for(j = 0; j < nthreads; j++)
+	    {
+	      const int t = count[j * nthreads + i];
+	      count[j * nthreads + i] = sum;
+	      sum += t;
+	    }
+	}
+      pb->start[nthreads] = sum;
+    }
+
+    /* scatter */
+    for(pnt = q0; pnt < q1; pnt++)
+      {
+	pb->point[pc[point_owner(pid, nallpoints, npoints, nthreads, pnt)]++] = pnt;
+      }
+  }
+
+  check_free(count);
+}
+
+
+/* new field of dim components per point, points written by their owner 
+   thread (owner_points), copied from old (freed) or zeroed. Without first
+   touch old is kept. Padding points are zeroed.
+   pvolume is a field of dim 1, layout_index(l, 1, pnt, 0) == pnt for all
+   layouts */
+static double *place_field(const solver_data *sd
+			   , double *old
+			   , int dim
+			   )
+{
+  const data_layout *l = &(sd->layout);
+  const size_t sz      = layout_size(l, dim, sd->nallpoints);
+  const int nallpoints = sd->nallpoints;
+  const point_buckets *pb = &owner_points;
+  double *data;
+
+  if (!first_touch)
+    {
+      /* keep the master thread placement */
+      if (old != NULL)
+	{
+	  return old;
+	}
+      data = check_malloc_aligned(sz);
+      memset(data, 0, sz);
+      return data;
+    }
+
+  ASSERT(pb->npoints == (int) (sz / (dim * sizeof(double))));
+  data = check_malloc_aligned(sz);
+
+#pragma omp parallel default (none) shared(l, pb, data, old, dim, nallpoints, stderr)
+  {
+    const int tid = omp_get_thread_num();
+    ASSERT(omp_get_num_threads() == pb->nthreads);
+    int j, c;
+    for (j = pb->start[tid]; j < pb->start[tid + 1]; j++)
+      {
+	const int i = pb->point[j];
+	for (c = 0; c < dim; c++)
+	  {
+	    const int idx = layout_index(l, dim, i, c);
+	    data[idx] = (old != NULL && i < nallpoints) ? old[idx] : 0.0;
+	  }
+      }
+  }
+
+  check_free(old);
+  return data;
+}
+
+
+double *alloc_point_field(const solver_data *sd, int dim)
+{
+  if (first_touch && owner_points.start == NULL)
+    {
+      init_point_buckets(&owner_points, sd);
+    }
+  return place_field(sd, NULL, dim);
+}
+
+
+void place_point_data(solver_data *sd)
+{
+  ASSERT(get_thread_pid() != NULL);
+
+  /* owners may have changed (rebalance_threads) */
+  if (first_touch)
+    {
+      init_point_buckets(&owner_points, sd);
+    }
+
+  sd->pvolume = place_field(sd, sd->pvolume, 1);
+
+  sd->var = place_field(sd, sd->var, sd->var_dim);
+  sd->grad = place_field(sd, sd->grad, sd->grad_dim);
+  sd->res = place_field(sd, sd->res, sd->var_dim);
+}
+
+
+#ifdef __linux__
+
+/* pages of the own points of this thread: total, on the thread's node, 
+   and per node */
+static void count_pages(const solver_data *sd
+			, const double *data
+			, int dim
+			, int tid
+			, long *count
+			)
+{
+  const data_layout *l = &(sd->layout);
+  const int *pid       = get_thread_pid();
+  const long pagesize  = sysconf(_SC_PAGESIZE);
+  unsigned cpu = 0, node = 0;
+  int i, npages = 0;
+
+  syscall(SYS_getcpu, &cpu, &node, NULL);
+
+  void **pages = check_malloc(MAX(sd->nownpoints, 1) * sizeof(void *));
+  int *status = check_malloc(MAX(sd->nownpoints, 1) * sizeof(int));
+  for (i = 0; i < sd->nownpoints; i++)
+    {
+      if (pid[i] == tid)
+	{
+	  void *page = (void *) ((long) &data[layout_index(l, dim, i, 0)] & ~(pagesize - 1));
+	  if (npages == 0 || pages[npages - 1] != page)
+	    {
+	      pages[npages++] = page;
+	    }
+	}
+    }
+
+  if (npages > 0 
+      && syscall(SYS_move_pages, 0, (unsigned long) npages, pages, NULL, status, 0) == 0)
+    {
+      for (i = 0; i < npages; i++)
+	{
+	  if (status[i] >= 0 && status[i] < MAX_NUMA_NODES)
+	    {
+#pragma omp atomic
+	      count[0]++;
+	      if (status[i] == (int) node)
+		{
+#pragma omp atomic
+		  count[1]++;
+		}
+#pragma omp atomic
+	      count[2 + status[i]]++;
+	    }
+	}
+    }
+
+  check_free(status);
+  check_free(pages);
+}
+
+
+static void report_field(comm_data *cd
+			 , const solver_data *sd
+			 , const char *name
+			 , const double *data
+			 , int dim
+			 )
+{
+  long count[2 + MAX_NUMA_NODES], gcount[2 + MAX_NUMA_NODES];
+  int n;
+
+  for (n = 0; n < 2 + MAX_NUMA_NODES; n++)
+    {
+      count[n] = 0;
+    }
+#pragma omp parallel default (none) shared(sd, data, dim, count)
+  {
+    count_pages(sd, data, dim, omp_get_thread_num(), count);
+  }
+  MPI_Allreduce(count, gcount, 2 + MAX_NUMA_NODES, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+  if (cd->iProc == 0)
+    {
+      printf("%38s: pages: %10ld local: %6.3f  per node:", name, gcount[0]
+	     , (gcount[0] > 0) ? (double) gcount[1] / gcount[0] : 0.0);
+      for (n = 0; n < MAX_NUMA_NODES; n++)
+	{
+	  if (gcount[2 + n] > 0)
+	    {
+	      printf(" %d: %ld", n, gcount[2 + n]);
+	    }
+	}
+      printf("\n");
+    }
+}
+
+#endif
+
+
+void report_numa_pages(comm_data *cd, solver_data *sd)
+{
+#ifdef __linux__
+  if (cd->iProc == 0)
+    {
+      printf("                           first touch: %s\n", first_touch ? "on" : "off");
+    }
+  report_field(cd, sd, "numa pages var", sd->var, sd->var_dim);
+  report_field(cd, sd, "numa pages grad", sd->grad, sd->grad_dim);
+#else
+  if (cd->iProc == 0)
+    {
+      printf("numa page report requires linux move_pages\n");
+    }
+#endif
+}
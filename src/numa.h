@@ -0,0 +1,27 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stdbool.h>
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+/* first touch of the point data by the owner threads (default on), 
+   off keeps the master thread placement */
+void set_first_touch(bool touch);
+
+bool get_first_touch(void);
+
+/* reallocate var, grad, res and pvolume with owner thread first touch, 
+   after init_threads */
+void place_point_data(solver_data *sd);
+
+/* zeroed field of dim components per point in the layout of sd, 
+   placed as place_point_data */
+double *alloc_point_field(const solver_data *sd, int dim);
+
+/* pages of var and grad per NUMA node, fraction on the node of the 
+   owner thread */
+void report_numa_pages(comm_data *cd, solver_data *sd);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "options.h"
+#include "solver_data.h"
+#include "gradients.h"
+#include "gradients_simd.h"
+#include "gradients_sp.h"
+#include "renumber.h"
+#include "autotune.h"
+#include "affinity.h"
+#include "schedule.h"
+#include "barrier.h"
+#include "rangelist.h"
+
+static void usage(char *prog)
+{
+  printf("Usage: %s -lvl [1-4] [options] GRID_PREFIX\n",prog);
+  printf("  -layout aos|aos8|soa|aosoa   memory layout of var/grad (default aos)\n");
+  printf("  -isa auto|scalar|avx2|avx512 gradient kernel for aos8 (default auto)\n");
+  printf("  -ngrad N                     number of transported variables (default %d)\n", NGRAD);
+  printf("  -precision double|mixed|float benchmark reduced precision gradients (default double)\n");
+  printf("  -renumber none|rcm           point/face renumbering at load time (default none)\n");
+  printf("  -color_size auto|N           max faces per color, auto tunes by cache size (default auto)\n");
+  printf("  -batch 0|4|8                 conflict free face batches, avx2/avx512 kernel (default 0)\n");
+  printf("  -segmented on|off            faces sorted by point, register accumulation (default off)\n");
+  printf("  -engine face|csr             face scatter or point gather gradients (default face)\n");
+  printf("  -rk N                        benchmark N stage RK time steps, 0 off (default 0)\n");
+  printf("  -first_touch on|off          point data placed by the owner threads (default on)\n");
+  printf("  -numa_report on|off          pages of var/grad per NUMA node (default off)\n");
+  printf("  -nthreads N                  OpenMP threads per rank (default USE_NTHREADS)\n");
+  printf("  -affinity off|compact        pin threads to the cores of the rank (default compact)\n");
+  printf("  -progress none|core|smt      reserve a core/SMT sibling for comm progress (default none)\n");
+  printf("  -schedule static|steal       color schedule of the comm free gradients (default static)\n");
+  printf("  -barrier central|tree|dissemination|neighbor thread barriers and elections (default central)\n");
+  printf("  -progress_thread on|off      MPI async by a communication thread (default off)\n");
+  printf("  -barrier_bench N             benchmark N barriers/elections per mode, 0 off (default 0)\n");
+  printf("  -balance points|cost|measured|graph thread split by points, cost model, measured, graph bisection (default points)\n");
+  printf("  -cross_faces duplicate|buffer cross thread faces computed twice or once (default duplicate)\n");
+  exit(EXIT_FAILURE);
+}
+
+static int parse_layout(char *prog, const char *arg)
+{
+  if (strcmp(arg,"aos") == 0)
+    {
+      return LAYOUT_AOS;
+    }
+  else if (strcmp(arg,"aos8") == 0)
+    {
+      return LAYOUT_AOS_PADDED;
+    }
+  else if (strcmp(arg,"soa") == 0)
+    {
+      return LAYOUT_SOA;
+    }
+  else if (strcmp(arg,"aosoa") == 0)
+    {
+      return LAYOUT_AOSOA;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_precision(char *prog, const char *arg)
+{
+  if (strcmp(arg,"double") == 0)
+    {
+      return PRECISION_DOUBLE;
+    }
+  else if (strcmp(arg,"mixed") == 0)
+    {
+      return PRECISION_MIXED;
+    }
+  else if (strcmp(arg,"float") == 0)
+    {
+      return PRECISION_FLOAT;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_renumber(char *prog, const char *arg)
+{
+  if (strcmp(arg,"none") == 0)
+    {
+      return RENUMBER_NONE;
+    }
+  else if (strcmp(arg,"rcm") == 0)
+    {
+      return RENUMBER_RCM;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_color_size(char *prog, const char *arg)
+{
+  if (strcmp(arg,"auto") == 0)
+    {
+      return COLOR_SIZE_AUTO;
+    }
+  else if (atoi(arg) > 0)
+    {
+      return atoi(arg);
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_batch(char *prog, const char *arg)
+{
+  if (strcmp(arg,"0") == 0 || strcmp(arg,"4") == 0 || strcmp(arg,"8") == 0)
+    {
+      return atoi(arg);
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_on_off(char *prog, const char *arg)
+{
+  if (strcmp(arg,"on") == 0)
+    {
+      return 1;
+    }
+  else if (strcmp(arg,"off") == 0)
+    {
+      return 0;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_engine(char *prog, const char *arg)
+{
+  if (strcmp(arg,"face") == 0)
+    {
+      return ENGINE_FACE;
+    }
+  else if (strcmp(arg,"csr") == 0)
+    {
+      return ENGINE_CSR;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_affinity(char *prog, const char *arg)
+{
+  if (strcmp(arg,"off") == 0)
+    {
+      return AFFINITY_OFF;
+    }
+  else if (strcmp(arg,"compact") == 0)
+    {
+      return AFFINITY_COMPACT;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_progress(char *prog, const char *arg)
+{
+  if (strcmp(arg,"none") == 0)
+    {
+      return PROGRESS_NONE;
+    }
+  else if (strcmp(arg,"core") == 0)
+    {
+      return PROGRESS_CORE;
+    }
+  else if (strcmp(arg,"smt") == 0)
+    {
+      return PROGRESS_SMT;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_schedule(char *prog, const char *arg)
+{
+  if (strcmp(arg,"static") == 0)
+    {
+      return SCHEDULE_STATIC;
+    }
+  else if (strcmp(arg,"steal") == 0)
+    {
+      return SCHEDULE_STEAL;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_barrier(char *prog, const char *arg)
+{
+  if (strcmp(arg,"central") == 0)
+    {
+      return BARRIER_CENTRAL;
+    }
+  else if (strcmp(arg,"tree") == 0)
+    {
+      return BARRIER_TREE;
+    }
+  else if (strcmp(arg,"dissemination") == 0)
+    {
+      return BARRIER_DISSEMINATION;
+    }
+  else if (strcmp(arg,"neighbor") == 0)
+    {
+      return BARRIER_NEIGHBOR;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_balance(char *prog, const char *arg)
+{
+  if (strcmp(arg,"points") == 0)
+    {
+      return BALANCE_POINTS;
+    }
+  else if (strcmp(arg,"cost") == 0)
+    {
+      return BALANCE_COST;
+    }
+  else if (strcmp(arg,"measured") == 0)
+    {
+      return BALANCE_MEASURED;
+    }
+  else if (strcmp(arg,"graph") == 0)
+    {
+      return BALANCE_GRAPH;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_cross_faces(char *prog, const char *arg)
+{
+  if (strcmp(arg,"duplicate") == 0)
+    {
+      return CROSS_DUPLICATE;
+    }
+  else if (strcmp(arg,"buffer") == 0)
+    {
+      return CROSS_BUFFER;
+    }
+  usage(prog);
+  return -1;
+}
+
+static int parse_isa(char *prog, const char *arg)
+{
+  if (strcmp(arg,"auto") == 0)
+    {
+      return ISA_AUTO;
+    }
+  else if (strcmp(arg,"scalar") == 0)
+    {
+      return ISA_SCALAR;
+    }
+  else if (strcmp(arg,"avx2") == 0)
+    {
+      return ISA_AVX2;
+    }
+  else if (strcmp(arg,"avx512") == 0)
+    {
+      return ISA_AVX512;
+    }
+  usage(prog);
+  return -1;
+}
+
+void parse_options(int argc, char *argv[], solver_options *opt)
+{
+  int i;
+
+  /* defaults */
+  opt->lvl = -1;
+  opt->grid_prefix = NULL;
+  opt->layout = LAYOUT_AOS;
+  opt->isa = ISA_AUTO;
+  opt->ngrad = NGRAD;
+  opt->precision = PRECISION_DOUBLE;
+  opt->renumber = RENUMBER_NONE;
+  opt->color_size = COLOR_SIZE_AUTO;
+  opt->batch = 0;
+  opt->segmented = 0;
+  opt->engine = ENGINE_FACE;
+  opt->rk_stages = 0;
+  opt->first_touch = 1;
+  opt->numa_report = 0;
+  opt->nthreads = 0;
+  opt->affinity = AFFINITY_COMPACT;
+  opt->progress = PROGRESS_NONE;
+  opt->schedule = SCHEDULE_STATIC;
+  opt->barrier = BARRIER_CENTRAL;
+  opt->barrier_bench = 0;
+  opt->progress_thread = 0;
+  opt->balance = BALANCE_POINTS;
+  opt->cross_faces = CROSS_DUPLICATE;
+
+  for (i = 1; i < argc; i++)
+    {
+      const int has_arg = (i + 1 < argc);
+      if (strcmp(argv[i],"-lvl") == 0 && has_arg)
+	{
+	  opt->lvl = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i],"-layout") == 0 && has_arg)
+	{
+	  opt->layout = parse_layout(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-isa") == 0 && has_arg)
+	{
+	  opt->isa = parse_isa(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-ngrad") == 0 && has_arg)
+	{
+	  opt->ngrad = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i],"-precision") == 0 && has_arg)
+	{
+	  opt->precision = parse_precision(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-renumber") == 0 && has_arg)
+	{
+	  opt->renumber = parse_renumber(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-color_size") == 0 && has_arg)
+	{
+	  opt->color_size = parse_color_size(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-batch") == 0 && has_arg)
+	{
+	  opt->batch = parse_batch(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-segmented") == 0 && has_arg)
+	{
+	  opt->segmented = parse_on_off(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-engine") == 0 && has_arg)
+	{
+	  opt->engine = parse_engine(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-rk") == 0 && has_arg)
+	{
+	  opt->rk_stages = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i],"-first_touch") == 0 && has_arg)
+	{
+	  opt->first_touch = parse_on_off(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-numa_report") == 0 && has_arg)
+	{
+	  opt->numa_report = parse_on_off(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-nthreads") == 0 && has_arg)
+	{
+	  opt->nthreads = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i],"-affinity") == 0 && has_arg)
+	{
+	  opt->affinity = parse_affinity(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-progress") == 0 && has_arg)
+	{
+	  opt->progress = parse_progress(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-schedule") == 0 && has_arg)
+	{
+	  opt->schedule = parse_schedule(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-barrier") == 0 && has_arg)
+	{
+	  opt->barrier = parse_barrier(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-progress_thread") == 0 && has_arg)
+	{
+	  opt->progress_thread = parse_on_off(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-barrier_bench") == 0 && has_arg)
+	{
+	  opt->barrier_bench = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i],"-balance") == 0 && has_arg)
+	{
+	  opt->balance = parse_balance(argv[0], argv[++i]);
+	}
+      else if (strcmp(argv[i],"-cross_faces") == 0 && has_arg)
+	{
+	  opt->cross_faces = parse_cross_faces(argv[0], argv[++i]);
+	}
+      else if (argv[i][0] != '-' && opt->grid_prefix == NULL)
+	{
+	  opt->grid_prefix = argv[i];
+	}
+      else
+	{
+	  usage(argv[0]);
+	}
+    }
+
+  if (opt->lvl < 0 || opt->grid_prefix == NULL || opt->ngrad < 1
+      || opt->rk_stages < 0 || opt->nthreads < 0 || opt->barrier_bench < 0
+      || (opt->batch > 0 && opt->segmented)
+      || (opt->engine == ENGINE_CSR && opt->segmented)
+      || (opt->engine == ENGINE_CSR && opt->cross_faces == CROSS_BUFFER)
+      || (opt->schedule == SCHEDULE_STEAL && opt->segmented))
+    {
+      usage(argv[0]);
+    }
+}
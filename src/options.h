@@ -0,0 +1,33 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+typedef struct
+{
+  int  lvl;
+  char *grid_prefix;
+  int  layout;
+  int  isa;
+  int  ngrad;
+  int  precision;
+  int  renumber;
+  int  color_size;
+  int  batch;
+  int  segmented;
+  int  engine;
+  int  rk_stages;
+  int  first_touch;
+  int  numa_report;
+  int  nthreads;
+  int  affinity;
+  int  progress;
+  int  schedule;
+  int  barrier;
+  int  barrier_bench;
+  int  progress_thread;
+  int  balance;
+  int  cross_faces;
+} solver_options;
+
+void parse_options(int argc, char *argv[], solver_options *opt);
+
+#endif
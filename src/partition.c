@@ -0,0 +1,600 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct:
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel:
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "partition.h"
+#include "error_handling.h"
+#include "util.h"
+
+/*----------------------------------------------------------------------------
+| thread domains by multilevel recursive bisection of the face graph.
+| Every face between two thread domains is computed twice (ftype 2 and 3),
+| the bisection minimizes the number of these cut faces under a balance
+| constraint on the vertex weight, faces per point plus two per halo point
+| (the face cost of BALANCE_COST in half faces).
+|
+| A bisection coarsens the graph by heavy edge matching until it is small
+| or stops shrinking, bisects the coarsest graph by graph growing from a
+| few seeds and projects the best one back, level by level, with greedy
+| boundary refinement. n parts are split into n/2 and n - n/2 parts with
+| the matching weight ratio, the induced subgraphs are bisected again.
+----------------------------------------------------------------------------*/
+
+#define COARSEN_MIN    64   // vertices of the coarsest graph
+#define COARSEN_RATIO  0.95 // min shrink per level
+#define INIT_SEEDS     4    // graph growing seeds of the initial bisection
+#define REFINE_PASSES  8
+#define BALANCE_TOL    0.02 // of the graph weight
+
+typedef struct pgraph_t
+{
+  int n;
+  int *xadj;
+  int *adj;
+  int *ewgt;
+  int *vwgt;
+  int *cmap;   // vertex of the coarser graph
+  struct pgraph_t *coarser;
+} pgraph;
+
+static pgraph* alloc_graph(int n, int nedges)
+{
+  pgraph *g = check_malloc(sizeof(pgraph));
+  g->n = n;
+  g->xadj = check_malloc((n + 1) * sizeof(int));
+  g->adj = check_malloc(MAX(nedges, 1) * sizeof(int));
+  g->ewgt = check_malloc(MAX(nedges, 1) * sizeof(int));
+  g->vwgt = check_malloc(MAX(n, 1) * sizeof(int));
+  g->cmap = NULL;
+  g->coarser = NULL;
+  return g;
+}
+
+static void free_graph(pgraph *g)
+{
+  check_free(g->xadj);
+  check_free(g->adj);
+  check_free(g->ewgt);
+  check_free(g->vwgt);
+  check_free(g->cmap);
+  check_free(g);
+}
+
+static long graph_weight(const pgraph *g)
+{
+  long w = 0;
+  int v;
+  for(v = 0; v < g->n; v++)
+    {
+      w += g->vwgt[v];
+    }
+  return w;
+}
+
+static long edge_cut(const pgraph *g, const int *part)
+{
+  long cut = 0;
+  int v, j;
+  for(v = 0; v < g->n; v++)
+    {
+      for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	{
+	  if (part[g->adj[j]] != part[v])
+	    {
+	      cut += g->ewgt[j];
+	    }
+	}
+    }
+  return cut / 2;
+}
+
+
+/* heavy edge matching, the coarse graph merges the edges of a pair */
+static pgraph* coarsen(pgraph *g)
+{
+  const int n = g->n;
+  int *match = check_malloc(MAX(n, 1) * sizeof(int));
+  int v, j, nc = 0;
+
+  for(v = 0; v < n; v++)
+    {
+      match[v] = -1;
+    }
+  for(v = 0; v < n; v++)
+    {
+      if (match[v] != -1)
+	{
+	  continue;
+	}
+      int best = v, wbest = 0;
+      for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	{
+	  const int u = g->adj[j];
+	  if (match[u] == -1 && u != v && g->ewgt[j] > wbest)
+	    {
+	      best = u;
+	      wbest = g->ewgt[j];
+	    }
+	}
+      match[v] = best;
+      match[best] = v;
+    }
+
+  g->cmap = check_malloc(MAX(n, 1) * sizeof(int));
+  int *first = check_malloc(MAX(n, 1) * sizeof(int));
+  for(v = 0; v < n; v++)
+    {
+      g->cmap[v] = -1;
+    }
+  for(v = 0; v < n; v++)
+    {
+      if (g->cmap[v] == -1)
+	{
+	  g->cmap[v] = nc;
+	  g->cmap[match[v]] = nc;
+	  first[nc++] = v;
+	}
+    }
+
+  /* coarse edges, pos[c] is the slot of coarse neighbor c of the
+     current coarse vertex, -1 if none */
+  pgraph *c = alloc_graph(nc, g->xadj[n]);
+  int *pos = check_malloc(MAX(nc, 1) * sizeof(int));
+  for(v = 0; v < nc; v++)
+    {
+      pos[v] = -1;
+    }
+  int nedges = 0;
+  for(v = 0; v < nc; v++)
+    {
+      const int v0 = first[v], v1 = match[v0];
+      const int start = nedges;
+      int k;
+      c->xadj[v] = nedges;
+      c->vwgt[v] = g->vwgt[v0] + ((v1 != v0) ? g->vwgt[v1] : 0);
+      for(k = 0; k < ((v1 != v0) ? 2 : 1); k++)
+	{
+	  const int u = (k == 0) ? v0 : v1;
+	  for(j = g->xadj[u]; j < g->xadj[u + 1]; j++)
+	    {
+	      const int cu = g->cmap[g->adj[j]];
+	      if (cu == v)
+		{
+		  continue;
+		}
+	      if (pos[cu] == -1)
+		{
+		  pos[cu] = nedges;
+		  c->adj[nedges] = cu;
+		  c->ewgt[nedges] = 0;
+		  nedges++;
+		}
+	      c->ewgt[pos[cu]] += g->ewgt[j];
+	    }
+	}
+      for(j = start; j < nedges; j++)
+	{
+	  pos[c->adj[j]] = -1;
+	}
+    }
+  c->xadj[nc] = nedges;
+
+  check_free(pos);
+  check_free(first);
+  check_free(match);
+  return c;
+}
+
+
+/* moves of boundary vertices with positive gain, or zero gain towards
+   the target weight tw0 of side 0, which keep |w0 - tw0| <= tol */
+static void refine(const pgraph *g
+		   , int *part
+		   , long tw0
+		   , long tol
+		   )
+{
+  long w0 = 0;
+  int v, j, pass;
+  for(v = 0; v < g->n; v++)
+    {
+      if (part[v] == 0)
+	{
+	  w0 += g->vwgt[v];
+	}
+    }
+
+  /* balance first, heavy side boundary vertices by gain class */
+  int sweep;
+  for(sweep = 0; sweep < 3 && labs(w0 - tw0) > tol; sweep++)
+    {
+      const int heavy = (w0 > tw0) ? 0 : 1;
+      for(v = 0; v < g->n && labs(w0 - tw0) > tol; v++)
+	{
+	  if (part[v] != heavy)
+	    {
+	      continue;
+	    }
+	  int ext = 0, in = 0;
+	  for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	    {
+	      if (part[g->adj[j]] == heavy)
+		{
+		  in += g->ewgt[j];
+		}
+	      else
+		{
+		  ext += g->ewgt[j];
+		}
+	    }
+	  const long nw0 = w0 + ((heavy == 0) ? -g->vwgt[v] : g->vwgt[v]);
+	  if ((sweep == 0 && ext > 0 && ext >= in)
+	      || (sweep == 1 && ext > 0)
+	      || sweep == 2)
+	    {
+	      if (labs(nw0 - tw0) < labs(w0 - tw0))
+		{
+		  part[v] = 1 - heavy;
+		  w0 = nw0;
+		}
+	    }
+	}
+    }
+
+  for(pass = 0; pass < REFINE_PASSES; pass++)
+    {
+      int moved = 0;
+      for(v = 0; v < g->n; v++)
+	{
+	  const int s = part[v];
+	  int ext = 0, in = 0;
+	  for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	    {
+	      if (part[g->adj[j]] == s)
+		{
+		  in += g->ewgt[j];
+		}
+	      else
+		{
+		  ext += g->ewgt[j];
+		}
+	    }
+	  if (ext == 0)
+	    {
+	      continue;
+	    }
+	  const long nw0 = w0 + ((s == 0) ? -g->vwgt[v] : g->vwgt[v]);
+	  if (labs(nw0 - tw0) > tol)
+	    {
+	      continue;
+	    }
+	  if (ext > in || (ext == in && labs(nw0 - tw0) < labs(w0 - tw0)))
+	    {
+	      part[v] = 1 - s;
+	      w0 = nw0;
+	      moved++;
+	    }
+	}
+      if (moved == 0)
+	{
+	  break;
+	}
+    }
+}
+
+
+/* side 0 grows breadth first from seed up to the weight tw0 */
+static void grow(const pgraph *g
+		 , int seed
+		 , long tw0
+		 , int *part
+		 , int *queue
+		 )
+{
+  long w0 = 0;
+  int head = 0, tail = 0, next = 0, v, j;
+
+  for(v = 0; v < g->n; v++)
+    {
+      part[v] = 1;
+    }
+  part[seed] = 0;
+  queue[tail++] = seed;
+  w0 += g->vwgt[seed];
+  while (w0 < tw0)
+    {
+      if (head == tail)
+	{
+	  /* disconnected, next unvisited vertex */
+	  while (next < g->n && part[next] == 0)
+	    {
+	      next++;
+	    }
+	  if (next == g->n)
+	    {
+	      break;
+	    }
+	  part[next] = 0;
+	  queue[tail++] = next;
+	  w0 += g->vwgt[next];
+	  continue;
+	}
+      v = queue[head++];
+      for(j = g->xadj[v]; j < g->xadj[v + 1] && w0 < tw0; j++)
+	{
+	  const int u = g->adj[j];
+	  if (part[u] == 1)
+	    {
+	      part[u] = 0;
+	      queue[tail++] = u;
+	      w0 += g->vwgt[u];
+	    }
+	}
+    }
+}
+
+static void initial_bisection(const pgraph *g
+			      , long tw0
+			      , long tol
+			      , int *part
+			      )
+{
+  int *queue = check_malloc(MAX(g->n, 1) * sizeof(int));
+  int *trial = check_malloc(MAX(g->n, 1) * sizeof(int));
+  long best = -1;
+  int k;
+  for(k = 0; k < INIT_SEEDS && k < g->n; k++)
+    {
+      grow(g, (int) ((long) k * g->n / INIT_SEEDS), tw0, trial, queue);
+      refine(g, trial, tw0, tol);
+      const long cut = edge_cut(g, trial);
+      if (best < 0 || cut < best)
+	{
+	  best = cut;
+	  memcpy(part, trial, g->n * sizeof(int));
+	}
+    }
+  check_free(queue);
+  check_free(trial);
+}
+
+
+/* multilevel bisection, side 0 of weight tw0 */
+static void bisect(pgraph *g
+		   , long tw0
+		   , int *part
+		   )
+{
+  const long tol = MAX((long) (BALANCE_TOL * graph_weight(g)), 1);
+  pgraph *level = g;
+  int v;
+
+  /* coarsen */
+  while (level->n > COARSEN_MIN)
+    {
+      pgraph *c = coarsen(level);
+      if (c->n > COARSEN_RATIO * level->n)
+	{
+	  free_graph(c);
+	  check_free(level->cmap);
+	  level->cmap = NULL;
+	  break;
+	}
+      level->coarser = c;
+      level = c;
+    }
+
+  /* bisect the coarsest graph */
+  int *cpart = check_malloc(MAX(level->n, 1) * sizeof(int));
+  if (level->n > 0)
+    {
+      initial_bisection(level, tw0, tol, cpart);
+    }
+
+  /* project and refine, finest level last */
+  while (level != g)
+    {
+      pgraph *fine = g;
+      while (fine->coarser != level)
+	{
+	  fine = fine->coarser;
+	}
+      int *fpart = (fine == g) ? part : check_malloc(MAX(fine->n, 1) * sizeof(int));
+      for(v = 0; v < fine->n; v++)
+	{
+	  fpart[v] = cpart[fine->cmap[v]];
+	}
+      refine(fine, fpart, tw0, tol);
+      check_free(cpart);
+      free_graph(level);
+      fine->coarser = NULL;
+      check_free(fine->cmap);
+      fine->cmap = NULL;
+      cpart = fpart;
+      level = fine;
+    }
+  if (cpart != part)
+    {
+      memcpy(part, cpart, g->n * sizeof(int));
+      check_free(cpart);
+    }
+}
+
+
+/* subgraph of the vertices of side, id maps the new vertices to points */
+static pgraph* induced_graph(const pgraph *g
+			     , const int *part
+			     , int side
+			     , const int *id
+			     , int **sub_id
+			     )
+{
+  int *map = check_malloc(MAX(g->n, 1) * sizeof(int));
+  int v, j, n = 0, nedges = 0;
+  for(v = 0; v < g->n; v++)
+    {
+      map[v] = (part[v] == side) ? n++ : -1;
+    }
+  for(v = 0; v < g->n; v++)
+    {
+      if (part[v] == side)
+	{
+	  for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	    {
+	      if (part[g->adj[j]] == side)
+		{
+		  nedges++;
+		}
+	    }
+	}
+    }
+
+  pgraph *s = alloc_graph(n, nedges);
+  *sub_id = check_malloc(MAX(n, 1) * sizeof(int));
+  nedges = 0;
+  for(v = 0; v < g->n; v++)
+    {
+      if (part[v] != side)
+	{
+	  continue;
+	}
+      const int sv = map[v];
+      s->xadj[sv] = nedges;
+      s->vwgt[sv] = g->vwgt[v];
+      (*sub_id)[sv] = id[v];
+      for(j = g->xadj[v]; j < g->xadj[v + 1]; j++)
+	{
+	  if (part[g->adj[j]] == side)
+	    {
+	      s->adj[nedges] = map[g->adj[j]];
+	      s->ewgt[nedges] = g->ewgt[j];
+	      nedges++;
+	    }
+	}
+    }
+  s->xadj[n] = nedges;
+  check_free(map);
+  return s;
+}
+
+static void recursive_bisection(pgraph *g
+				, const int *id
+				, int nparts
+				, int first
+				, int *pid
+				)
+{
+  int v;
+  if (nparts == 1 || g->n == 0)
+    {
+      for(v = 0; v < g->n; v++)
+	{
+	  pid[id[v]] = first;
+	}
+      return;
+    }
+
+  const int n0 = nparts / 2;
+  const long tw0 = graph_weight(g) * n0 / nparts;
+  int *part = check_malloc(MAX(g->n, 1) * sizeof(int));
+  bisect(g, tw0, part);
+
+  int *id0, *id1;
+  pgraph *g0 = induced_graph(g, part, 0, id, &id0);
+  pgraph *g1 = induced_graph(g, part, 1, id, &id1);
+  check_free(part);
+
+  recursive_bisection(g0, id0, n0, first, pid);
+  recursive_bisection(g1, id1, nparts - n0, first + n0, pid);
+
+  free_graph(g0);
+  free_graph(g1);
+  check_free(id0);
+  check_free(id1);
+}
+
+
+void partition_points(solver_data *sd
+		      , int *pid
+		      , int nparts
+		      )
+{
+  int i, face, n = 0;
+  int *map = check_malloc(MAX(sd->nallpoints, 1) * sizeof(int));
+  for(i = 0; i < sd->nallpoints; i++)
+    {
+      map[i] = (pid[i] >= 0) ? n++ : -1;
+    }
+
+  /* face graph of the partitioned points, a face is an edge of weight 1 */
+  int *deg = check_malloc(MAX(n, 1) * sizeof(int));
+  for(i = 0; i < n; i++)
+    {
+      deg[i] = 0;
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int v0 = map[sd->fpoint[face][0]];
+      const int v1 = map[sd->fpoint[face][1]];
+      if (v0 >= 0 && v1 >= 0 && v0 != v1)
+	{
+	  deg[v0]++;
+	  deg[v1]++;
+	}
+    }
+  int nedges = 0;
+  for(i = 0; i < n; i++)
+    {
+      nedges += deg[i];
+    }
+
+  pgraph *g = alloc_graph(n, nedges);
+  int *id = check_malloc(MAX(n, 1) * sizeof(int));
+  g->xadj[0] = 0;
+  for(i = 0; i < n; i++)
+    {
+      g->xadj[i + 1] = g->xadj[i] + deg[i];
+      deg[i] = g->xadj[i];
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int v0 = map[sd->fpoint[face][0]];
+      const int v1 = map[sd->fpoint[face][1]];
+      if (v0 >= 0 && v1 >= 0 && v0 != v1)
+	{
+	  g->adj[deg[v0]] = v1;
+	  g->ewgt[deg[v0]++] = 1;
+	  g->adj[deg[v1]] = v0;
+	  g->ewgt[deg[v1]++] = 1;
+	}
+    }
+  for(i = 0; i < sd->nallpoints; i++)
+    {
+      if (map[i] >= 0)
+	{
+	  const int v = map[i];
+	  id[v] = i;
+	  g->vwgt[v] = MAX(g->xadj[v + 1] - g->xadj[v], 1)
+	    + ((i >= sd->nownpoints) ? 2 : 0);
+	}
+    }
+  check_free(deg);
+  check_free(map);
+
+  recursive_bisection(g, id, nparts, 0, pid);
+
+  free_graph(g);
+  check_free(id);
+}
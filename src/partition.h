@@ -0,0 +1,14 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "solver_data.h"
+
+/* thread domains by multilevel recursive bisection of the face graph. 
+   Points with pid -1 are not partitioned, all others get a part in 
+   [0, nparts) */
+void partition_points(solver_data *sd
+		      , int *pid
+		      , int nparts
+		      );
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <omp.h>
+#include <mpi.h>
+
+#include "progress.h"
+#include "affinity.h"
+#include "threads.h"
+#include "exchange_data_mpi.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| communication progress thread. The compute threads do not call MPI, 
+| they push events into a single producer/single consumer ring each: 
+| "halo send of partner i complete" from the send trigger of a color 
+| (initiate_thread_comm_progress) and "iteration done" at the end of the
+| sweep. The progress thread drains the rings, packs and sends a partner 
+| as soon as its event arrives and keeps MPI progressing by testing the 
+| receives. When all compute threads are done it completes the sends, 
+| unpacks the halo, reposts the receives and bumps the done epoch, which 
+| releases the compute threads. No barrier, no critical section.
+|
+| The progress thread is not the thread which called MPI_Init, it needs 
+| MPI_THREAD_SERIALIZED. Only the progress thread calls MPI while the 
+| compute threads run, the master calls MPI only before and after the 
+| parallel region, while the progress thread is idle.
+----------------------------------------------------------------------------*/
+
+#define EVENT_DONE       -1
+#define EVENT_DONE_FINAL -2
+
+/* spins before the waiting threads yield */
+#define PROGRESS_SPIN 4096
+
+typedef struct
+{
+  volatile int head;     // written by the compute thread
+  char pad0[60];
+  volatile int tail;     // written by the progress thread
+  char pad1[60];
+  int *slot;
+  int mask;
+} __attribute__((aligned(64))) spsc_ring;
+
+typedef struct
+{
+  comm_data *cd;
+  double *data;
+  int dim2;
+  int nthreads;
+  int ndone;
+  int final;
+  volatile int active;
+  volatile int stop;
+  volatile int done_epoch;
+  spsc_ring *ring;
+  pthread_t thread;
+} progress_state;
+
+static progress_state ps = { NULL, NULL, 0, 0, 0, 0, 0, 0, 0, NULL, 0 };
+static bool running = false;
+
+static int epoch_local = 0;
+#pragma omp threadprivate(epoch_local)
+
+
+static inline void backoff(int *spin)
+{
+  if (++(*spin) < PROGRESS_SPIN)
+    {
+      _mm_pause();
+    }
+  else
+    {
+      sched_yield();
+      *spin = 0;
+    }
+}
+
+static void ring_push(spsc_ring *r, int ev)
+{
+  int spin = 0;
+  while (r->head - r->tail > r->mask)
+    {
+      backoff(&spin);
+    }
+  r->slot[r->head & r->mask] = ev;
+  __sync_synchronize();
+  r->head++;
+}
+
+static bool ring_pop(spsc_ring *r, int *ev)
+{
+  if (r->tail == r->head)
+    {
+      return false;
+    }
+  __sync_synchronize();
+  *ev = r->slot[r->tail & r->mask];
+  __sync_synchronize();
+  r->tail++;
+  return true;
+}
+
+
+static void post_recv_all(comm_data *cd)
+{
+  const int ncommdomains = cd->ncommdomains;
+  int i;
+  for(i = 0; i < ncommdomains; i++)
+    {
+      cd->req[i] = MPI_REQUEST_NULL;
+      cd->req[ncommdomains + i] = MPI_REQUEST_NULL;
+      exchange_dbl_mpi_post_recv_partner(cd, i);
+    }
+}
+
+/* all compute threads done: complete, unpack, next round */
+static void finish_iteration(void)
+{
+  comm_data *cd = ps.cd;
+  const int ncommdomains = cd->ncommdomains;
+  int i;
+
+  MPI_Waitall(2 * ncommdomains
+	      , cd->req
+	      , cd->stat
+	      );
+  for(i = 0; i < ncommdomains; i++)
+    {
+      exchange_dbl_mpi_copy_out_partner(cd, ps.data, ps.dim2, i);
+    }
+  cd->send_stage++;
+  cd->recv_stage++;
+
+  if (ps.final)
+    {
+      ps.active = 0;
+    }
+  else
+    {
+      post_recv_all(cd);
+    }
+  ps.ndone = 0;
+  ps.final = 0;
+  __sync_synchronize();
+  ps.done_epoch++;
+}
+
+static void *progress_main(void *arg)
+{
+  int spin = 0;
+  (void) arg;
+
+  while (!ps.stop)
+    {
+      bool work = false;
+      int t, ev;
+      for(t = 0; t < ps.nthreads; t++)
+	{
+	  while (ring_pop(&(ps.ring[t]), &ev))
+	    {
+	      work = true;
+	      if (ev >= 0)
+		{
+		  exchange_dbl_mpi_send(ps.cd, ps.data, ps.dim2, ev);
+		}
+	      else
+		{
+		  ps.final |= (ev == EVENT_DONE_FINAL);
+		  ps.ndone++;
+		}
+	    }
+	}
+
+      if (ps.active && ps.ndone == ps.nthreads)
+	{
+	  finish_iteration();
+	  work = true;
+	}
+      else if (ps.active)
+	{
+	  /* drive the MPI progress engine */
+	  int flag;
+	  MPI_Testall(ps.cd->ncommdomains, ps.cd->req, &flag, MPI_STATUSES_IGNORE);
+	}
+
+      if (work)
+	{
+	  spin = 0;
+	}
+      else
+	{
+	  backoff(&spin);
+	}
+    }
+  return NULL;
+}
+
+
+void init_progress_thread(comm_data *cd)
+{
+  const int nthreads = omp_get_max_threads();
+  const int cpu = get_progress_cpu();
+  int t, size = 16;
+  pthread_attr_t attr;
+
+  ASSERT(!running);
+  while (size < 2 * (cd->ncommdomains + 2))
+    {
+      size *= 2;
+    }
+
+  ps.cd = cd;
+  ps.nthreads = nthreads;
+  ps.ndone = 0;
+  ps.final = 0;
+  ps.active = 0;
+  ps.stop = 0;
+  ps.done_epoch = 0;
+  ps.ring = check_malloc_aligned(nthreads * sizeof(spsc_ring));
+  for(t = 0; t < nthreads; t++)
+    {
+      ps.ring[t].head = 0;
+      ps.ring[t].tail = 0;
+      ps.ring[t].slot = check_malloc(size * sizeof(int));
+      ps.ring[t].mask = size - 1;
+    }
+
+#pragma omp parallel default (none)
+  {
+    epoch_local = 0;
+  }
+
+  pthread_attr_init(&attr);
+  if (cpu >= 0)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+  ASSERT(pthread_create(&(ps.thread), &attr, progress_main, NULL) == 0);
+  pthread_attr_destroy(&attr);
+  running = true;
+
+  if (cd->iProc == 0)
+    {
+      printf("progress thread cpu: %d\n", cpu);
+    }
+}
+
+
+void free_progress_thread(void)
+{
+  int t;
+  if (!running)
+    {
+      return;
+    }
+  ps.stop = 1;
+  pthread_join(ps.thread, NULL);
+  for(t = 0; t < ps.nthreads; t++)
+    {
+      check_free(ps.ring[t].slot);
+    }
+  check_free(ps.ring);
+  ps.ring = NULL;
+  running = false;
+}
+
+
+bool progress_thread_active(void)
+{
+  return running;
+}
+
+
+void progress_post_recv(comm_data *cd
+			, double *data
+			, int dim2
+			)
+{
+  ASSERT(running && cd == ps.cd);
+  ASSERT(!ps.active);
+  ASSERT(dim2 <= cd->max_elem_sz);
+  ps.data = data;
+  ps.dim2 = dim2;
+  post_recv_all(cd);
+  __sync_synchronize();
+  ps.active = 1;
+}
+
+
+void progress_push_send(int i)
+{
+  ring_push(&(ps.ring[omp_get_thread_num()]), i);
+}
+
+
+void exchange_dbl_progress(int final)
+{
+  const int e = ++epoch_local;
+  int spin = 0;
+
+  ring_push(&(ps.ring[omp_get_thread_num()])
+	    , final ? EVENT_DONE_FINAL : EVENT_DONE);
+  while (ps.done_epoch < e)
+    {
+      backoff(&spin);
+    }
+  __sync_synchronize();
+}
@@ -0,0 +1,30 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdbool.h>
+
+#include "comm_data.h"
+
+/* start the communication thread, pinned to get_progress_cpu() if a 
+   cpu is reserved (-progress core|smt). One event ring per OpenMP 
+   thread, requires omp_set_num_threads */
+void init_progress_thread(comm_data *cd);
+
+void free_progress_thread(void);
+
+bool progress_thread_active(void);
+
+/* before the parallel region, like exchange_dbl_mpi_post_recv */
+void progress_post_recv(comm_data *cd
+			, double *data
+			, int dim2
+			);
+
+/* compute thread: halo send of commdomain i is complete */
+void progress_push_send(int i);
+
+/* compute thread: end of the iteration, returns once all threads are 
+   done and the halo is unpacked */
+void exchange_dbl_progress(int final);
+
+#endif
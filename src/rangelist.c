@@ -23,6 +23,8 @@
 #include "util.h"
 #include "rangelist.h"
 #include "threads.h"
+#include "barrier.h"
+#include "partition.h"
 
 // threadprivate rangelist data
 static RangeList *color_local = NULL;
@@ -34,15 +36,33 @@ static int ncolors_local = 0;
 static solver_data_local solver_local;
 #pragma omp threadprivate(solver_local)
 
+/* face data of another thread, while running one of its colors */
+static solver_data_local *foreign_local = NULL;
+#pragma omp threadprivate(foreign_local)
+
+/* index of a point among the points of its thread, -1 for none. 
+   Per-thread scratch is sized to the own points, npoints_local */
+static int *local_index = NULL;
+static int npoints_local = 0;
+#pragma omp threadprivate(npoints_local)
+
 void init_rangelist(RangeList *fcolor)
 {  
   // next slice - linked list
   fcolor->succ = NULL;
 
+  // face kernel
+  fcolor->kernel = NULL;
+
   // meta data
   fcolor->start = 0;
   fcolor->stop = 0;
   fcolor->ftype = 0; //  face type   
+  fcolor->batch_stop = 0;
+  fcolor->nbuffer_points = 0;
+  fcolor->buffer_points = NULL;
+  fcolor->nreduce_points = 0;
+  fcolor->reduce_points = NULL;
 
   // points of color
   fcolor->nall_points_of_color = 0;
@@ -157,6 +177,618 @@ static void init_meta_data(int *pid
 
 
 
+/*----------------------------------------------------------------------------
+| thread balance. BALANCE_POINTS (init_meta_data) cuts the preprocessed 
+| colors into runs of nallpoints/NTHREADS points. The face kernel cost is 
+| not in the points: BALANCE_COST balances the modelled thread cost
+|
+|   faces with a point of the thread (cross faces count on both sides)
+|   + BALANCE_HALO_WEIGHT per halo point of the thread
+|
+| where a face or halo point counts with the rate of its point of the 
+| thread (set_thread_rates, 1 without measured times). The runs are the 
+| min-max partition of the color sequence, a bisection on the max thread 
+| cost with one greedy pass per bound. The cost of a color depends on the
+| thread it joins, a face to a point already in the thread does not count 
+| again.
+| BALANCE_GRAPH ignores the colors and bisects the face graph of the 
+| points (partition.c), fewer duplicated cross faces at the same cost.
+----------------------------------------------------------------------------*/
+
+#define BALANCE_HALO_WEIGHT 1.0
+#define BALANCE_BISECTIONS  32
+
+static int balance_mode = BALANCE_POINTS;
+
+/* rate per point, NULL for 1 */
+static double *point_rate = NULL;
+
+void set_balance_mode(int mode)
+{
+  balance_mode = mode;
+}
+
+int get_balance_mode(void)
+{
+  return balance_mode;
+}
+
+void set_thread_rates(solver_data *sd
+		      , const int *pid
+		      , const double *rate
+		      )
+{
+  int i;
+  check_free(point_rate);
+  point_rate = NULL;
+  if (rate == NULL)
+    {
+      return;
+    }
+  point_rate = check_malloc(sd->nallpoints * sizeof(double));
+  for(i = 0; i < sd->nallpoints; i++)
+    {
+      point_rate[i] = (pid[i] >= 0) ? rate[pid[i]] : 1.0;
+    }
+}
+
+static inline double rate_of(int pnt)
+{
+  return (point_rate != NULL) ? point_rate[pnt] : 1.0;
+}
+
+void get_thread_cost(solver_data *sd
+		     , const int *pid
+		     , int NTHREADS
+		     , double *cost
+		     )
+{
+  int i, face;
+  for(i = 0; i < NTHREADS; i++)
+    {
+      cost[i] = 0.0;
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (pid[p0] >= 0)
+	{
+	  cost[pid[p0]] += rate_of(p0);
+	}
+      if (pid[p1] >= 0 && pid[p1] != pid[p0])
+	{
+	  cost[pid[p1]] += rate_of(p1);
+	}
+    }
+  for(i = sd->nownpoints; i < sd->nallpoints; i++)
+    {
+      if (pid[i] >= 0)
+	{
+	  cost[pid[i]] += BALANCE_HALO_WEIGHT * rate_of(i);
+	}
+    }
+}
+
+double thread_imbalance(const double *cost, int NTHREADS)
+{
+  double max = 0.0, sum = 0.0;
+  int i;
+  for(i = 0; i < NTHREADS; i++)
+    {
+      max = MAX(max, cost[i]);
+      sum += cost[i];
+    }
+  return (sum > 0.0) ? max * NTHREADS / sum : 1.0;
+}
+
+
+/* point to point adjacency, CSR */
+typedef struct
+{
+  int *start;
+  int *point;
+} point_graph;
+
+static void init_point_graph(point_graph *g, solver_data *sd)
+{
+  int i, face;
+  g->start = check_malloc((sd->nallpoints + 1) * sizeof(int));
+  for(i = 0; i <= sd->nallpoints; i++)
+    {
+      g->start[i] = 0;
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      g->start[sd->fpoint[face][0] + 1]++;
+      g->start[sd->fpoint[face][1] + 1]++;
+    }
+  for(i = 0; i < sd->nallpoints; i++)
+    {
+      g->start[i + 1] += g->start[i];
+    }
+  int *fill = check_malloc(MAX(sd->nallpoints, 1) * sizeof(int));
+  memcpy(fill, g->start, sd->nallpoints * sizeof(int));
+  g->point = check_malloc(MAX(g->start[sd->nallpoints], 1) * sizeof(int));
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      g->point[fill[p0]++] = p1;
+      g->point[fill[p1]++] = p0;
+    }
+  check_free(fill);
+}
+
+static void free_point_graph(point_graph *g)
+{
+  check_free(g->start);
+  check_free(g->point);
+}
+
+/* cost of color c joining thread k. Points of the color are stamped c, 
+   a face within the color counts half from either side */
+static double color_cost(solver_data *sd
+			 , const point_graph *g
+			 , const int *pid
+			 , int *stamp
+			 , int c
+			 , int k
+			 )
+{
+  const RangeList *color = &(sd->fcolor[c]);
+  double cost = 0.0;
+  int i, j;
+  for(i = 0; i < color->nall_points_of_color; i++)
+    {
+      stamp[color->all_points_of_color[i]] = c;
+    }
+  for(i = 0; i < color->nall_points_of_color; i++)
+    {
+      const int pnt = color->all_points_of_color[i];
+      const double rate = rate_of(pnt);
+      for(j = g->start[pnt]; j < g->start[pnt + 1]; j++)
+	{
+	  const int q = g->point[j];
+	  if (stamp[q] == c)
+	    {
+	      cost += 0.5 * rate;
+	    }
+	  else if (pid[q] != k)
+	    {
+	      cost += rate;
+	    }
+	}
+      if (pnt >= sd->nownpoints)
+	{
+	  cost += BALANCE_HALO_WEIGHT * rate;
+	}
+    }
+  return cost;
+}
+
+/* greedy runs of colors with a thread cost of at most bound, the last
+   thread takes the rest. Returns the max thread cost */
+static double partition_colors(solver_data *sd
+			       , const point_graph *g
+			       , int *pid
+			       , int *stamp
+			       , int NTHREADS
+			       , double bound
+			       )
+{
+  double cost = 0.0, max_cost = 0.0;
+  int i, j, k = 0;
+  for(i = 0; i < sd->nallpoints; i++)
+    {
+      pid[i] = -1;
+      stamp[i] = -1;
+    }
+  for(i = 0; i < sd->ncolors; i++)
+    {
+      const RangeList *color = &(sd->fcolor[i]);
+      double inc = color_cost(sd, g, pid, stamp, i, k);
+      if (cost > 0.0 && cost + inc > bound && k < NTHREADS - 1)
+	{
+	  k++;
+	  cost = 0.0;
+	  inc = color_cost(sd, g, pid, stamp, i, k);
+	}
+      for(j = 0; j < color->nall_points_of_color; j++)
+	{
+	  ASSERT(pid[color->all_points_of_color[j]] == -1);
+	  pid[color->all_points_of_color[j]] = k;
+	}
+      cost += inc;
+      max_cost = MAX(max_cost, cost);
+    }
+  return max_cost;
+}
+
+/* fraction of the faces between two threads, computed by both */
+static double cross_face_fraction(solver_data *sd, const int *pid)
+{
+  int face, ncross = 0;
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (pid[p0] >= 0 && pid[p1] >= 0 && pid[p0] != pid[p1])
+	{
+	  ncross++;
+	}
+    }
+  return (double) ncross / MAX(sd->nfaces, 1);
+}
+
+
+static void init_meta_data_cost(int *pid
+				, int NTHREADS
+				, solver_data *sd
+				)
+{
+  point_graph g;
+  int *stamp = check_malloc(MAX(sd->nallpoints, 1) * sizeof(int));
+  int i;
+
+  init_point_graph(&g, sd);
+
+  /* bisection on the max thread cost, all colors in one thread bound it */
+  double lo = 0.0;
+  double hi = partition_colors(sd, &g, pid, stamp, 1, 0.0);
+  for(i = 0; i < BALANCE_BISECTIONS && hi - lo > 0.5; i++)
+    {
+      const double mid = 0.5 * (lo + hi);
+      if (partition_colors(sd, &g, pid, stamp, NTHREADS, mid) <= mid)
+	{
+	  hi = mid;
+	}
+      else
+	{
+	  lo = mid;
+	}
+    }
+  partition_colors(sd, &g, pid, stamp, NTHREADS, hi);
+
+  check_free(stamp);
+  free_point_graph(&g);
+
+  /* sanity check */
+  for(i = 0; i < sd->nownpoints; i++) 
+    {
+      ASSERT(pid[i] != -1);
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+| face buckets. A face is listed for the owner threads of its points, in the
+| face group of init_thread_rangelist. The faces are cut into one chunk per 
+| thread, a first pass counts per chunk and (thread, group), the prefix sum
+| over (thread, group, chunk) gives the offsets and a second pass scatters 
+| the face ids. The order within a bucket is the face order. The points are
+| numbered per thread the same way (local_index).
+----------------------------------------------------------------------------*/
+
+static inline int face_group_p0(int p0, int p1, const int *pid, const int *htype)
+{
+  if (pid[p0] == pid[p1])
+    {
+      return (htype[p0] == 1 || htype[p1] == 1) ? 2 : 5;
+    }
+  return (htype[p0] == 1) ? 1 : 4;
+}
+
+static inline int face_group_p1(int p1, const int *htype)
+{
+  return (htype[p1] == 1) ? 0 : 3;
+}
+
+void init_face_buckets(face_buckets *fb
+		       , solver_data *sd
+		       , const int *pid
+		       , const int *htype
+		       , int NTHREADS
+		       )
+{
+  const int nkeys = NTHREADS * NFACE_GROUPS;
+  const int nchunks = omp_get_max_threads();
+  int *count = check_malloc(nchunks * (nkeys + NTHREADS) * sizeof(int));
+  int *fcount = count;
+  int *pcount = &count[nchunks * nkeys];
+
+  fb->nthreads = NTHREADS;
+  fb->start = check_malloc((nkeys + 1) * sizeof(int));
+  fb->npoints = check_malloc(NTHREADS * sizeof(int));
+
+  check_free(local_index);
+  local_index = check_malloc(sd->nallpoints * sizeof(int));
+
+#pragma omp parallel default (none) shared(fb, sd, pid, htype, fcount, pcount\
+	    , local_index, NTHREADS, nkeys, nchunks, stderr)
+  {
+    const int c = omp_get_thread_num(),
+	      nc = omp_get_num_threads();
+    ASSERT(nc <= nchunks);
+    const int f0 = (int) ((long) sd->nfaces * c / nc),
+	      f1 = (int) ((long) sd->nfaces * (c + 1) / nc),
+	      q0 = (int) ((long) sd->nallpoints * c / nc),
+	      q1 = (int) ((long) sd->nallpoints * (c + 1) / nc);
+    int *fc = &fcount[c * nkeys];
+    int *pc = &pcount[c * NTHREADS];
+    int n, face, pnt;
+
+    /* histogram */
+    for(n = 0; n < nkeys; n++)
+      {
+	fc[n] = 0;
+      }
+    for(n = 0; n < NTHREADS; n++)
+      {
+	pc[n] = 0;
+      }
+    for(face = f0; face < f1; face++)
+      {
+	const int p0 = sd->fpoint[face][0];
+	const int p1 = sd->fpoint[face][1];
+	if (pid[p0] >= 0)
+	  {
+	    fc[pid[p0] * NFACE_GROUPS + face_group_p0(p0, p1, pid, htype)]++;
+	  }
+	if (pid[p1] >= 0 && pid[p1] != pid[p0])
+	  {
+	    fc[pid[p1] * NFACE_GROUPS + face_group_p1(p1, htype)]++;
+	  }
+      }
+    for(pnt = q0; pnt < q1; pnt++)
+      {
+	if (pid[pnt] >= 0)
+	  {
+	    pc[pid[pnt]]++;
+	  }
+      }
+
+#pragma omp barrier
+    
+    /* prefix sum, counts become chunk offsets */
+#pragma omp single
+    {
+      int i, j, k, sum = 0;
+      for(i = 0; i < nkeys; i++)
+	{
+	  fb->start[i] = sum;
+	  for(j = 0; j < nc; j++)
+	    {
+	      const int t = fcount[j * nkeys + i];
+	      fcount[j * nkeys + i] = sum;
+	      sum += t;
+	    }
+	}
+      fb->start[nkeys] = sum;
+      fb->face = check_malloc(MAX(sum, 1) * sizeof(int));
+      for(k = 0; k < NTHREADS; k++)
+	{
+	  sum = 0;
+	  for(j = 0; j < nc; j++)
+	    {
+	      const int t = pcount[j * NTHREADS + k];
+	      pcount[j * NTHREADS + k] = sum;
+	      sum += t;
+	    }
+	  fb->npoints[k] = sum;
+	}
+    }
+
+    /* scatter */
+    for(face = f0; face < f1; face++)
+      {
+	const int p0 = sd->fpoint[face][0];
+	const int p1 = sd->fpoint[face][1];
+	if (pid[p0] >= 0)
+	  {
+	    fb->face[fc[pid[p0] * NFACE_GROUPS + face_group_p0(p0, p1, pid, htype)]++] = face;
+	  }
+	if (pid[p1] >= 0 && pid[p1] != pid[p0])
+	  {
+	    fb->face[fc[pid[p1] * NFACE_GROUPS + face_group_p1(p1, htype)]++] = face;
+	  }
+      }
+    for(pnt = q0; pnt < q1; pnt++)
+      {
+	local_index[pnt] = (pid[pnt] >= 0) ? pc[pid[pnt]]++ : -1;
+      }
+  }
+
+  check_free(count);
+}
+
+void free_face_buckets(face_buckets *fb)
+{
+  check_free(fb->start);
+  check_free(fb->face);
+  check_free(fb->npoints);
+  fb->start = NULL;
+  fb->face = NULL;
+  fb->npoints = NULL;
+}
+
+
+/*----------------------------------------------------------------------------
+| cross thread faces computed once (CROSS_BUFFER). The face lists are the 
+| same as for CROSS_DUPLICATE, a cross face stays in the ftype 2 and the 
+| ftype 3 colors of its threads. It is computed once per sweep, before the
+| colors, by its writer thread (owner of p0, owner of p1 if p0 is in no 
+| thread) into the accumulation slots (writer, p0) and (writer, p1). The 
+| ftype 2/3 colors then only zero, reduce and scale: the slots of a point
+| are added to grad in the last ftype 2/3 color of its owner which writes
+| it (reduce_points), after the first touch and before the last touch.
+|
+| The slots of a writer are contiguous and written by the writer only, 
+| it zeroes them at the start of its cross faces.
+----------------------------------------------------------------------------*/
+
+static int cross_faces = CROSS_DUPLICATE;
+
+static cross_buffers xbuf = { 0, 0, NULL, NULL, NULL, NULL };
+
+static inline bool is_cross_face(int p0, int p1, const int *pid)
+{
+  return pid[p0] != pid[p1];
+}
+
+static inline int cross_writer(int p0, int p1, const int *pid)
+{
+  return (pid[p0] >= 0) ? pid[p0] : pid[p1];
+}
+
+void set_cross_faces(int mode)
+{
+  ASSERT(mode == CROSS_DUPLICATE || mode == CROSS_BUFFER);
+  cross_faces = mode;
+}
+
+int get_cross_faces(void)
+{
+  return cross_faces;
+}
+
+const cross_buffers* get_cross_buffers(void)
+{
+  return &xbuf;
+}
+
+static void free_cross_buffers(void)
+{
+  check_free(xbuf.start);
+  check_free(xbuf.slot);
+  check_free(xbuf.wstart);
+  check_free(xbuf.buffer);
+  xbuf.start = NULL;
+  xbuf.slot = NULL;
+  xbuf.wstart = NULL;
+  xbuf.buffer = NULL;
+  xbuf.nslots = 0;
+  xbuf.nthreads = 0;
+}
+
+void init_cross_buffers(solver_data *sd
+			, const int *pid
+			, int NTHREADS
+			)
+{
+  const int nallpoints = sd->nallpoints;
+  int i, face, w;
+
+  free_cross_buffers();
+
+  /* cross faces per writer */
+  int *fstart = check_malloc((NTHREADS + 1) * sizeof(int));
+  for(w = 0; w <= NTHREADS; w++)
+    {
+      fstart[w] = 0;
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (is_cross_face(p0, p1, pid))
+	{
+	  fstart[cross_writer(p0, p1, pid) + 1]++;
+	}
+    }
+  for(w = 0; w < NTHREADS; w++)
+    {
+      fstart[w + 1] += fstart[w];
+    }
+  const int ncross = fstart[NTHREADS];
+  int *wface = check_malloc(MAX(ncross, 1) * sizeof(int));
+  int *fpos = check_malloc(NTHREADS * sizeof(int));
+  for(w = 0; w < NTHREADS; w++)
+    {
+      fpos[w] = fstart[w];
+    }
+  for(face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      if (is_cross_face(p0, p1, pid))
+	{
+	  wface[fpos[cross_writer(p0, p1, pid)]++] = face;
+	}
+    }
+  check_free(fpos);
+
+  /* one slot per (writer, point), writer major */
+  int *stamp = check_malloc(nallpoints * sizeof(int));
+  int *slot_point = check_malloc(MAX(2 * ncross, 1) * sizeof(int));
+  xbuf.start = check_malloc((nallpoints + 1) * sizeof(int));
+  xbuf.wstart = check_malloc((NTHREADS + 1) * sizeof(int));
+  for(i = 0; i < nallpoints; i++)
+    {
+      stamp[i] = -1;
+      xbuf.start[i] = 0;
+    }
+  xbuf.start[nallpoints] = 0;
+  int nslots = 0;
+  for(w = 0; w < NTHREADS; w++)
+    {
+      xbuf.wstart[w] = nslots;
+      for(i = fstart[w]; i < fstart[w + 1]; i++)
+	{
+	  int k;
+	  for(k = 0; k < 2; k++)
+	    {
+	      const int pnt = sd->fpoint[wface[i]][k];
+	      if (stamp[pnt] != w)
+		{
+		  stamp[pnt] = w;
+		  slot_point[nslots++] = pnt;
+		  xbuf.start[pnt + 1]++;
+		}
+	    }
+	}
+    }
+  xbuf.wstart[NTHREADS] = nslots;
+
+  /* slots per point */
+  for(i = 0; i < nallpoints; i++)
+    {
+      xbuf.start[i + 1] += xbuf.start[i];
+      stamp[i] = xbuf.start[i];
+    }
+  xbuf.slot = check_malloc(MAX(nslots, 1) * sizeof(int));
+  for(i = 0; i < nslots; i++)
+    {
+      xbuf.slot[stamp[slot_point[i]]++] = i;
+    }
+
+  xbuf.nthreads = NTHREADS;
+  xbuf.nslots = nslots;
+  xbuf.buffer = check_malloc_aligned(MAX(nslots, 1) * 3 * sd->ngrad * sizeof(double));
+
+  check_free(slot_point);
+  check_free(stamp);
+  check_free(wface);
+  check_free(fstart);
+}
+
+/* slot of writer tid for pnt */
+static int cross_slot_of(int pnt, int tid)
+{
+  int i;
+  for(i = xbuf.start[pnt]; i < xbuf.start[pnt + 1]; i++)
+    {
+      const int s = xbuf.slot[i];
+      if (s >= xbuf.wstart[tid] && s < xbuf.wstart[tid + 1])
+	{
+	  return s;
+	}
+    }
+  ASSERT(0);
+  return -1;
+}
+
+
 static void set_all_points_of_color(solver_data *sd
 				, int tid
 				, int *pid
@@ -170,9 +802,9 @@ static void set_all_points_of_color(solver_data *sd
   ASSERT(sd->nallpoints > 0);
   ASSERT(color != NULL);
 
-  /* nall_points_of_color */
-  int *tmp1   = check_malloc(sd->nallpoints * sizeof(int));
-  for(i = 0; i < sd->nallpoints; i++) 
+  /* nall_points_of_color, scratch of the own points */
+  int *tmp1   = check_malloc(MAX(npoints_local, 1) * sizeof(int));
+  for(i = 0; i < npoints_local; i++) 
     {
       tmp1[i] = -1;
     }
@@ -186,14 +818,14 @@ static void set_all_points_of_color(solver_data *sd
 	{
 	  int p0 = fpoint[face][0];
 	  int p1 = fpoint[face][1];
-	  if (pid[p0] == tid && tmp1[p0] == -1)
+	  if (pid[p0] == tid && tmp1[local_index[p0]] == -1)
 	    {
-	      tmp1[p0] = i;
+	      tmp1[local_index[p0]] = i;
 	      npoints++;
 	    }
-	  if (pid[p1] == tid && tmp1[p1] == -1)
+	  if (pid[p1] == tid && tmp1[local_index[p1]] == -1)
 	    {
-	      tmp1[p1] = i;
+	      tmp1[local_index[p1]] = i;
 	      npoints++;
 	    }
 	}
@@ -201,17 +833,15 @@ static void set_all_points_of_color(solver_data *sd
       nallpoints += npoints;
     }
 
-  /* free tmp space */
-  check_free(tmp1);
-
   if (nallpoints == 0)
     {
+      check_free(tmp1);
       return;
     }
   
   /* all_points_of_color */
-  int *tmp2   = check_malloc(sd->nallpoints * sizeof(int));  
-  for(i = 0; i < sd->nallpoints; i++) 
+  int *tmp2   = tmp1;
+  for(i = 0; i < npoints_local; i++) 
     {
       tmp2[i] = -1;
     }
@@ -227,14 +857,14 @@ static void set_all_points_of_color(solver_data *sd
 	{
 	  int p0 = fpoint[face][0];
 	  int p1 = fpoint[face][1];
-	  if (pid[p0] == tid && tmp2[p0] == -1)
+	  if (pid[p0] == tid && tmp2[local_index[p0]] == -1)
 	    {
-	      tmp2[p0] = i;
+	      tmp2[local_index[p0]] = i;
 	      rl->all_points_of_color[npoints++] = p0;
 	    }
-	  if (pid[p1] == tid && tmp2[p1] == -1)
+	  if (pid[p1] == tid && tmp2[local_index[p1]] == -1)
 	    {
-	      tmp2[p1] = i;
+	      tmp2[local_index[p1]] = i;
 	      rl->all_points_of_color[npoints++] = p1;
 	    }
 	}
@@ -260,8 +890,9 @@ static void set_last_points_of_color(solver_data *sd
   ASSERT(color != NULL);
 
 
-  int *tmp1   = check_malloc(sd->nallpoints * sizeof(int));
-  for(i = 0; i < sd->nallpoints; i++) 
+  /* faces per own point, scratch of the own points */
+  int *tmp1   = check_malloc(MAX(npoints_local, 1) * sizeof(int));
+  for(i = 0; i < npoints_local; i++) 
     {
       tmp1[i] = 0;
     }
@@ -275,18 +906,18 @@ static void set_last_points_of_color(solver_data *sd
           int p1 = fpoint[face][1];
           if (pid[p0] == tid && p0 < sd->nownpoints)
             {
-              tmp1[p0]++;
+	      tmp1[local_index[p0]]++;
             }
           if (pid[p1] == tid && p1 < sd->nownpoints)
             {
-              tmp1[p1]++;
+	      tmp1[local_index[p1]]++;
             }
         }
     }
 
 
-  int *tmp2   = check_malloc(sd->nallpoints * sizeof(int));
-  for(i = 0; i < sd->nallpoints; i++) 
+  int *tmp2   = check_malloc(MAX(npoints_local, 1) * sizeof(int));
+  for(i = 0; i < npoints_local; i++) 
     {
       tmp2[i] = 0;
     }
@@ -302,14 +933,14 @@ static void set_last_points_of_color(solver_data *sd
           int p1 = fpoint[face][1];
           if (pid[p0] == tid && p0 < sd->nownpoints)
             {
-              if (++tmp2[p0] == tmp1[p0])
+	      if (++tmp2[local_index[p0]] == tmp1[local_index[p0]])
                 {
                   npoints++;
                 }           
             }
           if (pid[p1] == tid && p1 < sd->nownpoints)
             {
-              if (++tmp2[p1] == tmp1[p1])
+	      if (++tmp2[local_index[p1]] == tmp1[local_index[p1]])
                 {
                   npoints++;
                 }           
@@ -329,13 +960,15 @@ static void set_last_points_of_color(solver_data *sd
 
   if (nlastpoints == 0)
     {
+      check_free(tmp2);  
+      check_free(tmp1);  
       return;
     }
 
   /* sanity check */
   ASSERT(nlastpoints == nfirstpoints);
 
-  for(i = 0; i < sd->nallpoints; i++) 
+  for(i = 0; i < npoints_local; i++) 
     {
       tmp2[i] = 0;
     }
@@ -353,7 +986,7 @@ static void set_last_points_of_color(solver_data *sd
           int p1 = fpoint[face][1];
           if (pid[p0] == tid && p0 < sd->nownpoints)
             {
-              if (++tmp2[p0] == tmp1[p0])
+	      if (++tmp2[local_index[p0]] == tmp1[local_index[p0]])
                 {
 		  ASSERT(rl->nlast_points_of_color != 0);
                   rl->last_points_of_color[npoints++] = p0;
@@ -361,7 +994,7 @@ static void set_last_points_of_color(solver_data *sd
             }
           if (pid[p1] == tid && p1 < sd->nownpoints)
             {
-              if (++tmp2[p1] == tmp1[p1])
+	      if (++tmp2[local_index[p1]] == tmp1[local_index[p1]])
                 {
 		  ASSERT(rl->nlast_points_of_color != 0);
                   rl->last_points_of_color[npoints++] = p1;
@@ -434,168 +1067,361 @@ static void set_first_points_of_color(solver_data *sd
 
 }
 
-#define MAX_FACES_IN_COLOR 96
-
-
-void init_thread_rangelist(comm_data *cd
-			   , solver_data *sd
-			   , int tid
-			   , int *pid
-			   , int *htype
-			   )
+/* cross faces of the writer tid with their slots, reduce points of the 
+   ftype 2/3 colors, see init_cross_buffers */
+static void set_cross_faces_of_thread(solver_data *sd
+				      , int tid
+				      , int *pid
+				      , int ncolors
+				      )
 {
-  int face;
-  int nfaces = 0;
-  for (face = 0; face < sd->nfaces; face++)
+  int i, face;
+  RangeList *color = color_local;
+  int    (*fpoint)[2]        = solver_local.fpoint;
+  const int nfaces           = color[ncolors - 1].stop;
+  ASSERT(xbuf.nthreads == omp_get_num_threads());
+
+  /* cross faces, local face order */
+  int ncross = 0;
+  for(face = 0; face < nfaces; face++)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if (pid[p0] == tid || pid[p1] == tid)
+      const int p0 = fpoint[face][0];
+      const int p1 = fpoint[face][1];
+      if (is_cross_face(p0, p1, pid) && cross_writer(p0, p1, pid) == tid)
 	{
-	  nfaces++;
+	  ncross++;
 	}
     }
-
-  solver_local.fpoint = NULL;
-  solver_local.fnormal = NULL;
-
-  if (nfaces == 0)
+  check_free(solver_local.cross_face);
+  check_free(solver_local.cross_slot);
+  solver_local.cross_face = check_malloc(MAX(ncross, 1) * sizeof(int));
+  solver_local.cross_slot = check_malloc(MAX(ncross, 1) * 2 * sizeof(int));
+  solver_local.ncross = 0;
+  for(face = 0; face < nfaces; face++)
     {
-      return;
+      const int p0 = fpoint[face][0];
+      const int p1 = fpoint[face][1];
+      if (is_cross_face(p0, p1, pid) && cross_writer(p0, p1, pid) == tid)
+	{
+	  const int k = solver_local.ncross++;
+	  solver_local.cross_face[k] = face;
+	  solver_local.cross_slot[k][0] = cross_slot_of(p0, tid);
+	  solver_local.cross_slot[k][1] = cross_slot_of(p1, tid);
+	}
     }
+  solver_local.cross_slots[0] = xbuf.wstart[tid];
+  solver_local.cross_slots[1] = xbuf.wstart[tid + 1];
 
-  int    (*fpoint)[2] = (int (*)[2]) check_malloc(nfaces * 2 * sizeof(int));
-  double (*fnormal)[3] = (double (*)[3]) check_malloc(nfaces * 3 * sizeof(double));
-
-  int last_face[5];
-  int i0 = 0;  
-
-  /* all halo faces with p1 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  /* last ftype 2/3 color per written own point with slots */
+  int *tmp = check_malloc(MAX(npoints_local, 1) * sizeof(int));
+  for(i = 0; i < npoints_local; i++)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] != tid && pid[p1] == tid) && htype[p1] == 1)
+      tmp[i] = -1;
+    }
+  for(i = 0; i < ncolors; i++)
+    {
+      RangeList *rl = &(color[i]);
+      if (rl->ftype == 1)
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	  i0++;
+	  continue;
+	}
+      const int side = (rl->ftype == 3) ? 1 : 0;
+      for(face = rl->start; face < rl->stop; face++)
+	{
+	  const int pnt = fpoint[face][side];
+	  ASSERT(pid[pnt] == tid);
+	  if (pnt < sd->nownpoints && xbuf.start[pnt + 1] > xbuf.start[pnt])
+	    {
+	      tmp[local_index[pnt]] = i;
+	    }
 	}
     }
-  last_face[0] = i0;
 
-  /* all halo faces with p0 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  int nreduce = 0;
+  for(i = 0; i < npoints_local; i++)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] == tid && pid[p1] != tid) && htype[p0] == 1)
+      if (tmp[i] >= 0)
+	{
+	  color[tmp[i]].nreduce_points++;
+	  nreduce++;
+	}
+    }
+  if (nreduce > 0)
+    {
+      int *points = check_malloc(nreduce * sizeof(int));
+      for(i = 0; i < ncolors; i++)
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	    i0++;
+	  RangeList *rl = &(color[i]);
+	  rl->reduce_points = points;
+	  points += rl->nreduce_points;
+	  rl->nreduce_points = 0;
+	}
+      for(i = 0; i < ncolors; i++)
+	{
+	  RangeList *rl = &(color[i]);
+	  if (rl->ftype == 1)
+	    {
+	      continue;
+	    }
+	  const int side = (rl->ftype == 3) ? 1 : 0;
+	  for(face = rl->start; face < rl->stop; face++)
+	    {
+	      const int pnt = fpoint[face][side];
+	      if (pnt < sd->nownpoints && tmp[local_index[pnt]] == i)
+		{
+		  tmp[local_index[pnt]] = -1;
+		  rl->reduce_points[rl->nreduce_points++] = pnt;
+		}
+	    }
 	}
     }
-  last_face[1] = i0;
+  check_free(tmp);
+}
+
+#define MAX_FACES_IN_COLOR 96
+
+/* max faces per color, see set_faces_in_color */
+static int faces_in_color = MAX_FACES_IN_COLOR;
+
+/* faces per conflict free batch, 0 - no batching, see set_batch_width */
+static int batch_width = 0;
+
+/* sort the faces of a color by point, see set_segment_faces */
+static bool segment_faces = false;
+
+// threadprivate face groups, see init_thread_rangelist
+static int nfaces_local = 0;
+#pragma omp threadprivate(nfaces_local)
+static int last_face_local[5];
+#pragma omp threadprivate(last_face_local)
+
+/* face i of a color becomes face order[i] */
+static void permute_color_faces(RangeList *color
+				, const int *order
+				)
+{
+  int    (*fpoint)[2]        = solver_local.fpoint;
+  double  (*fnormal)[3]      = solver_local.fnormal; 
+  float   (*fnormal_sp)[3]   = solver_local.fnormal_sp; 
+  const int start = color->start;
+  const int nfaces = color->stop - color->start;
+  int i;
 
-  /* all halo faces with p0 == tid && p1 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  int (*tmp_point)[2] = check_malloc(nfaces * 2 * sizeof(int));
+  double (*tmp_normal)[3] = check_malloc(nfaces * 3 * sizeof(double));
+  memcpy(tmp_point, &fpoint[start][0], nfaces * 2 * sizeof(int));
+  memcpy(tmp_normal, &fnormal[start][0], nfaces * 3 * sizeof(double));
+  for(i = 0; i < nfaces; i++)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] == tid && pid[p1] == tid) && (htype[p0] == 1 || htype[p1] == 1))
+      memcpy(fpoint[start + i], tmp_point[order[i]], 2 * sizeof(int));
+      memcpy(fnormal[start + i], tmp_normal[order[i]], 3 * sizeof(double));
+    }
+  if (fnormal_sp != NULL)
+    {
+      float (*tmp_normal_sp)[3] = check_malloc(nfaces * 3 * sizeof(float));
+      memcpy(tmp_normal_sp, &fnormal_sp[start][0], nfaces * 3 * sizeof(float));
+      for(i = 0; i < nfaces; i++)
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	  i0++;
+	  memcpy(fnormal_sp[start + i], tmp_normal_sp[order[i]], 3 * sizeof(float));
 	}
+      check_free(tmp_normal_sp);
     }
-  last_face[2] = i0;
 
-  /* all inner faces with p1 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  check_free(tmp_point);
+  check_free(tmp_normal);
+}
+
+
+/* reorder the faces of a color, such that [start, batch_stop) consists 
+   of batches of batch_width consecutive faces which write pairwise 
+   distinct points. Greedy, faces which do not fit into a full batch 
+   remain in [batch_stop, stop) */
+static void batch_color_faces(RangeList *color)
+{
+  int    (*fpoint)[2]        = solver_local.fpoint;
+  const int start = color->start;
+  const int nfaces = color->stop - color->start;
+  const int ftype = color->ftype;
+  int i, j;
+
+  color->batch_stop = start;
+  if (batch_width == 0 || nfaces < batch_width)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] != tid && pid[p1] == tid) && htype[p1] == 2)
+      return;
+    }
+
+  int *order = check_malloc(nfaces * sizeof(int));
+  bool *used = check_malloc(nfaces * sizeof(bool));
+  for(i = 0; i < nfaces; i++)
+    {
+      used[i] = false;
+    }
+
+  int norder = 0;
+  int head = 0;
+  for(;;)
+    {
+      int batch[MAX_BATCH_WIDTH];
+      int points[2 * MAX_BATCH_WIDTH];
+      int nbatch = 0, npoints = 0;
+      while (head < nfaces && used[head])
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	  i0++;
+	  head++;
+	}
+      for(i = head; i < nfaces && nbatch < batch_width; i++)
+	{
+	  if (used[i])
+	    {
+	      continue;
+	    }
+	  const int p0 = fpoint[start + i][0];
+	  const int p1 = fpoint[start + i][1];
+	  bool conflict = false;
+	  for(j = 0; j < npoints; j++)
+	    {
+	      if ((ftype != 3 && points[j] == p0) || 
+		  (ftype != 2 && points[j] == p1))
+		{
+		  conflict = true;
+		}
+	    }
+	  if (!conflict)
+	    {
+	      batch[nbatch++] = i;
+	      if (ftype != 3)
+		{
+		  points[npoints++] = p0;
+		}
+	      if (ftype != 2)
+		{
+		  points[npoints++] = p1;
+		}
+	    }
+	}
+      if (nbatch < batch_width)
+	{
+	  break;
+	}
+      for(j = 0; j < nbatch; j++)
+	{
+	  used[batch[j]] = true;
+	  order[norder++] = batch[j];
 	}
     }
-  last_face[3] = i0;
+  color->batch_stop = start + norder;
 
-  /* all inner faces with p0 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  /* remainder */
+  for(i = 0; i < nfaces; i++)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] == tid && pid[p1] != tid) && htype[p0] == 2)
+      if (!used[i])
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	    i0++;
+	  order[norder++] = i;
 	}
     }
-  last_face[4] = i0;
+  ASSERT(norder == nfaces);
 
-  /* all inner faces with p0 == tid && p1 == tid */
-  for (face = 0; face < sd->nfaces; face++)
+  permute_color_faces(color, order);
+
+  check_free(order);
+  check_free(used);
+}
+
+
+typedef struct
+{
+  int key;
+  int face;
+} face_key;
+
+static int cmp_face_key(const void *a, const void *b)
+{
+  const face_key *fa = (const face_key *) a;
+  const face_key *fb = (const face_key *) b;
+  if (fa->key != fb->key)
     {
-      int p0 = sd->fpoint[face][0];
-      int p1 = sd->fpoint[face][1];
-      if ((pid[p0] == tid && pid[p1] == tid) && (htype[p0] == 2 && htype[p1] == 2))
+      return (fa->key < fb->key) ? -1 : 1;
+    }
+  return fa->face - fb->face;
+}
+
+/* sort the faces of a color by their written point (p0, p1 for ftype 3), 
+   such that the contributions to a point form one segment. For ftype 1 
+   the p1 of the color are numbered in buffer_points/fslot. slot is a 
+   map of the own points (local_index), -1 on entry and exit */
+static void segment_color_faces(RangeList *color
+				, int *slot
+				)
+{
+  int    (*fpoint)[2]        = solver_local.fpoint;
+  int    *fslot              = solver_local.fslot;
+  const int start = color->start;
+  const int nfaces = color->stop - color->start;
+  const int side = (color->ftype == 3) ? 1 : 0;
+  int i, face;
+
+  color->batch_stop = start;
+
+  face_key *keys = check_malloc(nfaces * sizeof(face_key));
+  int *order = check_malloc(nfaces * sizeof(int));
+  for(i = 0; i < nfaces; i++)
+    {
+      keys[i].key = fpoint[start + i][side];
+      keys[i].face = i;
+    }
+  qsort(keys, nfaces, sizeof(face_key), cmp_face_key);
+  for(i = 0; i < nfaces; i++)
+    {
+      order[i] = keys[i].face;
+    }
+  permute_color_faces(color, order);
+  check_free(order);
+  check_free(keys);
+
+  if (color->ftype != 1)
+    {
+      return;
+    }
+
+  /* scatter buffer for p1 */
+  int npoints = 0;
+  int *points = check_malloc(nfaces * sizeof(int));
+  for(face = color->start; face < color->stop; face++)
+    {
+      const int p1 = local_index[fpoint[face][1]];
+      if (slot[p1] == -1)
 	{
-	  memcpy(&(fpoint[i0][0])
-		 , &(sd->fpoint[face][0])
-		 , 2 * sizeof(int)
-		 );
-	  memcpy(&(fnormal[i0][0])
-		 , &(sd->fnormal[face][0])
-		 , 3 * sizeof(double)
-		 );
-	  i0++;
+	  slot[p1] = npoints;
+	  points[npoints++] = fpoint[face][1];
 	}
+      fslot[face] = slot[p1];
+    }
+  for(i = 0; i < npoints; i++)
+    {
+      slot[local_index[points[i]]] = -1;
     }
+  color->nbuffer_points = npoints;
+  color->buffer_points = points;
+}
 
-  ASSERT(i0 == nfaces);
+
+/* cut the thread local face list into colors of at most faces_in_color 
+   faces, colors never cross one of the face groups of init_thread_rangelist */
+static void init_thread_colors(solver_data *sd
+			       , int tid
+			       , int *pid
+			       )
+{
+  const int nfaces = nfaces_local;
+  const int *last_face = last_face_local;
+  int face;
+
+  ASSERT(nfaces > 0);
 
   int count = 0;
   int ncolors = 0;
   for(face = 1 ; face < nfaces; face++)
     {
-      if((++count) == MAX_FACES_IN_COLOR || 
+      if((++count) == faces_in_color || 
 	 face == last_face[0] || face == last_face[1] || face == last_face[2] ||
 	 face == last_face[3] || face == last_face[4])
 	{
@@ -605,13 +1431,14 @@ void init_thread_rangelist(comm_data *cd
     }
   /* last color */
   ncolors++;
-        
+	
 
   /* alloc threadprivate rangelist */
   ncolors_local = ncolors;
   color_local = check_malloc(ncolors * sizeof(RangeList));  
 
   RangeList *tl;  
+  int i0;
   for (i0 = 0; i0 < ncolors; i0++)
     {
       tl = &(color_local[i0]); 
@@ -625,7 +1452,7 @@ void init_thread_rangelist(comm_data *cd
   int start = 0;  
   for(face = 1 ; face < nfaces; face++)
     {
-      if((++count) == MAX_FACES_IN_COLOR || 
+      if((++count) == faces_in_color || 
 	 face == last_face[0] || face == last_face[1] || face == last_face[2] ||
 	 face == last_face[3] || face == last_face[4])
 	{
@@ -647,31 +1474,6 @@ void init_thread_rangelist(comm_data *cd
 
   ASSERT(i0 == ncolors);
 
-#ifdef DEBUG
-  if (cd->iProc == 0)
-    {
-      printf("tid: %d ncolors: %d\n",tid,ncolors);
-      fflush(stdout);
-      int i1;
-      for(i1 = 0; i1 < ncolors; i1++)
-	{
-	  tl = &(color_local[i1]);       
-	  int fstart = tl->start;
-	  int fstop  = tl->stop;
-	  printf("tid: %d start: %d stop: %d\n",tid,fstart,fstop);
-	  fflush(stdout);
-
-	  for (face = fstart; face < fstop; face++)
-	    {
-	      int p0 = fpoint[face][0];
-	      int p1 = fpoint[face][1];
-	      printf("tid: %d p0: %d p1: %d pid0: %d pid1: %d htype0: %d htype1: %d\n"
-		     ,tid, p0, p1, pid[p0], pid[p1], htype[p0], htype[p1]);
-	      fflush(stdout);
-	    }
-	}
-    }
-#endif
 
   int i;
   for(i = 0; i < ncolors; i++)
@@ -719,11 +1521,37 @@ void init_thread_rangelist(comm_data *cd
 	{
 	  tl->succ = NULL;
 	}
+
+      /* conflict free face batches */
+      if (!segment_faces)
+	{
+	  batch_color_faces(tl);
+	}
     } 
 
-  // thread local solver (face) data
-  solver_local.fpoint = fpoint;
-  solver_local.fnormal = fnormal;
+  /* segmented face order */
+  if (segment_faces)
+    {
+      int *slot = check_malloc(MAX(npoints_local, 1) * sizeof(int));
+      for(i = 0; i < npoints_local; i++)
+	{
+	  slot[i] = -1;
+	}
+      if (solver_local.fslot == NULL)
+	{
+	  solver_local.fslot = check_malloc(nfaces * sizeof(int));
+	}
+      int nbuffer = 1;
+      for(i = 0; i < ncolors; i++)
+	{
+	  tl = &(color_local[i]); 
+	  segment_color_faces(tl, slot);
+	  nbuffer = MAX(nbuffer, tl->nbuffer_points);
+	}
+      check_free(solver_local.fbuffer);
+      solver_local.fbuffer = check_malloc(nbuffer * 3 * sd->ngrad * sizeof(double));
+      check_free(slot);
+    }
 
   /* points of color */
   set_all_points_of_color(sd, tid, pid, ncolors);
@@ -734,6 +1562,245 @@ void init_thread_rangelist(comm_data *cd
   /* last points of color */
   set_last_points_of_color(sd, tid, pid, ncolors);
 
+  /* cross faces computed once */
+  if (cross_faces == CROSS_BUFFER)
+    {
+      set_cross_faces_of_thread(sd, tid, pid, ncolors);
+    }
+
+}
+
+
+
+
+void init_thread_rangelist(comm_data *cd __attribute__((unused)) // DEBUG only
+			   , solver_data *sd
+			   , int tid
+			   , int *pid
+			   , int *htype __attribute__((unused)) // DEBUG only
+			   , const face_buckets *fb
+			   )
+{
+  ASSERT(fb->nthreads == omp_get_num_threads());
+
+  /* faces of the thread per face group, see init_face_buckets */
+  const int *bucket = &(fb->start[tid * NFACE_GROUPS]);
+  const int *bucket_face = &(fb->face[bucket[0]]);
+  const int nfaces = bucket[NFACE_GROUPS] - bucket[0];
+  int face, i;
+
+  /* thread neighbor graph: the owners of the opposite points of the 
+     cross faces. comm: the thread writes send or halo points */
+  const int nthreads = fb->nthreads;
+  int *neighbor = check_malloc(nthreads * sizeof(int));
+  int *is_neighbor = check_malloc(nthreads * sizeof(int));
+  int nneighbors = 0;
+  int comm = (bucket[3] > bucket[0]);
+  for(i = 0; i < nthreads; i++)
+    {
+      is_neighbor[i] = 0;
+    }
+
+  for(i = 0; i < nfaces; i++)
+    {
+      face = bucket_face[i];
+      int p0 = sd->fpoint[face][0];
+      int p1 = sd->fpoint[face][1];
+      const int other = (pid[p0] == tid) ? pid[p1] : pid[p0];
+      if (other >= 0 && other != tid && !is_neighbor[other])
+	{
+	  is_neighbor[other] = 1;
+	  neighbor[nneighbors++] = other;
+	}
+      if ((pid[p0] == tid && p0 >= sd->nownpoints)
+	  || (pid[p1] == tid && p1 >= sd->nownpoints))
+	{
+	  comm = 1;
+	}
+    }
+  set_thread_neighbors(tid, nneighbors, neighbor, comm);
+  check_free(neighbor);
+  check_free(is_neighbor);
+
+  solver_local.fpoint = NULL;
+  solver_local.fnormal = NULL;
+  solver_local.fnormal_sp = NULL;
+  solver_local.fslot = NULL;
+  solver_local.fbuffer = NULL;
+  solver_local.ncross = 0;
+  solver_local.cross_face = NULL;
+  solver_local.cross_slot = NULL;
+  solver_local.cross_slots[0] = 0;
+  solver_local.cross_slots[1] = 0;
+  nfaces_local = 0;
+  npoints_local = fb->npoints[tid];
+
+  if (nfaces == 0)
+    {
+      return;
+    }
+
+  int    (*fpoint)[2] = (int (*)[2]) check_malloc(nfaces * 2 * sizeof(int));
+  double (*fnormal)[3] = (double (*)[3]) check_malloc(nfaces * 3 * sizeof(double));
+
+  /* face groups, halo p1, halo p0, halo p0/p1, inner p1, inner p0, 
+     inner p0/p1 - in face order */
+  int last_face[5];
+  int i0;
+  for(i0 = 0; i0 < nfaces; i0++)
+    {
+      face = bucket_face[i0];
+      memcpy(&(fpoint[i0][0])
+	     , &(sd->fpoint[face][0])
+	     , 2 * sizeof(int)
+	     );
+      memcpy(&(fnormal[i0][0])
+	     , &(sd->fnormal[face][0])
+	     , 3 * sizeof(double)
+	     );
+    }
+  for(i = 0; i < 5; i++)
+    {
+      last_face[i] = bucket[i + 1] - bucket[0];
+    }
+
+  ASSERT(i0 == nfaces);
+
+  // thread local solver (face) data
+  solver_local.fpoint = fpoint;
+  solver_local.fnormal = fnormal;
+  nfaces_local = nfaces;
+  memcpy(last_face_local, last_face, 5 * sizeof(int));
+
+  /* colors, points of color */
+  init_thread_colors(sd, tid, pid);
+
+#ifdef DEBUG
+  if (cd->iProc == 0)
+    {
+      printf("tid: %d ncolors: %d\n",tid,ncolors_local);
+      fflush(stdout);
+      int i1;
+      for(i1 = 0; i1 < ncolors_local; i1++)
+	{
+	  RangeList *tl = &(color_local[i1]);       
+	  int fstart = tl->start;
+	  int fstop  = tl->stop;
+	  printf("tid: %d start: %d stop: %d\n",tid,fstart,fstop);
+	  fflush(stdout);
+
+	  for (face = fstart; face < fstop; face++)
+	    {
+	      int p0 = fpoint[face][0];
+	      int p1 = fpoint[face][1];
+	      printf("tid: %d p0: %d p1: %d pid0: %d pid1: %d htype0: %d htype1: %d\n"
+		     ,tid, p0, p1, pid[p0], pid[p1], htype[p0], htype[p1]);
+	      fflush(stdout);
+	    }
+	}
+    }
+#endif
+
+}
+
+
+static void free_thread_colors(void)
+{
+  int i;
+  if (ncolors_local == 0)
+    {
+      return;
+    }
+  for(i = 0; i < ncolors_local; i++)
+    {
+      RangeList *rl = &(color_local[i]); 
+      check_free(rl->sendpartner);
+      check_free(rl->sendcount);
+      check_free(rl->buffer_points);
+    }
+
+  /* points of color, one block per thread */
+  check_free(color_local[0].all_points_of_color);
+  check_free(color_local[0].first_points_of_color);
+  check_free(color_local[0].last_points_of_color);
+  check_free(color_local[0].reduce_points);
+
+  check_free(color_local);
+  color_local = NULL;
+  ncolors_local = 0;
+}
+
+/* thread local colors and face data, before init_thread_rangelist is 
+   run again (rebalance_threads) */
+void free_thread_rangelist(void)
+{
+  free_thread_colors();
+  check_free(solver_local.fpoint);
+  check_free(solver_local.fnormal);
+  check_free(solver_local.fnormal_sp);
+  check_free(solver_local.fslot);
+  check_free(solver_local.fbuffer);
+  check_free(solver_local.cross_face);
+  check_free(solver_local.cross_slot);
+  solver_local.fpoint = NULL;
+  solver_local.fnormal = NULL;
+  solver_local.fnormal_sp = NULL;
+  solver_local.fslot = NULL;
+  solver_local.fbuffer = NULL;
+  solver_local.ncross = 0;
+  solver_local.cross_face = NULL;
+  solver_local.cross_slot = NULL;
+  nfaces_local = 0;
+}
+
+
+void set_faces_in_color(int nfaces)
+{
+  ASSERT(nfaces > 0);
+  faces_in_color = nfaces;
+}
+
+int get_faces_in_color(void)
+{
+  return faces_in_color;
+}
+
+
+void set_batch_width(int width)
+{
+  ASSERT(width == 0 || width == 4 || width == MAX_BATCH_WIDTH);
+  batch_width = width;
+}
+
+int get_batch_width(void)
+{
+  return batch_width;
+}
+
+
+void set_segment_faces(bool segment)
+{
+  segment_faces = segment;
+}
+
+bool get_segment_faces(void)
+{
+  return segment_faces;
+}
+
+
+/* recut the thread local faces into colors, keeps the face data. 
+   init_thread_comm is required afterwards */
+void rebuild_thread_rangelist(solver_data *sd
+			      , int tid
+			      , int *pid
+			      )
+{
+  free_thread_colors();
+  if (nfaces_local > 0)
+    {
+      init_thread_colors(sd, tid, pid);
+    }
 }
 
 
@@ -746,7 +1813,57 @@ void init_thread_meta_data(int *pid
 {
 
   /* set thread id, color id */
-  init_meta_data(pid, NTHREADS, sd);
+  if (balance_mode == BALANCE_POINTS)
+    {
+      init_meta_data(pid, NTHREADS, sd);
+    }
+  else if (balance_mode == BALANCE_GRAPH)
+    {
+      /* duplicated cross faces and modelled imbalance of the point split 
+	 and the graph split */
+      double *cost = check_malloc(NTHREADS * sizeof(double));
+      double lval[4], gval[4];
+      init_meta_data(pid, NTHREADS, sd);
+      get_thread_cost(sd, pid, NTHREADS, cost);
+      lval[0] = cross_face_fraction(sd, pid);
+      lval[2] = thread_imbalance(cost, NTHREADS);
+      partition_points(sd, pid, NTHREADS);
+      get_thread_cost(sd, pid, NTHREADS, cost);
+      lval[1] = cross_face_fraction(sd, pid);
+      lval[3] = thread_imbalance(cost, NTHREADS);
+      check_free(cost);
+
+      MPI_Allreduce(lval, gval, 4, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (cd->iProc == 0)
+	{
+	  printf("  duplicated face fraction point split: %10.3f\n", gval[0]);
+	  printf("  duplicated face fraction graph split: %10.3f\n", gval[1]);
+	  printf("     thread cost imbalance point split: %10.3f\n", gval[2]);
+	  printf("     thread cost imbalance graph split: %10.3f\n", gval[3]);
+	  fflush(stdout);
+	}
+    }
+  else
+    {
+      /* modelled imbalance of the point split and the cost split */
+      double *cost = check_malloc(NTHREADS * sizeof(double));
+      double limb[2], gimb[2];
+      init_meta_data(pid, NTHREADS, sd);
+      get_thread_cost(sd, pid, NTHREADS, cost);
+      limb[0] = thread_imbalance(cost, NTHREADS);
+      init_meta_data_cost(pid, NTHREADS, sd);
+      get_thread_cost(sd, pid, NTHREADS, cost);
+      limb[1] = thread_imbalance(cost, NTHREADS);
+      check_free(cost);
+
+      MPI_Allreduce(limb, gimb, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (cd->iProc == 0)
+	{
+	  printf("     thread cost imbalance point split: %10.3f\n", gimb[0]);
+	  printf("      thread cost imbalance cost split: %10.3f\n", gimb[1]);
+	  fflush(stdout);
+	}
+    }
 
   /* init halo type */
   init_halo_type(htype, cd, sd);
@@ -796,19 +1913,12 @@ void eval_thread_comm(comm_data *cd)
 	      int i1 = color->sendpartner[i];
 	      int sendcount_color = color->sendcount[i];
 	      int sendcount_local = get_sendcount_local(i1);
-	      if (sendcount_color > 0 && sendcount_local > 0)
-		{		  
-		  int inc_local = set_inc_send_local(i1, sendcount_color);
-		  if(inc_local % sendcount_local == 0)
-		    {
-		      int inc_global = set_inc_send(i1, sendcount_local);
-		      int k = cd->commpartner[i1];
-		      if (inc_global % cd->sendcount[k] == 0)
-			{
-			  printf("iProc: %6d tid: %4d send num: %8d to: %6d -- complete. ncolors: %d final send color: %6d\n"
-				 ,cd->iProc,tid,cd->sendcount[k],k,ncolors,nsend);
-			}
-		    }
+	      if (sendcount_color > 0 && sendcount_local > 0
+		  && thread_send_complete(cd, i1, sendcount_color))
+		{
+		  int k = cd->commpartner[i1];
+		  printf("iProc: %6d tid: %4d send num: %8d to: %6d -- complete. ncolors: %d final send color: %6d\n"
+			 ,cd->iProc,tid,cd->sendcount[k],k,ncolors,nsend);
 		}
 	    }
 	  nsend++;
@@ -861,6 +1971,31 @@ void test_thread_rangelist(solver_data *sd)
 	  /* validate tid */
 	  ASSERT(color->tid == tid);
 
+	  /* validate face batches, pairwise distinct written points */
+	  ASSERT(color->batch_stop >= color->start && color->batch_stop <= color->stop);
+	  if (color->batch_stop > color->start)
+	    {
+	      int width = get_batch_width();
+	      ASSERT(width > 0 && (color->batch_stop - color->start) % width == 0);
+	      for(face = color->start; face < color->batch_stop; face++)
+		{
+		  int f1, first = face - (face - color->start) % width;
+		  for(f1 = first; f1 < face; f1++)
+		    {
+		      if (color->ftype != 3)
+			{
+			  ASSERT(fpoint[f1][0] != fpoint[face][0]);
+			  ASSERT(color->ftype == 2 || fpoint[f1][1] != fpoint[face][0]);
+			}
+		      if (color->ftype != 2)
+			{
+			  ASSERT(fpoint[f1][1] != fpoint[face][1]);
+			  ASSERT(color->ftype == 3 || fpoint[f1][0] != fpoint[face][1]);
+			}
+		    }
+		}
+	    }
+
 	  /* validate ftype */
 	  ASSERT(color->ftype != 0);
 	  for(face = color->start; face < color->stop; face++)
@@ -906,72 +2041,94 @@ void test_thread_rangelist(solver_data *sd)
 }   
 
 
-static void gather_sendcount(comm_data *cd
-			     , solver_data *sd)
+/* CSR point to partner table of the send points, commdomain indices of 
+   point pnt in partner[start[pnt], start[pnt + 1]), ascending */
+typedef struct
 {
-  int i, j, i0;
+  int *start;   // [nallpoints + 1]
+  int *partner;
+} send_partners;
+
+static void init_send_partners(send_partners *sp
+			       , comm_data *cd
+			       , solver_data *sd
+			       )
+{
+  int i, j;
+  int *start = check_malloc((sd->nallpoints + 1) * sizeof(int));
+  for(i = 0; i <= sd->nallpoints; i++)
+    {
+      start[i] = 0;
+    }
 
-  int **tmp1 = check_malloc(sd->nallpoints * sizeof(int*));;
+  /* partners per point */
+  for(i = 0; i < cd->ncommdomains; i++)
+    {
+      int k = cd->commpartner[i];
+      for(j = 0; j < cd->sendcount[k]; j++)
+	{
+	  start[cd->sendindex[k][j] + 1]++;
+	}
+    }
   for(i = 0; i < sd->nallpoints; i++)
     {
-      tmp1[i] = NULL;
+      start[i + 1] += start[i];
     }
-  /* gather sendindex data per pnt, per target */
+
+  /* fill, fill[pnt] runs from start[pnt] to start[pnt + 1] */
+  int *partner = check_malloc(MAX(start[sd->nallpoints], 1) * sizeof(int));
+  int *fill = check_malloc(MAX(sd->nallpoints, 1) * sizeof(int));
+  memcpy(fill, start, sd->nallpoints * sizeof(int));
   for(i = 0; i < cd->ncommdomains; i++)
     {
       int k = cd->commpartner[i];
-      int count = cd->sendcount[k];      
-      if(count > 0)
+      for(j = 0; j < cd->sendcount[k]; j++)
 	{
-	  for(j = 0; j < count; j++)
-	    {
-	      int pnt = cd->sendindex[k][j];
-	      if (tmp1[pnt] == NULL)
-		{
-		  tmp1[pnt] = check_malloc(cd->ncommdomains * sizeof(int));;
-		  for(i0 = 0; i0 < cd->ncommdomains; i0++)   
-		    {
-		      tmp1[pnt][i0] = -1;
-		    }
-		}             
-	      ASSERT(tmp1[pnt][i] == -1);
-	      tmp1[pnt][i] = i;
-	    }
+	  int pnt = cd->sendindex[k][j];
+	  ASSERT(fill[pnt] == start[pnt] || partner[fill[pnt] - 1] != i);
+	  partner[fill[pnt]++] = i;
 	}
     }
+  check_free(fill);
+
+  sp->start = start;
+  sp->partner = partner;
+}
+
+
+static void gather_sendcount(comm_data *cd
+			     , solver_data *sd)
+{
+  send_partners sp;
+  init_send_partners(&sp, cd, sd);
 
   /* assemble partial sendcounts per color, per target */
 #pragma omp parallel default (none) shared(cd, sd\
-            , tmp1, stdout, stderr)
+	    , sp, stdout, stderr)
     {
       RangeList *color;
-      int  *tmp3 = check_malloc(cd->ncommdomains * sizeof(int));;
+      int  *tmp3 = check_malloc(MAX(cd->ncommdomains, 1) * sizeof(int));
+      int i1;
+
+      for(i1 = 0; i1 < cd->ncommdomains; i1++) 
+	{
+	  tmp3[i1] = 0;
+	}
 
       for (color = get_color(); color != NULL
 	     ; color = get_next_color(color)) 
 	{      
 	  int  nlast_points_of_color = color->nlast_points_of_color;
 	  int  *last_points_of_color = color->last_points_of_color;
-	  int k, i1;	
+	  int k;	
 
 	  /* gather color specific metadata */
-	  for(i1 = 0; i1 < cd->ncommdomains; i1++) 
-	    {
-	      tmp3[i1] = 0;
-	    }
 	  for(i1 = 0; i1 < nlast_points_of_color; i1++) 
 	    {
 	      int pnt = last_points_of_color[i1];
-	      if (tmp1[pnt] != NULL)
+	      for(k = sp.start[pnt]; k < sp.start[pnt + 1]; k++)
 		{
-		  for(k = 0; k < cd->ncommdomains; k++)
-		    {
-		      int dest = tmp1[pnt][k];
-		      if (dest != -1) 
-			{
-			  tmp3[dest]++;
-			}
-		    }
+		  tmp3[sp.partner[k]]++;
 		}
 	    }
 	  int nsend = 0;
@@ -984,7 +2141,7 @@ static void gather_sendcount(comm_data *cd
 	    }
 	  color->nsendcount = nsend;
 
-	  /* init sends, color local */
+	  /* init sends, color local. Resets tmp3 */
 	  if (color->nsendcount > 0)
 	    {
 	      color->sendpartner = check_malloc(color->nsendcount * sizeof(int));
@@ -996,6 +2153,7 @@ static void gather_sendcount(comm_data *cd
 		    {
 		      color->sendpartner[i2] = i1;
 		      color->sendcount[i2] = tmp3[i1];
+		      tmp3[i1] = 0;
 		      i2++;
 		    }
 		}
@@ -1004,15 +2162,8 @@ static void gather_sendcount(comm_data *cd
       check_free(tmp3);
     }
 
-  for(i = 0; i < sd->nallpoints; i++)
-    {
-      if (tmp1[i] != NULL)
-	{
-	  check_free(tmp1[i]);
-	}
-    }
-  check_free(tmp1);
-
+  check_free(sp.start);
+  check_free(sp.partner);
 }
 
 void init_thread_comm(comm_data *cd
@@ -1027,7 +2178,13 @@ void init_thread_comm(comm_data *cd
 
 solver_data_local* get_solver_data(void)
 {
-  return &solver_local;
+  return (foreign_local != NULL) ? foreign_local : &solver_local;
+}
+
+
+void set_solver_data(solver_data_local *local)
+{
+  foreign_local = local;
 }
 
 
@@ -19,6 +19,23 @@ void init_threads(comm_data *cd
 		  , int NTHREADS
 		  );
 
+void rebuild_threads(comm_data *cd
+		     , solver_data *sd
+		     , int nfaces_in_color
+		     );
+
+/* new thread ids per point by the cost model with the relative cost 
+   rate per (old) thread, rebuilds rangelist and thread communication. 
+   set_color_kernels and place_point_data are required afterwards */
+void rebalance_threads(comm_data *cd
+		       , solver_data *sd
+		       , const double *rate
+		       );
+
+/* owner thread per point after init_threads, -1 for halo points 
+   which are in no color */
+const int* get_thread_pid(void);
+
 void initiate_thread_comm_mpi(RangeList *color
 			      , comm_data *cd
 			      , double *data
@@ -36,13 +53,117 @@ void init_thread_comm(comm_data *cd
 		      );
 
 
+/* face groups of a thread: halo p1, halo p0, halo p0/p1, inner p1, 
+   inner p0, inner p0/p1 (ftype 3, 2, 1, 3, 2, 1) */
+#define NFACE_GROUPS 6
+
+/* faces per (thread, face group), see init_face_buckets */
+typedef struct
+{
+  int nthreads;
+  int *start;   // [nthreads * NFACE_GROUPS + 1]
+  int *face;    // face ids, per thread and group in face order
+  int *npoints; // [nthreads] points per thread
+} face_buckets;
+
+/* one parallel bucketing pass over the faces, also numbers the points 
+   of every thread (local point index, kept for rebuild_threads) */
+void init_face_buckets(face_buckets *fb
+		       , solver_data *sd
+		       , const int *pid
+		       , const int *htype
+		       , int NTHREADS
+		       );
+
+void free_face_buckets(face_buckets *fb);
+
+/* cross thread faces: computed by both threads (ftype 2 and 3) or once, 
+   into thread private accumulation slots reduced by the owner threads */
+#define CROSS_DUPLICATE 0
+#define CROSS_BUFFER    1
+
+void set_cross_faces(int mode);
+
+int get_cross_faces(void);
+
+/* accumulation slots of CROSS_BUFFER. A slot holds the contributions of
+   one writer thread to one point, the slots of a writer are contiguous */
+typedef struct
+{
+  int nthreads;
+  int nslots;
+  int *start;     // [nallpoints + 1] slots per point
+  int *slot;      // slot ids per point, in writer order
+  int *wstart;    // [nthreads + 1] slots per writer thread
+  double *buffer; // [nslots][3 * ngrad]
+} cross_buffers;
+
+/* writer thread and slots of every cross face, before the thread 
+   rangelist is built */
+void init_cross_buffers(solver_data *sd
+			, const int *pid
+			, int NTHREADS
+			);
+
+const cross_buffers* get_cross_buffers(void);
+
 void init_thread_rangelist(comm_data *cd
 			   , solver_data *sd
 			   , int tid
 			   , int *pid
 			   , int *htype
+			   , const face_buckets *fb
 			   );
 
+void rebuild_thread_rangelist(solver_data *sd
+			      , int tid
+			      , int *pid
+			      );
+
+void set_faces_in_color(int nfaces);
+
+int get_faces_in_color(void);
+
+/* max faces per conflict free face batch */
+#define MAX_BATCH_WIDTH 8
+
+void set_batch_width(int width);
+
+int get_batch_width(void);
+
+void set_segment_faces(bool segment);
+
+bool get_segment_faces(void);
+
+/* thread balance of init_thread_meta_data, see rangelist.c */
+#define BALANCE_POINTS   0
+#define BALANCE_COST     1
+#define BALANCE_MEASURED 2
+#define BALANCE_GRAPH    3
+
+void set_balance_mode(int mode);
+
+int get_balance_mode(void);
+
+/* relative cost per face/halo point of the points of a thread, from 
+   measured thread times. NULL resets to 1 */
+void set_thread_rates(solver_data *sd
+		      , const int *pid
+		      , const double *rate
+		      );
+
+/* modelled cost per thread of the thread id per point pid */
+void get_thread_cost(solver_data *sd
+		     , const int *pid
+		     , int NTHREADS
+		     , double *cost
+		     );
+
+/* max/mean of a per thread quantity */
+double thread_imbalance(const double *cost, int NTHREADS);
+
+void free_thread_rangelist(void);
+
 void init_thread_meta_data(int *pid
 			   , int *htype
 			   , comm_data *cd
@@ -56,6 +177,10 @@ void test_thread_rangelist(solver_data *sd);
 
 solver_data_local* get_solver_data(void);
 
+/* run the colors of another thread with its face data 
+   (get_solver_data() of that thread), NULL restores the own */
+void set_solver_data(solver_data_local *local);
+
 int get_ncolors(void);
 
 RangeList* private_get_color(RangeList *const prev);
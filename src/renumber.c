@@ -0,0 +1,449 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "renumber.h"
+#include "error_handling.h"
+#include "util.h"
+
+#define DATAKEY 4712
+
+/*----------------------------------------------------------------------------
+| locality improving renumbering, applied after the communication tables
+| are set up and before init_threads.
+|
+| points are ordered by reverse Cuthill-McKee on the face graph, grouped
+| by (own/add, color) so that own points stay in [0, nownpoints), add
+| points in [nownpoints, nallpoints) and every color (and hence every
+| thread domain) remains a compact index range. Faces are sorted by their
+| lower point, init_thread_rangelist keeps this order in each face group.
+|
+| fpoint, fnormal, pvolume, var, grad, the color point lists, sendindex,
+| recvindex, addpoint_owner and addpoint_id are remapped. addpoint_id
+| refers to the owner numbering and is exchanged with the partners.
+----------------------------------------------------------------------------*/
+
+/* sort keys, see compare_points/compare_faces */
+static const int *key_major = NULL;
+static const int *key_minor = NULL;
+static const int *key_rank = NULL;
+static int (*key_face)[2] = NULL;
+
+const char* renumber_name(int method)
+{
+  switch (method)
+    {
+    case RENUMBER_RCM:
+      return "rcm";
+    default:
+      return "none";
+    }
+}
+
+static int compare_points(const void *a, const void *b)
+{
+  const int p0 = *(const int *) a;
+  const int p1 = *(const int *) b;
+  if (key_major[p0] != key_major[p1])
+    {
+      return key_major[p0] - key_major[p1];
+    }
+  if (key_minor[p0] != key_minor[p1])
+    {
+      return key_minor[p0] - key_minor[p1];
+    }
+  return key_rank[p0] - key_rank[p1];
+}
+
+static int compare_faces(const void *a, const void *b)
+{
+  const int f0 = *(const int *) a;
+  const int f1 = *(const int *) b;
+  const int lo0 = MIN(key_face[f0][0], key_face[f0][1]);
+  const int lo1 = MIN(key_face[f1][0], key_face[f1][1]);
+  if (lo0 != lo1)
+    {
+      return lo0 - lo1;
+    }
+  const int hi0 = MAX(key_face[f0][0], key_face[f0][1]);
+  const int hi1 = MAX(key_face[f1][0], key_face[f1][1]);
+  if (hi0 != hi1)
+    {
+      return hi0 - hi1;
+    }
+  return f0 - f1;
+}
+
+/* point graph in CSR format */
+static void build_point_graph(solver_data *sd
+			      , int **xadj
+			      , int **adj
+			      )
+{
+  const int npoints = sd->nallpoints;
+  int i, face;
+
+  int *x = check_malloc((npoints + 1) * sizeof(int));
+  int *a = check_malloc(2 * sd->nfaces * sizeof(int));
+  int *pos = check_malloc(npoints * sizeof(int));
+
+  for (i = 0; i <= npoints; i++)
+    {
+      x[i] = 0;
+    }
+  for (face = 0; face < sd->nfaces; face++)
+    {
+      x[sd->fpoint[face][0] + 1]++;
+      x[sd->fpoint[face][1] + 1]++;
+    }
+  for (i = 0; i < npoints; i++)
+    {
+      x[i + 1] += x[i];
+      pos[i] = x[i];
+    }
+  for (face = 0; face < sd->nfaces; face++)
+    {
+      const int p0 = sd->fpoint[face][0];
+      const int p1 = sd->fpoint[face][1];
+      a[pos[p0]++] = p1;
+      a[pos[p1]++] = p0;
+    }
+
+  check_free(pos);
+  *xadj = x;
+  *adj = a;
+}
+
+/* order[k] is the point at RCM position k */
+static void compute_rcm(int npoints
+			, const int *xadj
+			, const int *adj
+			, int *order
+			)
+{
+  int i, j, head = 0, tail = 0;
+  char *visited = check_malloc(npoints * sizeof(char));
+  memset(visited, 0, npoints * sizeof(char));
+
+  while (tail < npoints)
+    {
+      /* start with an unvisited point of minimal degree */
+      int start = -1;
+      for (i = 0; i < npoints; i++)
+	{
+	  if (!visited[i] && (start == -1 ||
+			      xadj[i + 1] - xadj[i] < xadj[start + 1] - xadj[start]))
+	    {
+	      start = i;
+	    }
+	}
+      visited[start] = 1;
+      order[tail++] = start;
+
+      /* breadth first, neighbours by increasing degree */
+      while (head < tail)
+	{
+	  const int pnt = order[head++];
+	  const int first = tail;
+	  for (j = xadj[pnt]; j < xadj[pnt + 1]; j++)
+	    {
+	      const int nb = adj[j];
+	      if (!visited[nb])
+		{
+		  visited[nb] = 1;
+		  order[tail++] = nb;
+		}
+	    }
+	  for (i = first + 1; i < tail; i++)
+	    {
+	      const int tmp = order[i];
+	      const int deg = xadj[tmp + 1] - xadj[tmp];
+	      for (j = i; j > first && xadj[order[j - 1] + 1] - xadj[order[j - 1]] > deg; j--)
+		{
+		  order[j] = order[j - 1];
+		}
+	      order[j] = tmp;
+	    }
+	}
+    }
+
+  /* reverse */
+  for (i = 0; i < npoints / 2; i++)
+    {
+      const int tmp = order[i];
+      order[i] = order[npoints - 1 - i];
+      order[npoints - 1 - i] = tmp;
+    }
+
+  check_free(visited);
+}
+
+static double mean_face_distance(solver_data *sd)
+{
+  int face;
+  double dist = 0.0;
+  for (face = 0; face < sd->nfaces; face++)
+    {
+      dist += abs(sd->fpoint[face][0] - sd->fpoint[face][1]);
+    }
+  return dist / MAX(sd->nfaces, 1);
+}
+
+static void permute_field(solver_data *sd
+			  , double *data
+			  , int dim
+			  , const int *perm
+			  )
+{
+  int i;
+  const size_t sz = (size_t) sd->nallpoints * dim * sizeof(double);
+  double *tmp = check_malloc(sz);
+  for (i = 0; i < sd->nallpoints; i++)
+    {
+      layout_copy_out(&(sd->layout), &tmp[(size_t) perm[i] * dim], data, dim, i);
+    }
+  for (i = 0; i < sd->nallpoints; i++)
+    {
+      layout_copy_in(&(sd->layout), data, &tmp[(size_t) i * dim], dim, i);
+    }
+  check_free(tmp);
+}
+
+static void remap_point_data(solver_data *sd
+			     , const int *perm
+			     )
+{
+  int i, face;
+  const int npoints = sd->nallpoints;
+
+  /* faces */
+  for (face = 0; face < sd->nfaces; face++)
+    {
+      sd->fpoint[face][0] = perm[sd->fpoint[face][0]];
+      sd->fpoint[face][1] = perm[sd->fpoint[face][1]];
+    }
+
+  /* point volume */
+  double *pvolume = check_malloc(npoints * sizeof(double));
+  for (i = 0; i < npoints; i++)
+    {
+      pvolume[perm[i]] = sd->pvolume[i];
+    }
+  memcpy(sd->pvolume, pvolume, npoints * sizeof(double));
+  check_free(pvolume);
+
+  /* var/grad */
+  permute_field(sd, sd->var, sd->var_dim, perm);
+  permute_field(sd, sd->grad, sd->grad_dim, perm);
+
+  /* points of color */
+  for (i = 0; i < sd->ncolors; i++)
+    {
+      RangeList *color = &(sd->fcolor[i]);
+      int j;
+      for (j = 0; j < color->nall_points_of_color; j++)
+	{
+	  color->all_points_of_color[j] = perm[color->all_points_of_color[j]];
+	}
+    }
+}
+
+static void sort_faces_by_point(solver_data *sd)
+{
+  int i;
+  const int nfaces = sd->nfaces;
+  int *order = check_malloc(nfaces * sizeof(int));
+  int (*fpoint)[2] = check_malloc(nfaces * 2 * sizeof(int));
+  double (*fnormal)[3] = check_malloc(nfaces * 3 * sizeof(double));
+
+  for (i = 0; i < nfaces; i++)
+    {
+      order[i] = i;
+    }
+  key_face = sd->fpoint;
+  qsort(order, nfaces, sizeof(int), compare_faces);
+  key_face = NULL;
+
+  for (i = 0; i < nfaces; i++)
+    {
+      memcpy(fpoint[i], sd->fpoint[order[i]], 2 * sizeof(int));
+      memcpy(fnormal[i], sd->fnormal[order[i]], 3 * sizeof(double));
+    }
+  memcpy(sd->fpoint, fpoint, nfaces * 2 * sizeof(int));
+  memcpy(sd->fnormal, fnormal, nfaces * 3 * sizeof(double));
+
+  check_free(fnormal);
+  check_free(fpoint);
+  check_free(order);
+}
+
+static void remap_comm_data(comm_data *cd
+			    , const int *perm
+			    )
+{
+  int i, j;
+  const int nown = cd->nownpoints;
+  const int nadd = cd->naddpoints;
+
+  for (i = 0; i < cd->ncommdomains; i++)
+    {
+      int k = cd->commpartner[i];
+      for (j = 0; j < cd->sendcount[k]; j++)
+	{
+	  cd->sendindex[k][j] = perm[cd->sendindex[k][j]];
+	}
+      for (j = 0; j < cd->recvcount[k]; j++)
+	{
+	  cd->recvindex[k][j] = perm[cd->recvindex[k][j]];
+	}
+    }
+
+  /* add point owner */
+  int *owner = check_malloc(nadd * sizeof(int));
+  for (j = 0; j < nadd; j++)
+    {
+      owner[perm[nown + j] - nown] = cd->addpoint_owner[j];
+    }
+  memcpy(cd->addpoint_owner, owner, nadd * sizeof(int));
+  check_free(owner);
+
+  /* add point id, in the (renumbered) owner numbering */
+  MPI_Request *req = check_malloc(2 * cd->ncommdomains * sizeof(MPI_Request));
+  int **ibuf = check_malloc(cd->ncommdomains * sizeof(int *));
+  for (i = 0; i < cd->ncommdomains; i++)
+    {
+      int k = cd->commpartner[i];
+      ibuf[i] = check_malloc(MAX(cd->recvcount[k], 1) * sizeof(int));
+      MPI_Irecv(ibuf[i]
+		, cd->recvcount[k]
+		, MPI_INT
+		, k
+		, DATAKEY
+		, MPI_COMM_WORLD
+		, &req[i]
+		);
+    }
+  for (i = 0; i < cd->ncommdomains; i++)
+    {
+      int k = cd->commpartner[i];
+      MPI_Isend(cd->sendindex[k]
+		, cd->sendcount[k]
+		, MPI_INT
+		, k
+		, DATAKEY
+		, MPI_COMM_WORLD
+		, &req[cd->ncommdomains + i]
+		);
+    }
+  MPI_Waitall(2 * cd->ncommdomains, req, MPI_STATUSES_IGNORE);
+
+  for (i = 0; i < cd->ncommdomains; i++)
+    {
+      int k = cd->commpartner[i];
+      for (j = 0; j < cd->recvcount[k]; j++)
+	{
+	  int idx = cd->recvindex[k][j] - nown;
+	  ASSERT(cd->addpoint_owner[idx] == k);
+	  cd->addpoint_id[idx] = ibuf[i][j];
+	}
+      check_free(ibuf[i]);
+    }
+  check_free(ibuf);
+  check_free(req);
+}
+
+
+void renumber_points(comm_data *cd
+		     , solver_data *sd
+		     , int method
+		     )
+{
+  int i, j;
+  const int npoints = sd->nallpoints;
+
+  if (method == RENUMBER_NONE)
+    {
+      return;
+    }
+  ASSERT(method == RENUMBER_RCM);
+  ASSERT(cd->nownpoints == sd->nownpoints);
+  ASSERT(cd->nownpoints + cd->naddpoints == sd->nallpoints);
+
+  const double dist0 = mean_face_distance(sd);
+
+  /* rcm rank */
+  int *xadj, *adj;
+  int *order = check_malloc(npoints * sizeof(int));
+  int *rank = check_malloc(npoints * sizeof(int));
+  build_point_graph(sd, &xadj, &adj);
+  compute_rcm(npoints, xadj, adj, order);
+  for (i = 0; i < npoints; i++)
+    {
+      rank[order[i]] = i;
+    }
+  check_free(xadj);
+  check_free(adj);
+
+  /* group by own/add, color */
+  int *is_add = check_malloc(npoints * sizeof(int));
+  int *color_id = check_malloc(npoints * sizeof(int));
+  for (i = 0; i < npoints; i++)
+    {
+      is_add[i] = (i >= sd->nownpoints);
+      color_id[i] = sd->ncolors;
+    }
+  for (i = 0; i < sd->ncolors; i++)
+    {
+      RangeList *color = &(sd->fcolor[i]);
+      for (j = 0; j < color->nall_points_of_color; j++)
+	{
+	  color_id[color->all_points_of_color[j]] = i;
+	}
+    }
+
+  for (i = 0; i < npoints; i++)
+    {
+      order[i] = i;
+    }
+  key_major = is_add;
+  key_minor = color_id;
+  key_rank = rank;
+  qsort(order, npoints, sizeof(int), compare_points);
+  key_major = key_minor = key_rank = NULL;
+
+  /* perm[old] = new */
+  int *perm = rank;
+  for (i = 0; i < npoints; i++)
+    {
+      perm[order[i]] = i;
+    }
+
+  remap_point_data(sd, perm);
+  sort_faces_by_point(sd);
+  remap_comm_data(cd, perm);
+
+  if (cd->iProc == 0)
+    {
+      printf("renumber: %s mean face point distance: %.1f -> %.1f\n"
+	     , renumber_name(method), dist0, mean_face_distance(sd));
+      fflush(stdout);
+    }
+
+  check_free(color_id);
+  check_free(is_add);
+  check_free(perm);
+  check_free(order);
+}
@@ -0,0 +1,17 @@
+#ifndef RENUMBER_H
+#define RENUMBER_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+#define RENUMBER_NONE 0
+#define RENUMBER_RCM  1
+
+void renumber_points(comm_data *cd
+		     , solver_data *sd
+		     , int method
+		     );
+
+const char* renumber_name(int method);
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "residual.h"
+#include "gradients.h"
+#include "rangelist.h"
+#include "exchange_data_mpi.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| second order residual on top of the gradients: Venkatakrishnan limiter, 
+| MUSCL reconstruction and an upwind (Roe) flux for the linear advection 
+| of every equation with the constant velocity adv.
+|
+| The limiter of a point needs its complete gradient and the var of its 
+| neighbours only. It is evaluated for the last points of a color by a 
+| gather over sd->pfaces and scales grad in place, so the limited gradient 
+| is what the halo exchange sends. The flux loop needs the limited 
+| gradients of both face points and runs after the exchange, over the 
+| thread local faces of get_solver_data(), with the ftype of the color.
+|
+|   unfused: gradient sweep, limiter sweep (+ halo trigger), flux sweep
+|   fused:   per color gradient + limiter (+ halo trigger), flux sweep
+|
+| Edge vectors are modelled from the face normals as in gradients_wlsq.c,
+| d = V n / |n|^2, V = (V(p0) + V(p1)) / 2, the face is at the edge center.
+----------------------------------------------------------------------------*/
+
+/* advection velocity */
+static const double adv[3] = { 1.0, 0.5, 0.25 };
+
+/* Venkatakrishnan constant, eps^2 = (K h)^3 with h^3 = V */
+#define VENKAT_K 5.0
+
+
+void init_residual(solver_data *sd)
+{
+  init_point_faces(sd);
+}
+
+
+/* sum_faces |adv n| of an own point, the flux Jacobian bound of the 
+   upwind flux */
+double advection_radius(solver_data *sd, int pnt)
+{
+  const int *pstart          = sd->pfaces.start;
+  double  (*pnormal)[3]      = sd->pfaces.normal;
+  double radius = 0.0;
+  int k;
+
+  for(k = pstart[pnt]; k < pstart[pnt + 1]; k++)
+    {
+      const double *n = pnormal[k];
+      radius += fabs(adv[0] * n[0] + adv[1] * n[1] + adv[2] * n[2]);
+    }
+  return radius;
+}
+
+
+static inline double venkatakrishnan(double d1, double d2, double eps2)
+{
+  const double d12 = d1 * d1;
+  const double d22 = d2 * d2;
+  return (d12 + eps2 + 2.0 * d1 * d2) / (d12 + 2.0 * d22 + d1 * d2 + eps2);
+}
+
+/* limit grad of the given own points */
+static void limit_points(solver_data *sd
+			 , int npoints
+			 , const int *points
+			 )
+{
+  const data_layout *l       = &(sd->layout);
+  const int *pstart          = sd->pfaces.start;
+  const int *ppoint          = sd->pfaces.point;
+  double  (*pnormal)[3]      = sd->pfaces.normal;
+  const double *var          = sd->var;
+  double *grad               = sd->grad;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim          = sd->var_dim;
+  const int grad_dim         = sd->grad_dim;
+  int i, k, eq;
+
+  for(i = 0; i < npoints; i++)
+    {
+      const int pnt = points[i];
+      const double eps2 = VENKAT_K * VENKAT_K * VENKAT_K * pvolume[pnt];
+      for(eq = 0; eq < sd->ngrad; eq++)
+	{
+	  const double u = var[layout_index(l, var_dim, pnt, eq)];
+	  double *g = &grad[layout_index(l, grad_dim, pnt, 3 * eq)];
+	  const double gx = g[0];
+	  const double gy = g[l->cstride];
+	  const double gz = g[2 * l->cstride];
+	  double umin = u, umax = u, phi = 1.0;
+
+	  for(k = pstart[pnt]; k < pstart[pnt + 1]; k++)
+	    {
+	      const double uq = var[layout_index(l, var_dim, ppoint[k], eq)];
+	      umin = MIN(umin, uq);
+	      umax = MAX(umax, uq);
+	    }
+	  for(k = pstart[pnt]; k < pstart[pnt + 1]; k++)
+	    {
+	      const double *n = pnormal[k];
+	      const double nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+	      const double s = 0.25 * (pvolume[pnt] + pvolume[ppoint[k]]) / nn;
+	      const double d2 = s * (gx * n[0] + gy * n[1] + gz * n[2]);
+	      if (d2 > 0.0)
+		{
+		  phi = MIN(phi, venkatakrishnan(umax - u, d2, eps2));
+		}
+	      else if (d2 < 0.0)
+		{
+		  phi = MIN(phi, venkatakrishnan(umin - u, d2, eps2));
+		}
+	    }
+	  g[0] = phi * gx;
+	  g[l->cstride] = phi * gy;
+	  g[2 * l->cstride] = phi * gz;
+	}
+    }
+}
+
+static inline __attribute__((always_inline))
+void compute_flux(RangeList *color
+		  , solver_data *sd
+		  , const int ftype
+		  )
+{
+  solver_data_local* solver_local = get_solver_data();
+  int    (*fpoint)[2]        = solver_local->fpoint;
+  double  (*fnormal)[3]      = solver_local->fnormal; 
+
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  const double *grad         = sd->grad;
+  double *res                = sd->res;
+  const double *pvolume      = sd->pvolume;
+  const int var_dim          = sd->var_dim;
+  const int grad_dim         = sd->grad_dim;
+  const int cstride          = l->cstride;
+  int i, eq;
+  int face;
+
+  for(i = 0; i < color->nfirst_points_of_color; i++) 
+    {
+      const int pnt = color->first_points_of_color[i];
+      for(eq = 0; eq < sd->ngrad; eq++)
+	{
+	  res[layout_index(l, var_dim, pnt, eq)] = 0.0;
+	}
+    }
+
+  for(face = color->start; face < color->stop; face++)
+    {
+      const int  p0    = fpoint[face][0];
+      const int  p1    = fpoint[face][1];
+      const double *n  = fnormal[face];
+      const double nn  = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+      const double s   = 0.25 * (pvolume[p0] + pvolume[p1]) / nn;
+      const double an  = adv[0] * n[0] + adv[1] * n[1] + adv[2] * n[2];
+
+      for(eq = 0; eq < sd->ngrad; eq++)
+	{
+	  const double *g0 = &grad[layout_index(l, grad_dim, p0, 3 * eq)];
+	  const double *g1 = &grad[layout_index(l, grad_dim, p1, 3 * eq)];
+	  const double ul = var[layout_index(l, var_dim, p0, eq)]
+	    + s * (g0[0] * n[0] + g0[cstride] * n[1] + g0[2 * cstride] * n[2]);
+	  const double ur = var[layout_index(l, var_dim, p1, eq)]
+	    - s * (g1[0] * n[0] + g1[cstride] * n[1] + g1[2 * cstride] * n[2]);
+	  const double flux = 0.5 * an * (ul + ur) - 0.5 * fabs(an) * (ur - ul);
+
+	  if (ftype != 3)
+	    {
+	      res[layout_index(l, var_dim, p0, eq)] += flux;
+	    }
+	  if (ftype != 2)
+	    {
+	      res[layout_index(l, var_dim, p1, eq)] -= flux;
+	    }
+	}
+    }
+}
+
+/* instances per ftype */
+#define FLUX_INSTANCE(ftype)						\
+  static void compute_flux_##ftype(RangeList *color, solver_data *sd) \
+  {									\
+    compute_flux(color, sd, ftype);					\
+  }
+
+FLUX_INSTANCE(1)
+FLUX_INSTANCE(2)
+FLUX_INSTANCE(3)
+
+static const face_kernel flux_kernels[4] =
+  { NULL
+    , compute_flux_1
+    , compute_flux_2
+    , compute_flux_3
+  };
+
+
+void limit_color(RangeList *color, solver_data *sd)
+{
+  limit_points(sd
+	       , color->nlast_points_of_color
+	       , color->last_points_of_color
+	       );
+}
+
+
+void flux_color(RangeList *color, solver_data *sd)
+{
+  flux_kernels[color->ftype](color, sd);
+}
+
+
+static void flux_sweep(solver_data *sd)
+{
+  RangeList *color;  
+  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+    {
+      flux_kernels[color->ftype](color, sd);
+    }
+}
+
+
+void compute_residual_unfused(comm_data *cd, solver_data *sd, int final)
+{
+  RangeList *color;  
+  compute_cross_faces(sd, false);
+  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+    {
+      color->kernel(color, sd);
+    }
+  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+    {
+      limit_points(sd
+		   , color->nlast_points_of_color
+		   , color->last_points_of_color
+		   );
+      initiate_thread_comm_mpi(color
+			       , cd
+			       , sd->grad
+			       , sd->grad_dim
+			       );      
+    }
+  exchange_dbl_mpi_async(cd
+			 , sd->grad
+			 , sd->grad_dim
+			 , final
+			 );
+#pragma omp barrier  
+  flux_sweep(sd);
+#pragma omp barrier  
+}
+
+
+void compute_residual_fused(comm_data *cd, solver_data *sd, int final)
+{
+  RangeList *color;  
+  compute_cross_faces(sd, false);
+  for (color = get_color(); color != NULL; color = get_next_color(color)) 
+    {
+      color->kernel(color, sd);
+      limit_points(sd
+		   , color->nlast_points_of_color
+		   , color->last_points_of_color
+		   );
+      initiate_thread_comm_mpi(color
+			       , cd
+			       , sd->grad
+			       , sd->grad_dim
+			       );      
+    }
+  exchange_dbl_mpi_async(cd
+			 , sd->grad
+			 , sd->grad_dim
+			 , final
+			 );
+#pragma omp barrier  
+  flux_sweep(sd);
+#pragma omp barrier  
+}
@@ -0,0 +1,26 @@
+#ifndef RESIDUAL_H
+#define RESIDUAL_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+void init_residual(solver_data *sd);
+
+/* sum_faces |adv n| of an own point */
+double advection_radius(solver_data *sd, int pnt);
+
+/* gradients, limiter, grad halo exchange (MPI async) and flux into 
+   sd->res. Called by all threads, exchange_dbl_mpi_post_recv before 
+   the first call, final on the last */
+void compute_residual_unfused(comm_data *cd, solver_data *sd, int final);
+
+void compute_residual_fused(comm_data *cd, solver_data *sd, int final);
+
+/* single color building blocks: limiter of the last points (complete 
+   gradients required), flux into res (first points zeroed, complete 
+   limited gradients of all face points required) */
+void limit_color(RangeList *color, solver_data *sd);
+
+void flux_color(RangeList *color, solver_data *sd);
+
+#endif
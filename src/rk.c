@@ -0,0 +1,327 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "rk.h"
+#include "residual.h"
+#include "gradients.h"
+#include "numa.h"
+#include "rangelist.h"
+#include "threads.h"
+#include "exchange_data_mpi.h"
+#include "exchange_data_mpidma.h"
+#ifdef USE_GASPI
+#include "exchange_data_gaspi.h"
+#endif
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| explicit low storage Runge-Kutta time stepping of the linear advection 
+| of residual.c, local time steps
+|
+|   u(k) = u(0) - alpha(k) dt / V res(u(k-1)),  alpha(k) = 1 / (nstages - k)
+|
+| Every stage exchanges two fields: the limited gradients (grad_dim per 
+| point) after the gradient/limiter sweep, and the updated var (var_dim per
+| point) after the flux sweep. A point is final after the flux kernel of 
+| the color which has it as a last point, so it is updated right there 
+| and the var halo is triggered per color exactly like grad. The flux of 
+| other colors and threads still reads the old var, the new one is 
+| written to var_next and swapped after the exchange.
+|
+| The receive slots hold max_elem_sz (grad_dim) doubles per point, the 
+| exchange variants post their receives for the full slot and hence may 
+| alternate between the two fields.
+----------------------------------------------------------------------------*/
+
+#define RK_CFL 0.5
+
+typedef struct
+{
+  int    nstages;
+  double *u0;
+  double *var_next;
+  double *dtv;      // dt / V per own point
+} rk_data;
+
+static rk_data rk = { 0, NULL, NULL, NULL };
+
+
+/* exchange variants, common signatures. initiate is NULL for the bulk 
+   sync variants */
+typedef struct
+{
+  void (*initiate)(RangeList *color, comm_data *cd, double *data, int dim2);
+  void (*exchange)(comm_data *cd, double *data, int dim2, int final);
+} rk_comm_ops;
+
+static void mpi_bulk_sync(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_mpi_bulk_sync(cd, data, dim2);
+}
+
+static void mpi_early_recv(comm_data *cd, double *data, int dim2, int final)
+{
+  exchange_dbl_mpi_early_recv(cd, data, dim2, final);
+}
+
+static void mpi_async(comm_data *cd, double *data, int dim2, int final)
+{
+  exchange_dbl_mpi_async(cd, data, dim2, final);
+}
+
+#ifdef USE_GASPI
+static void gaspi_bulk_sync(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_gaspi_bulk_sync(cd, data, dim2);
+}
+
+static void gaspi_async(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_gaspi_async(cd, data, dim2);
+}
+#endif
+
+static void mpifence_bulk_sync(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_mpifence_bulk_sync(cd, data, dim2);
+}
+
+static void mpifence_async(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_mpifence_async(cd, data, dim2);
+}
+
+static void mpipscw_bulk_sync(comm_data *cd, double *data, int dim2, int final)
+{
+  (void) final;
+  exchange_dbl_mpipscw_bulk_sync(cd, data, dim2);
+}
+
+static void mpipscw_async(comm_data *cd, double *data, int dim2, int final)
+{
+  exchange_dbl_mpipscw_async(cd, data, dim2, final);
+}
+
+static const rk_comm_ops rk_ops[N_RK_COMM] =
+  {
+    { NULL, mpi_bulk_sync },
+    { NULL, mpi_early_recv },
+    { initiate_thread_comm_mpi, mpi_async },
+#ifdef USE_GASPI
+    { NULL, gaspi_bulk_sync },
+    { initiate_thread_comm_gaspi, gaspi_async },
+#else
+    { NULL, NULL },
+    { NULL, NULL },
+#endif
+    { NULL, mpifence_bulk_sync },
+    { initiate_thread_comm_mpifence, mpifence_async },
+    { NULL, mpipscw_bulk_sync },
+    { initiate_thread_comm_mpipscw, mpipscw_async }
+  };
+
+
+int rk_comm_available(int comm)
+{
+  ASSERT(comm >= 0 && comm < N_RK_COMM);
+  return rk_ops[comm].exchange != NULL;
+}
+
+
+const char* rk_comm_name(int comm)
+{
+  switch (comm)
+    {
+    case RK_MPI_BULK_SYNC:
+      return "mpi_bulk_sync";
+    case RK_MPI_EARLY_RECV:
+      return "mpi_early_recv";
+#ifdef USE_MPI_MULTI_THREADED
+    case RK_MPI_ASYNC:
+      return "mpi_async_multi";
+    case RK_MPIFENCE_ASYNC:
+      return "mpifence_async_multi";
+    case RK_MPIPSCW_ASYNC:
+      return "mpipscw_async_multi";
+#else
+    case RK_MPI_ASYNC:
+      return "mpi_async_serialized";
+    case RK_MPIFENCE_ASYNC:
+      return "mpifence_async_serialized";
+    case RK_MPIPSCW_ASYNC:
+      return "mpipscw_async_serialized";
+#endif
+    case RK_GASPI_BULK_SYNC:
+      return "gaspi_bulk_sync";
+    case RK_GASPI_ASYNC:
+      return "gaspi_async";
+    case RK_MPIFENCE_BULK_SYNC:
+      return "mpifence_bulk_sync";
+    default:
+      return "mpipscw_bulk_sync";
+    }
+}
+
+
+void init_rk(solver_data *sd, int nstages)
+{
+  int i;
+
+  rk.nstages = nstages;
+  if (nstages == 0)
+    {
+      return;
+    }
+
+  const size_t sz = layout_size(&(sd->layout), sd->var_dim, sd->nallpoints);
+  rk.u0 = alloc_point_field(sd, sd->var_dim);
+  rk.var_next = alloc_point_field(sd, sd->var_dim);
+  memcpy(rk.var_next, sd->var, sz);
+
+  rk.dtv = check_malloc(MAX(sd->nownpoints, 1) * sizeof(double));
+  for (i = 0; i < sd->nownpoints; ++i)
+    {
+      const double radius = advection_radius(sd, i);
+      rk.dtv[i] = (radius > 0.0) ? RK_CFL / radius : 0.0;
+    }
+}
+
+
+int get_rk_stages(void)
+{
+  return rk.nstages;
+}
+
+
+void reset_rk(solver_data *sd)
+{
+  ASSERT(rk.var_next != NULL);
+  memcpy(rk.var_next
+	 , sd->var
+	 , layout_size(&(sd->layout), sd->var_dim, sd->nallpoints)
+	 );
+}
+
+
+void rk_comm_start(comm_data *cd, solver_data *sd, int comm)
+{
+  switch (comm)
+    {
+    case RK_MPI_EARLY_RECV:
+    case RK_MPI_ASYNC:
+      exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
+      break;
+    case RK_MPIFENCE_ASYNC:
+      mpidma_async_win_fence(MPI_MODE_NOPRECEDE);
+      break;
+    case RK_MPIPSCW_ASYNC:
+      mpidma_async_post_start();
+      break;
+    default:
+      break;
+    }
+}
+
+
+/* stage update of the final (last) points of a color */
+static void update_points(RangeList *color
+			  , solver_data *sd
+			  , double alpha
+			  , int stage
+			  )
+{
+  const data_layout *l       = &(sd->layout);
+  const double *var          = sd->var;
+  const double *res          = sd->res;
+  double *u0                 = rk.u0;
+  double *var_next           = rk.var_next;
+  const int var_dim          = sd->var_dim;
+  int i, eq;
+
+  for(i = 0; i < color->nlast_points_of_color; i++)
+    {
+      const int pnt = color->last_points_of_color[i];
+      const double dt = alpha * rk.dtv[pnt];
+      for(eq = 0; eq < sd->ngrad; eq++)
+	{
+	  const int idx = layout_index(l, var_dim, pnt, eq);
+	  if (stage == 0)
+	    {
+	      u0[idx] = var[idx];
+	    }
+	  var_next[idx] = u0[idx] - dt * res[idx];
+	}
+    }
+}
+
+
+void rk_step(comm_data *cd, solver_data *sd, int comm, int final)
+{
+  const rk_comm_ops *ops = &rk_ops[comm];
+  RangeList *color;  
+  int stage;
+
+  ASSERT(rk_comm_available(comm));
+
+  for (stage = 0; stage < rk.nstages; ++stage)
+    {
+      const double alpha = 1.0 / (rk.nstages - stage);
+      const int last = (final && stage == rk.nstages - 1) ? 1 : 0;
+
+      /* gradients, limiter, grad halo */
+      compute_cross_faces(sd, false);
+      for (color = get_color(); color != NULL; color = get_next_color(color)) 
+	{
+	  color->kernel(color, sd);
+	  limit_color(color, sd);
+	  if (ops->initiate != NULL)
+	    {
+	      ops->initiate(color, cd, sd->grad, sd->grad_dim);
+	    }
+	}
+      ops->exchange(cd, sd->grad, sd->grad_dim, 0);
+#pragma omp barrier  
+
+      /* flux, stage update, var halo */
+      for (color = get_color(); color != NULL; color = get_next_color(color)) 
+	{
+	  flux_color(color, sd);
+	  update_points(color, sd, alpha, stage);
+	  if (ops->initiate != NULL)
+	    {
+	      ops->initiate(color, cd, rk.var_next, sd->var_dim);
+	    }
+	}
+      ops->exchange(cd, rk.var_next, sd->var_dim, last);
+#pragma omp barrier  
+
+      if (this_is_the_first_thread())
+	{
+	  double *tmp = sd->var;
+	  sd->var = rk.var_next;
+	  rk.var_next = tmp;
+	}
+#pragma omp barrier  
+    }
+}
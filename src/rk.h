@@ -0,0 +1,38 @@
+#ifndef RK_H
+#define RK_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+/* exchange variants of rk_step */
+#define RK_MPI_BULK_SYNC      0
+#define RK_MPI_EARLY_RECV     1
+#define RK_MPI_ASYNC          2
+#define RK_GASPI_BULK_SYNC    3
+#define RK_GASPI_ASYNC        4
+#define RK_MPIFENCE_BULK_SYNC 5
+#define RK_MPIFENCE_ASYNC     6
+#define RK_MPIPSCW_BULK_SYNC  7
+#define RK_MPIPSCW_ASYNC      8
+#define N_RK_COMM             9
+
+/* nstages 0 disables the time stepping */
+void init_rk(solver_data *sd, int nstages);
+
+int get_rk_stages(void);
+
+/* var_next := var, after var has been reset */
+void reset_rk(solver_data *sd);
+
+int rk_comm_available(int comm);
+
+const char* rk_comm_name(int comm);
+
+/* before the parallel region of a sequence of rk_step */
+void rk_comm_start(comm_data *cd, solver_data *sd, int comm);
+
+/* one time step of nstages stages with a grad and a var halo exchange 
+   each. Called by all threads, final on the last step of a sequence */
+void rk_step(comm_data *cd, solver_data *sd, int comm, int final);
+
+#endif
@@ -0,0 +1,428 @@
+/*
+ * This file is part of a small exa2ct benchmark kernel
+ * The kernel aims at a dataflow implementation for 
+ * hybrid solvers which make use of unstructured meshes.
+ *
+ * Contact point for exa2ct: 
+ *                 https://projects.imec.be/exa2ct
+ *
+ * Contact point for this kernel: 
+ *                 christian.simmendinger@t-systems.com
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <omp.h>
+
+#include "schedule.h"
+#include "rangelist.h"
+#include "threads.h"
+#include "barrier.h"
+#include "util.h"
+#include "error_handling.h"
+
+/*----------------------------------------------------------------------------
+| work stealing over the colors of all threads. Every thread first runs 
+| its own colors in list order (halo colors first, so the early send 
+| triggers are unchanged), then steals ready colors from the tail of the 
+| other lists until none is left.
+|
+| A color writes points owned by its thread, and the colors of a thread 
+| which share a written point have to run in list order: the first color
+| of a point zeroes it, the last one finalizes it. Every color hence 
+| keeps the preceding colors of its thread which last wrote one of its 
+| points (pred) and may start only after they are done. Conflicting colors
+| keep their order, the per point results are bitwise identical to the 
+| static schedule. 
+|
+| Colors with halo send triggers are never stolen, the send counters are 
+| thread local. The comm variants (schedule_colors_comm) hence run the 
+| initiate_thread_comm_* hook on the owner right after its color. A stolen color runs with the face data of its owner 
+| (set_solver_data). The segmented kernels keep a per thread color 
+| buffer and are not scheduled.
+|
+| Claims and completions are tagged with a sweep epoch, no reset between 
+| the sweeps is required.
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  volatile int claimed;  // epoch of the last claim
+  volatile int done;     // epoch of the last completion
+  RangeList *color;
+  solver_data_local *local;
+  int tid;
+  bool stealable;
+  int npred;
+  int *pred;
+} __attribute__((aligned(64))) sched_task;
+
+typedef struct
+{
+  long steals;
+  long sweeps;
+  double wait;
+} __attribute__((aligned(64))) sched_stats;
+
+static int schedule = SCHEDULE_STATIC;
+
+static int nthreads_sched = 0;
+static int *task_start = NULL;
+static sched_task *task = NULL;
+static sched_stats *stats = NULL;
+
+static int epoch = 0;
+#pragma omp threadprivate(epoch)
+
+
+void set_schedule(int mode)
+{
+  schedule = mode;
+}
+
+int get_schedule(void)
+{
+  return schedule;
+}
+
+const char* schedule_name(int mode)
+{
+  switch (mode)
+    {
+    case SCHEDULE_STEAL:
+      return "steal";
+    default:
+      return "static";
+    }
+}
+
+
+static bool has_send(RangeList *color)
+{
+  int i;
+  for(i = 0; i < color->nsendcount; i++)
+    {
+      if (color->sendcount[i] > 0)
+	{
+	  return true;
+	}
+    }
+  return false;
+}
+
+static void add_pred(sched_task *t, int p)
+{
+  int i;
+  for(i = 0; i < t->npred; i++)
+    {
+      if (t->pred[i] == p)
+	{
+	  return;
+	}
+    }
+  t->pred = check_realloc(t->pred, (t->npred + 1) * sizeof(int));
+  t->pred[t->npred++] = p;
+}
+
+
+void init_schedule(solver_data *sd)
+{
+  const int nthreads = omp_get_max_threads();
+  int i;
+
+  free_schedule();
+  nthreads_sched = nthreads;
+  task_start = check_malloc((nthreads + 1) * sizeof(int));
+  stats = check_malloc(nthreads * sizeof(sched_stats));
+  for(i = 0; i <= nthreads; i++)
+    {
+      task_start[i] = 0;
+    }
+
+#pragma omp parallel default (none) shared(sd, task, task_start, stats, stderr)
+  {
+    const int tid = omp_get_thread_num();
+    RangeList *color;
+    int j, face;
+
+    task_start[tid + 1] = get_ncolors();
+    stats[tid].steals = 0;
+    stats[tid].sweeps = 0;
+    stats[tid].wait = 0.0;
+    epoch = 0;
+#pragma omp barrier
+#pragma omp master
+    {
+      int k;
+      for(k = 0; k < omp_get_num_threads(); k++)
+	{
+	  task_start[k + 1] += task_start[k];
+	}
+      task = check_malloc(MAX(task_start[omp_get_num_threads()], 1) * sizeof(sched_task));
+    }
+#pragma omp barrier
+
+    /* last color of this thread which wrote a point */
+    int *last = check_malloc(sd->nallpoints * sizeof(int));
+    for(j = 0; j < sd->nallpoints; j++)
+      {
+	last[j] = -1;
+      }
+
+    solver_data_local *local = get_solver_data();
+    int (*fpoint)[2] = local->fpoint;
+    j = task_start[tid];
+    for (color = get_color(); color != NULL; color = get_next_color(color), j++)
+      {
+	sched_task *t = &task[j];
+	t->claimed = 0;
+	t->done = 0;
+	t->color = color;
+	t->local = local;
+	t->tid = tid;
+	t->stealable = !get_segment_faces() && !has_send(color);
+	t->npred = 0;
+	t->pred = NULL;
+	for(face = color->start; face < color->stop; face++)
+	  {
+	    int k;
+	    for(k = 0; k < 2; k++)
+	      {
+		const int pnt = fpoint[face][k];
+		if ((k == 0 && color->ftype == 3) || (k == 1 && color->ftype == 2))
+		  {
+		    continue;
+		  }
+		if (last[pnt] >= 0 && last[pnt] != j)
+		  {
+		    add_pred(t, last[pnt]);
+		  }
+		last[pnt] = j;
+	      }
+	  }
+      }
+    ASSERT(j == task_start[tid + 1]);
+    check_free(last);
+  }
+}
+
+
+void free_schedule(void)
+{
+  int j;
+  if (task != NULL)
+    {
+      for(j = 0; j < task_start[nthreads_sched]; j++)
+	{
+	  check_free(task[j].pred);
+	}
+    }
+  check_free(task);
+  check_free(task_start);
+  check_free(stats);
+  task = NULL;
+  task_start = NULL;
+  stats = NULL;
+  nthreads_sched = 0;
+}
+
+
+static inline bool is_ready(const sched_task *t, int e)
+{
+  int i;
+  for(i = 0; i < t->npred; i++)
+    {
+      if (task[t->pred[i]].done != e)
+	{
+	  return false;
+	}
+    }
+  __sync_synchronize();
+  return true;
+}
+
+static inline bool claim(sched_task *t, int e)
+{
+  return __sync_bool_compare_and_swap(&(t->claimed), e - 1, e);
+}
+
+static inline void run(sched_task *t, solver_data *sd, face_kernel fn, int tid, int e)
+{
+  if (t->tid != tid)
+    {
+      set_solver_data(t->local);
+      fn(t->color, sd);
+      set_solver_data(NULL);
+    }
+  else
+    {
+      fn(t->color, sd);
+    }
+  __sync_synchronize();
+  t->done = e;
+}
+
+/* one ready, stealable color of another thread */
+static bool steal(solver_data *sd, face_kernel fn, int tid, int e)
+{
+  int v, j;
+  for(v = 1; v < nthreads_sched; v++)
+    {
+      const int victim = (tid + v) % nthreads_sched;
+      for(j = task_start[victim + 1] - 1; j >= task_start[victim]; j--)
+	{
+	  sched_task *t = &task[j];
+	  if (t->stealable && t->claimed != e && is_ready(t, e) && claim(t, e))
+	    {
+	      run(t, sd, fn, tid, e);
+	      return true;
+	    }
+	}
+    }
+  return false;
+}
+
+
+/* all colors, hook after every own color. Returns true if stealing */
+static bool schedule_sweep(solver_data *sd
+			   , face_kernel fn
+			   , color_hook hook
+			   , comm_data *cd
+			   , double *data
+			   , int dim2
+			   )
+{
+  const int tid = omp_get_thread_num();
+
+  if (schedule == SCHEDULE_STEAL && task != NULL)
+    {
+      ASSERT(omp_get_num_threads() == nthreads_sched);
+      const int e = ++epoch;
+      int j;
+
+      /* own colors in list order, skip stolen ones. Colors with halo 
+	 send triggers are never stolen, the hook runs on the owner */
+      for(j = task_start[tid]; j < task_start[tid + 1]; j++)
+	{
+	  sched_task *t = &task[j];
+	  if (claim(t, e))
+	    {
+	      while (!is_ready(t, e))
+		{
+		  _mm_pause();
+		}
+	      run(t, sd, fn, tid, e);
+	      if (hook != NULL)
+		{
+		  hook(t->color, cd, data, dim2);
+		}
+	    }
+	}
+
+      /* steal while ready colors are left. No spinning on colors 
+	 which are not ready, their owners need the core */
+      while (steal(sd, fn, tid, e))
+	{
+	  stats[tid].steals++;
+	}
+      return true;
+    }
+  else
+    {
+      RangeList *color;  
+      for (color = get_color(); color != NULL; color = get_next_color(color)) 
+	{
+	  fn(color, sd);
+	  if (hook != NULL)
+	    {
+	      hook(color, cd, data, dim2);
+	    }
+	}
+      return false;
+    }
+}
+
+/* barrier after a sweep, the wait is kept in the stats */
+static void schedule_wait(bool full)
+{
+  const int tid = omp_get_thread_num();
+  if (stats != NULL)
+    {
+      const double t0 = now();
+      if (full)
+	{
+	  thread_barrier();
+	}
+      else
+	{
+	  thread_sync(0);
+	}
+      stats[tid].wait += now() - t0;
+      stats[tid].sweeps++;
+    }
+  else if (full)
+    {
+      thread_barrier();
+    }
+  else
+    {
+      thread_sync(0);
+    }
+}
+
+
+void schedule_colors(solver_data *sd, face_kernel fn)
+{
+  /* stolen colors write points of other threads, the neighbor graph 
+     does not hold */
+  const bool stealing = schedule_sweep(sd, fn, NULL, NULL, NULL, 0);
+  schedule_wait(stealing);
+}
+
+
+void schedule_colors_comm(solver_data *sd
+			  , face_kernel fn
+			  , color_hook hook
+			  , comm_data *cd
+			  , double *data
+			  , int dim2
+			  )
+{
+  /* static: the exchange syncs, as before. Stealing: the stolen points 
+     are complete before the exchange and the neighbor sync after it */
+  if (schedule_sweep(sd, fn, hook, cd, data, dim2))
+    {
+      schedule_wait(true);
+    }
+}
+
+
+void reset_schedule_stats(void)
+{
+  int i;
+  for(i = 0; i < nthreads_sched; i++)
+    {
+      stats[i].steals = 0;
+      stats[i].sweeps = 0;
+      stats[i].wait = 0.0;
+    }
+}
+
+
+void get_schedule_stats(double *steals, double *wait)
+{
+  long nsteals = 0, nsweeps = 0;
+  double twait = 0.0;
+  int i;
+  for(i = 0; i < nthreads_sched; i++)
+    {
+      nsteals += stats[i].steals;
+      nsweeps = MAX(nsweeps, stats[i].sweeps);
+      twait += stats[i].wait;
+    }
+  nsweeps = MAX(nsweeps, 1);
+  *steals = (double) nsteals / nsweeps;
+  *wait = twait / (nsweeps * MAX(nthreads_sched, 1));
+}
@@ -0,0 +1,52 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "comm_data.h"
+#include "solver_data.h"
+
+#define SCHEDULE_STATIC 0
+#define SCHEDULE_STEAL  1
+
+void set_schedule(int mode);
+
+int get_schedule(void);
+
+const char* schedule_name(int mode);
+
+/* task table over the colors of all threads, after the final 
+   rangelists (tune_color_size), freed by rebuild_threads. Until then 
+   the schedule is static. Barrier wait statistics are kept in both 
+   modes */
+void init_schedule(solver_data *sd);
+
+void free_schedule(void);
+
+/* fn for all colors, static or work stealing, ends with a barrier. 
+   Called by all threads. fn must not trigger halo sends for colors 
+   of other threads */
+void schedule_colors(solver_data *sd, face_kernel fn);
+
+/* per color halo send trigger, initiate_thread_comm_* */
+typedef void (*color_hook)(RangeList *color
+			   , comm_data *cd
+			   , double *data
+			   , int dim2
+			   );
+
+/* fn for all colors of the comm variants, hook (or NULL) after every 
+   own color. No sync in the static schedule, the exchange follows. 
+   Work stealing ends with a barrier */
+void schedule_colors_comm(solver_data *sd
+			  , face_kernel fn
+			  , color_hook hook
+			  , comm_data *cd
+			  , double *data
+			  , int dim2
+			  );
+
+void reset_schedule_stats(void);
+
+/* steals per sweep, barrier wait per thread and sweep */
+void get_schedule_stats(double *steals, double *wait);
+
+#endif
@@ -13,6 +13,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include <mpi.h>
 #ifdef USE_GASPI
 #include <GASPI.h>
@@ -21,6 +22,15 @@
 #include "util.h"
 
 #include "gradients.h"
+#include "gradients_sp.h"
+#include "gradients_wlsq.h"
+#include "residual.h"
+#include "rk.h"
+#include "schedule.h"
+#include "dataflow.h"
+#include "barrier.h"
+#include "threads.h"
+#include "progress.h"
 #include "rangelist.h"
 #include "exchange_data_mpi.h"
 #include "exchange_data_mpidma.h"
@@ -29,7 +39,7 @@
 #endif
 
 #define N_MEDIAN 100
-#define N_SOLVER 10
+#define N_SOLVER 14
 
 void test_solver(comm_data *cd, solver_data *sd)
 {
@@ -72,7 +82,7 @@ void test_solver(comm_data *cd, solver_data *sd)
       /* MPI bulk sync, early recv */
       time = -now();
       MPI_Barrier(MPI_COMM_WORLD);
-      exchange_dbl_mpi_post_recv(cd, NGRAD * 3);
+      exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
 #pragma omp parallel default (none) shared(cd, sd, stdout)
       {
 	int i;
@@ -89,7 +99,7 @@ void test_solver(comm_data *cd, solver_data *sd)
       /* MPI async */
       time = -now();
       MPI_Barrier(MPI_COMM_WORLD);
-      exchange_dbl_mpi_post_recv(cd, NGRAD * 3);
+      exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
 #pragma omp parallel default (none) shared(cd, sd, stdout)
       {
 	int i;
@@ -199,6 +209,74 @@ void test_solver(comm_data *cd, solver_data *sd)
       time += now();
       median[9][k] = time;
 
+      /* MPI task dataflow */
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+      exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
+#pragma omp parallel default (none) shared(cd, sd, stdout)
+      {
+	compute_gradients_gg_mpi_dataflow(cd, sd);
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[12][k] = time;
+
+      /* MPI async, progress thread */
+      median[13][k] = 0.0;
+      if (progress_thread_active())
+	{
+	  time = -now();
+	  MPI_Barrier(MPI_COMM_WORLD);
+	  progress_post_recv(cd, sd->grad, sd->grad_dim);
+#pragma omp parallel default (none) shared(cd, sd, stdout)
+	  {
+	    int i;
+	    for (i = 0; i < sd->niter; ++i)
+	      {
+		int final = (i == sd->niter-1) ? 1 : 0;
+		compute_gradients_gg_mpi_progress(cd, sd, final);
+	      }  
+	  }
+	  MPI_Barrier(MPI_COMM_WORLD);
+	  time += now();
+	  median[13][k] = time;
+	}
+
+      /* WLSQ kernels, comm free and MPI async */
+      const face_kernel *gg = get_gradient_kernels();
+      set_gradient_kernels(get_wlsq_kernels());
+
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+#pragma omp parallel default (none) shared(cd, sd, stdout)
+      {
+	int i;
+	for (i = 0; i < sd->niter; ++i)
+	  {
+	    compute_gradients_gg_comm_free(sd);
+	  }
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[10][k] = time;
+
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+      exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
+#pragma omp parallel default (none) shared(cd, sd, stdout)
+      {
+	int i;
+	for (i = 0; i < sd->niter; ++i)
+	  {
+	    int final = (i == sd->niter-1) ? 1 : 0;
+	    compute_gradients_gg_mpi_async(cd, sd, final);
+	  }  
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[11][k] = time;
+
+      set_gradient_kernels(gg);
     }
 
   if (cd->iProc == 0)
@@ -239,5 +317,585 @@ void test_solver(comm_data *cd, solver_data *sd)
       printf(" exchange_dbl_mpipscw_async_serialized: %10.6f\n",median[9][N_MEDIAN/2]);
 #endif
 
+#ifdef USE_MPI_MULTI_THREADED
+      printf("       exchange_dbl_mpi_dataflow_multi: %10.6f\n",median[12][N_MEDIAN/2]);
+#else
+      printf("  exchange_dbl_mpi_dataflow_serialized: %10.6f\n",median[12][N_MEDIAN/2]);
+#endif
+
+      if (progress_thread_active())
+	{
+	  printf("      exchange_dbl_mpi_progress_thread: %10.6f\n",median[13][N_MEDIAN/2]);
+	  printf("           progress thread gain /async: %10.6f\n"
+		 ,median[3][N_MEDIAN/2] / median[13][N_MEDIAN/2]);
+	}
+
+      printf("                        wlsq_comm_free: %10.6f\n",median[10][N_MEDIAN/2]);
+#ifdef USE_MPI_MULTI_THREADED
+      printf("     wlsq_exchange_dbl_mpi_async_multi: %10.6f\n",median[11][N_MEDIAN/2]);
+#else
+      printf("wlsq_exchange_dbl_mpi_async_serialized: %10.6f\n",median[11][N_MEDIAN/2]);
+#endif
+
+    }
+}
+
+
+/* non constant var field with consistent halos, a constant field has 
+   vanishing gradients except at the boundaries */
+static void set_test_var(comm_data *cd, solver_data *sd)
+{
+  int i, eq;
+  for (i = 0; i < sd->nownpoints; ++i)
+    {
+      for (eq = 0; eq < sd->ngrad; ++eq)
+	{
+	  sd->var[layout_index(&(sd->layout), sd->var_dim, i, eq)] 
+	    = 1.0 + 0.1 * sin(0.37 * i + eq);
+	}
+    }
+#pragma omp parallel default (none) shared(cd, sd, stdout)
+  {
+    exchange_dbl_mpi_bulk_sync(cd
+			       , sd->var
+			       , sd->var_dim
+			       );
+  }
+}
+
+/* copy of ncomp components of the own points of data (dim per point) */
+static double* copy_own_points(const solver_data *sd
+			       , const double *data
+			       , int dim
+			       , int ncomp
+			       )
+{
+  double *ref = check_malloc(sd->nownpoints * ncomp * sizeof(double));
+  int i, c;
+  for (i = 0; i < sd->nownpoints; ++i)
+    {
+      for (c = 0; c < ncomp; ++c)
+	{
+	  ref[i * ncomp + c] = data[layout_index(&(sd->layout), dim, i, c)];
+	}
+    }
+  return ref;
+}
+
+/* max deviation of data to ref (copy_own_points) relative to 
+   max |ref - shift|, over all ranks. shift: the constant part of a 
+   field (var), which would hide its deviations */
+static double max_rel_deviation(const solver_data *sd
+				, const double *data
+				, int dim
+				, int ncomp
+				, const double *ref
+				, double shift
+				)
+{
+  double dev[2] = { 0.0, 0.0 }, gdev[2];
+  int i, c;
+  for (i = 0; i < sd->nownpoints; ++i)
+    {
+      for (c = 0; c < ncomp; ++c)
+	{
+	  const double val = data[layout_index(&(sd->layout), dim, i, c)];
+	  dev[0] = MAX(dev[0], fabs(val - ref[i * ncomp + c]));
+	  dev[1] = MAX(dev[1], fabs(ref[i * ncomp + c] - shift));
+	}
+    }
+  MPI_Allreduce(dev, gdev, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return (gdev[1] > 0.0) ? gdev[0] / gdev[1] : gdev[0];
+}
+
+
+/* comm free gradients in double and reduced precision, on a non constant
+   var field */
+void test_precision(comm_data *cd, solver_data *sd, int precision)
+{
+  int k;
+  double time, median[2][N_MEDIAN];
+
+  if (precision == PRECISION_DOUBLE)
+    {
+      return;
+    }
+
+  set_test_var(cd, sd);
+  update_var_sp(sd);
+
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      /* comm free, double */
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+#pragma omp parallel default (none) shared(sd, stdout)
+      {
+	int j;
+	for (j = 0; j < sd->niter; ++j)
+	  {
+	    compute_gradients_gg_comm_free(sd);
+	  }
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[0][k] = time;
+
+      /* comm free, reduced precision */
+      time = -now();
+      MPI_Barrier(MPI_COMM_WORLD);
+#pragma omp parallel default (none) shared(sd, stdout)
+      {
+	int j;
+	for (j = 0; j < sd->niter; ++j)
+	  {
+	    compute_gradients_gg_sp_comm_free(sd);
+	  }
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      time += now();
+      median[1][k] = time;
+    }
+
+  /* max deviation to double */
+  const int ncomp = 3 * sd->ngrad;
+  double *ref = copy_own_points(sd, sd->grad, sd->grad_dim, ncomp);
+  copy_gradients_sp(sd, sd->grad);
+  const double deviation = max_rel_deviation(sd, sd->grad, sd->grad_dim, ncomp, ref, 0.0);
+  check_free(ref);
+
+  if (cd->iProc == 0)
+    {
+      for (k = 0; k < 2; ++k)
+	{ 
+	  sort_median(&median[k][0], &median[k][N_MEDIAN-1]);
+	}
+
+      printf("                             precision: %s\n", precision_name(precision));
+      printf("                             comm_free: %10.6f\n",median[0][N_MEDIAN/2]);
+      printf("                          comm_free_sp: %10.6f\n",median[1][N_MEDIAN/2]);
+      printf("                               speedup: %10.6f\n"
+	     ,median[0][N_MEDIAN/2] / median[1][N_MEDIAN/2]);
+      printf("           max rel deviation to double: %10.3e\n", deviation);
+    }
+}
+
+
+static double time_comm_free(solver_data *sd)
+{
+  double time = -now();
+  MPI_Barrier(MPI_COMM_WORLD);
+#pragma omp parallel default (none) shared(sd, stdout)
+  {
+    int j;
+    for (j = 0; j < sd->niter; ++j)
+      {
+	compute_gradients_gg_comm_free(sd);
+      }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  time += now();
+  return time;
+}
+
+void test_segmented(comm_data *cd, solver_data *sd)
+{
+  int k;
+  double median[2][N_MEDIAN];
+
+  if (!get_segment_faces())
+    {
+      return;
+    }
+  set_test_var(cd, sd);
+
+  /* scatter kernels, same face order */
+  select_segmented_kernels(false);
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[0][k] = time_comm_free(sd);
+    }
+  const int ncomp = 3 * sd->ngrad;
+  double *ref = copy_own_points(sd, sd->grad, sd->grad_dim, ncomp);
+
+  /* segmented kernels */
+  select_segmented_kernels(true);
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[1][k] = time_comm_free(sd);
+    }
+  const double deviation = max_rel_deviation(sd, sd->grad, sd->grad_dim, ncomp, ref, 0.0);
+  check_free(ref);
+
+  if (cd->iProc == 0)
+    {
+      for (k = 0; k < 2; ++k)
+	{ 
+	  sort_median(&median[k][0], &median[k][N_MEDIAN-1]);
+	}
+
+      printf("                     comm_free scatter: %10.6f\n",median[0][N_MEDIAN/2]);
+      printf("                   comm_free segmented: %10.6f\n",median[1][N_MEDIAN/2]);
+      printf("                               speedup: %10.6f\n"
+	     ,median[0][N_MEDIAN/2] / median[1][N_MEDIAN/2]);
+      printf("          max rel deviation to scatter: %10.3e\n", deviation);
+    }
+}
+
+
+void test_cross_faces(comm_data *cd, solver_data *sd)
+{
+  int k;
+  double median[2][N_MEDIAN];
+
+  if (!cross_buffers_available())
+    {
+      return;
+    }
+  set_test_var(cd, sd);
+
+  /* duplicated cross faces, same colors */
+  select_cross_buffers(false);
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[0][k] = time_comm_free(sd);
+    }
+  const int ncomp = 3 * sd->ngrad;
+  double *ref = copy_own_points(sd, sd->grad, sd->grad_dim, ncomp);
+
+  /* cross faces computed once */
+  select_cross_buffers(true);
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[1][k] = time_comm_free(sd);
+    }
+  const double deviation = max_rel_deviation(sd, sd->grad, sd->grad_dim, ncomp, ref, 0.0);
+  check_free(ref);
+
+  if (cd->iProc == 0)
+    {
+      for (k = 0; k < 2; ++k)
+	{ 
+	  sort_median(&median[k][0], &median[k][N_MEDIAN-1]);
+	}
+
+      printf("           comm_free cross faces twice: %10.6f\n",median[0][N_MEDIAN/2]);
+      printf("            comm_free cross faces once: %10.6f\n",median[1][N_MEDIAN/2]);
+      printf("                               speedup: %10.6f\n"
+	     ,median[0][N_MEDIAN/2] / median[1][N_MEDIAN/2]);
+      printf("        max rel deviation to duplicate: %10.3e\n", deviation);
+    }
+}
+
+
+static double time_residual(comm_data *cd, solver_data *sd, int fused)
+{
+  double time = -now();
+  MPI_Barrier(MPI_COMM_WORLD);
+  exchange_dbl_mpi_post_recv(cd, sd->grad_dim);
+#pragma omp parallel default (none) shared(cd, sd, fused, stdout)
+  {
+    int j;
+    for (j = 0; j < sd->niter; ++j)
+      {
+	int final = (j == sd->niter-1) ? 1 : 0;
+	if (fused)
+	  {
+	    compute_residual_fused(cd, sd, final);
+	  }
+	else
+	  {
+	    compute_residual_unfused(cd, sd, final);
+	  }
+      }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  time += now();
+  return time;
+}
+
+/* residual (limiter, reconstruction, flux), unfused vs fused with the 
+   gradients, on a non constant var field with consistent halos */
+void test_residual(comm_data *cd, solver_data *sd)
+{
+  int k;
+  double median[2][N_MEDIAN];
+
+  set_test_var(cd, sd);
+
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[0][k] = time_residual(cd, sd, 0);
+      median[1][k] = time_residual(cd, sd, 1);
+    }
+
+  /* fused result, max deviation unfused/fused */
+  double *ref = copy_own_points(sd, sd->res, sd->var_dim, sd->ngrad);
+  time_residual(cd, sd, 0);
+  const double deviation = max_rel_deviation(sd, sd->res, sd->var_dim, sd->ngrad, ref, 0.0);
+  check_free(ref);
+
+  if (cd->iProc == 0)
+    {
+      for (k = 0; k < 2; ++k)
+	{ 
+	  sort_median(&median[k][0], &median[k][N_MEDIAN-1]);
+	}
+
+      printf("                      residual_unfused: %10.6f\n",median[0][N_MEDIAN/2]);
+      printf("                        residual_fused: %10.6f\n",median[1][N_MEDIAN/2]);
+      printf("                               speedup: %10.6f\n"
+	     ,median[0][N_MEDIAN/2] / median[1][N_MEDIAN/2]);
+      printf("       max rel deviation fused/unfused: %10.3e\n", deviation);
+    }
+}
+
+
+/* reproducible start field for the time stepping, consistent halos */
+static void reset_rk_field(comm_data *cd, solver_data *sd)
+{
+  set_test_var(cd, sd);
+  reset_rk(sd);
+}
+
+static double time_rk(comm_data *cd, solver_data *sd, int comm)
+{
+  reset_rk_field(cd, sd);
+  double time = -now();
+  MPI_Barrier(MPI_COMM_WORLD);
+  rk_comm_start(cd, sd, comm);
+#pragma omp parallel default (none) shared(cd, sd, comm, stdout)
+  {
+    int j;
+    for (j = 0; j < sd->niter; ++j)
+      {
+	int final = (j == sd->niter-1) ? 1 : 0;
+	rk_step(cd, sd, comm, final);
+      }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  time += now();
+  return time;
+}
+
+/* niter explicit RK time steps, a grad and a var halo exchange per stage, 
+   for all exchange variants. The final var is compared to bulk sync */
+void test_rk(comm_data *cd, solver_data *sd)
+{
+  int k, comm;
+  double median[N_RK_COMM][N_MEDIAN];
+  double deviation[N_RK_COMM];
+
+  if (get_rk_stages() == 0)
+    {
+      return;
+    }
+
+  double *ref = NULL;
+  for (comm = 0; comm < N_RK_COMM; ++comm)
+    {
+      if (!rk_comm_available(comm))
+	{
+	  continue;
+	}
+      for (k = 0; k < N_MEDIAN; ++k)
+	{ 
+	  median[comm][k] = time_rk(cd, sd, comm);
+	}
+
+      /* max deviation to bulk sync. var is 1 + O(0.1) (set_test_var), 
+	 relative to the varying part */
+      if (comm == RK_MPI_BULK_SYNC)
+	{
+	  ref = copy_own_points(sd, sd->var, sd->var_dim, sd->ngrad);
+	}
+      deviation[comm] = max_rel_deviation(sd, sd->var, sd->var_dim, sd->ngrad, ref, 1.0);
+    }
+  check_free(ref);
+
+  if (cd->iProc == 0)
+    {
+      printf("                             rk stages: %d\n", get_rk_stages());
+      for (comm = 0; comm < N_RK_COMM; ++comm)
+	{
+	  if (!rk_comm_available(comm))
+	    {
+	      continue;
+	    }
+	  sort_median(&median[comm][0], &median[comm][N_MEDIAN-1]);
+	  printf("%38s: %10.6f   max rel deviation: %10.3e\n"
+		 , rk_comm_name(comm), median[comm][N_MEDIAN/2], deviation[comm]);
+	}
+    }
+}
+
+
+/* comm free gradients, static vs work stealing color schedule */
+void test_schedule(comm_data *cd, solver_data *sd)
+{
+  int k, mode;
+  double median[2][N_MEDIAN], steals[2], wait[2];
+
+  if (get_schedule() != SCHEDULE_STEAL)
+    {
+      return;
+    }
+  set_test_var(cd, sd);
+
+  const int ncomp = 3 * sd->ngrad;
+  double *ref = NULL;
+  double deviation = 0.0;
+  for (mode = SCHEDULE_STATIC; mode <= SCHEDULE_STEAL; mode++)
+    {
+      set_schedule(mode);
+      reset_schedule_stats();
+      for (k = 0; k < N_MEDIAN; ++k)
+	{ 
+	  median[mode][k] = time_comm_free(sd);
+	}
+      get_schedule_stats(&steals[mode], &wait[mode]);
+
+      /* max deviation of work stealing to static */
+      if (mode == SCHEDULE_STATIC)
+	{
+	  ref = copy_own_points(sd, sd->grad, sd->grad_dim, ncomp);
+	}
+      else
+	{
+	  deviation = max_rel_deviation(sd, sd->grad, sd->grad_dim, ncomp, ref, 0.0);
+	}
+    }
+  check_free(ref);
+
+  /* max over ranks */
+  double lstat[4] = { steals[0], steals[1], wait[0], wait[1] }, gstat[4];
+  MPI_Allreduce(lstat, gstat, 4, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  if (cd->iProc == 0)
+    {
+      for (k = 0; k < 2; ++k)
+	{ 
+	  sort_median(&median[k][0], &median[k][N_MEDIAN-1]);
+	}
+
+      printf("                      comm_free static: %10.6f\n",median[0][N_MEDIAN/2]);
+      printf("                       comm_free steal: %10.6f\n",median[1][N_MEDIAN/2]);
+      printf("                               speedup: %10.6f\n"
+	     ,median[0][N_MEDIAN/2] / median[1][N_MEDIAN/2]);
+      printf("                      steals per sweep: %10.3f\n", gstat[1]);
+      printf("          barrier wait static [thread]: %10.3e\n", gstat[2]);
+      printf("           barrier wait steal [thread]: %10.3e\n", gstat[3]);
+      printf("           max rel deviation to static: %10.3e\n", deviation);
+    }
+}
+
+
+#define BARRIER_OP_BARRIER 0
+#define BARRIER_OP_FIRST   1
+#define BARRIER_OP_LAST    2
+#define BARRIER_OP_SYNC    3
+
+static double time_barrier(int mode, int op, int reps)
+{
+  int elected = 0;
+  set_barrier_mode(mode);
+  double time = -now();
+#pragma omp parallel default (none) shared(op, reps, elected)
+  {
+    int i;
+    for (i = 0; i < reps; ++i)
+      {
+	if (op == BARRIER_OP_BARRIER)
+	  {
+	    thread_barrier();
+	  }
+	else if (op == BARRIER_OP_SYNC)
+	  {
+	    thread_sync(0);
+	  }
+	else if ((op == BARRIER_OP_FIRST) ? this_is_the_first_thread() 
+		 : this_is_the_last_thread())
+	  {
+#pragma omp atomic
+	    elected++;
+	  }
+      }
+  }
+  time += now();
+  ASSERT(op == BARRIER_OP_BARRIER || op == BARRIER_OP_SYNC || elected == reps);
+  return 1.0e6 * time / reps;
+}
+
+/* barriers and elections per mode, microseconds per call. The central 
+   barrier is the omp barrier, the dissemination elections are the tree 
+   elections. neighbor_sync waits for the thread neighbors only */
+void test_barrier(comm_data *cd, int reps)
+{
+  const int mode = get_barrier_mode();
+  double median[8][N_MEDIAN], lmed[8], gmed[8];
+  int k, j;
+
+  if (reps <= 0)
+    {
+      return;
+    }
+
+  for (k = 0; k < N_MEDIAN; ++k)
+    { 
+      median[0][k] = time_barrier(BARRIER_CENTRAL, BARRIER_OP_BARRIER, reps);
+      median[1][k] = time_barrier(BARRIER_CENTRAL, BARRIER_OP_FIRST, reps);
+      median[2][k] = time_barrier(BARRIER_CENTRAL, BARRIER_OP_LAST, reps);
+      median[3][k] = time_barrier(BARRIER_TREE, BARRIER_OP_BARRIER, reps);
+      median[4][k] = time_barrier(BARRIER_TREE, BARRIER_OP_FIRST, reps);
+      median[5][k] = time_barrier(BARRIER_TREE, BARRIER_OP_LAST, reps);
+      median[6][k] = time_barrier(BARRIER_DISSEMINATION, BARRIER_OP_BARRIER, reps);
+      median[7][k] = time_barrier(BARRIER_NEIGHBOR, BARRIER_OP_SYNC, reps);
+    }
+  set_barrier_mode(mode);
+
+  for (j = 0; j < 8; ++j)
+    { 
+      sort_median(&median[j][0], &median[j][N_MEDIAN-1]);
+      lmed[j] = median[j][N_MEDIAN/2];
+    }
+  MPI_Allreduce(lmed, gmed, 8, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  if (cd->iProc == 0)
+    {
+      printf("                    omp_barrier [usec]: %10.3f\n", gmed[0]);
+      printf("            central_elect_first [usec]: %10.3f\n", gmed[1]);
+      printf("             central_elect_last [usec]: %10.3f\n", gmed[2]);
+      printf("                   tree_barrier [usec]: %10.3f\n", gmed[3]);
+      printf("               tree_elect_first [usec]: %10.3f\n", gmed[4]);
+      printf("                tree_elect_last [usec]: %10.3f\n", gmed[5]);
+      printf("          dissemination_barrier [usec]: %10.3f\n", gmed[6]);
+      printf("                  neighbor_sync [usec]: %10.3f\n", gmed[7]);
+    }
+}
+
+
+void report_startup(comm_data *cd)
+{
+  const int n = get_startup_nphases();
+  double ltime[MAX_STARTUP_PHASES + 1], gtime[MAX_STARTUP_PHASES + 1];
+  int i;
+
+  ltime[n] = 0.0;
+  for (i = 0; i < n; ++i)
+    {
+      ltime[i] = get_startup_phase_time(i);
+      ltime[n] += ltime[i];
+    }
+  MPI_Allreduce(ltime, gtime, n + 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  if (cd->iProc == 0)
+    {
+      char label[64];
+      for (i = 0; i < n; ++i)
+	{
+	  snprintf(label, sizeof(label), "startup %s [s]", get_startup_phase_name(i));
+	  printf("%38s: %10.6f\n", label, gtime[i]);
+	}
+      printf("                     startup total [s]: %10.6f\n", gtime[n]);
     }
 }
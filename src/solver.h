@@ -6,4 +6,21 @@
 
 void test_solver(comm_data *cd, solver_data *sd);
 
+void test_precision(comm_data *cd, solver_data *sd, int precision);
+
+void test_segmented(comm_data *cd, solver_data *sd);
+
+void test_cross_faces(comm_data *cd, solver_data *sd);
+
+void test_residual(comm_data *cd, solver_data *sd);
+
+void test_rk(comm_data *cd, solver_data *sd);
+
+void test_schedule(comm_data *cd, solver_data *sd);
+
+void test_barrier(comm_data *cd, int reps);
+
+/* startup phases (startup_phase), max over ranks */
+void report_startup(comm_data *cd);
+
 #endif
@@ -23,41 +23,124 @@
 #include "util.h"
 
 
-static void init_var(double (*var)[NGRAD], int nallpoints)
+static void init_data_layout(data_layout *l
+			     , int type
+			     , int nallpoints
+			     )
+{
+  l->type = type;
+  switch (type)
+    {
+    case LAYOUT_SOA:
+      l->shift = 0;
+      l->mask = -1;
+      l->block = 0;
+      l->cstride = ((nallpoints + SIMD_WIDTH - 1) / SIMD_WIDTH) * SIMD_WIDTH;
+      break;
+    case LAYOUT_AOSOA:
+      l->shift = 3;
+      l->mask = AOSOA_BLOCK - 1;
+      l->block = AOSOA_BLOCK;
+      l->cstride = AOSOA_BLOCK;
+      break;
+    default:
+      l->shift = 0;
+      l->mask = 0;
+      l->block = 1;
+      l->cstride = 1;
+      break;
+    }
+  ASSERT(l->block == 0 || l->block == (1 << l->shift));
+}
+
+size_t layout_size(const data_layout *l
+		   , int dim
+		   , int nallpoints
+		   )
+{
+  size_t npoints = nallpoints;
+  if (l->block == 0)
+    {
+      npoints = l->cstride;
+    }
+  else if (l->block > 1)
+    {
+      npoints = ((nallpoints + l->block - 1) / l->block) * l->block;
+    }
+  return npoints * dim * sizeof(double);
+}
+
+const char* layout_name(int type)
+{
+  switch (type)
+    {
+    case LAYOUT_AOS_PADDED:
+      return "aos8";
+    case LAYOUT_SOA:
+      return "soa";
+    case LAYOUT_AOSOA:
+      return "aosoa";
+    default:
+      return "aos";
+    }
+}
+
+static void init_var(solver_data *sd)
 {
   int i,j;
-  for (i = 0; i< nallpoints; ++i)
+  size_t sz = layout_size(&(sd->layout), sd->var_dim, sd->nallpoints);
+  memset(sd->var, 0, sz);
+  for (i = 0; i< sd->nallpoints; ++i)
     {
-      for (j = 0; j < NGRAD; ++j)
+      for (j = 0; j < sd->ngrad; ++j)
 	{
-	  var[i][j] = 1.0;
+	  sd->var[layout_index(&(sd->layout), sd->var_dim, i, j)] = 1.0;
 	}
     }
 }
 
-static void init_grad(double (*grad)[NGRAD][3], int nallpoints)
+static void init_grad(solver_data *sd)
 {
-  int i,j,k;
-  for (i = 0; i< nallpoints; ++i)
+  int i,j;
+  size_t sz = layout_size(&(sd->layout), sd->grad_dim, sd->nallpoints);
+  memset(sd->grad, 0, sz);
+  for (i = 0; i< sd->nallpoints; ++i)
     {
-      for (j = 0; j < NGRAD; ++j)
+      for (j = 0; j < sd->ngrad * 3; ++j)
 	{
-	  for (k = 0; k < 3; ++k)
-	    {
-	      grad[i][j][k] = 1.0;
-	    }
+	  sd->grad[layout_index(&(sd->layout), sd->grad_dim, i, j)] = 1.0;
 	}
     }
 }
 
-void init_solver_data(solver_data *sd, int NITER)
+void init_solver_data(solver_data *sd
+		      , const solver_options *opt
+		      , int NITER
+		      )
 {
   ASSERT(sd != NULL);
   ASSERT(sd->nallpoints != 0);
 
-  /* initialize var/grad */
-  init_var(sd->var, sd->nallpoints);
-  init_grad(sd->grad, sd->nallpoints);
+  /* data layout */
+  ASSERT(opt->ngrad > 0);
+  init_data_layout(&(sd->layout), opt->layout, sd->nallpoints);
+  sd->ngrad = opt->ngrad;
+  sd->var_dim = sd->ngrad;
+  if (opt->layout == LAYOUT_AOS_PADDED)
+    {
+      sd->var_dim = ((sd->ngrad + SIMD_WIDTH - 1) / SIMD_WIDTH) * SIMD_WIDTH;
+    }
+  sd->grad_dim = 3 * sd->var_dim;
+
+  /* alloc */
+  sd->var = check_malloc_aligned(layout_size(&(sd->layout), sd->var_dim, sd->nallpoints));
+  sd->grad = check_malloc_aligned(layout_size(&(sd->layout), sd->grad_dim, sd->nallpoints));
+  sd->res = check_malloc_aligned(layout_size(&(sd->layout), sd->var_dim, sd->nallpoints));
+
+  /* initialize var/grad/res */
+  init_var(sd);
+  init_grad(sd);
+  memset(sd->res, 0, layout_size(&(sd->layout), sd->var_dim, sd->nallpoints));
 
   /* set num iterations */
   sd->niter = NITER;
@@ -76,9 +159,16 @@ void read_solver_data(int ncid, solver_data *sd)
   sd->fpoint = NULL;
   sd->fnormal = NULL;
   sd->pvolume = NULL;
+  sd->ngrad = 0;
+  sd->var_dim = 0;
+  sd->grad_dim = 0;
   sd->var = NULL;
   sd->grad = NULL;
+  sd->res = NULL;
   sd->fcolor = NULL;
+  sd->pfaces.start = NULL;
+  sd->pfaces.point = NULL;
+  sd->pfaces.normal = NULL;
   sd->niter = 0;
 
   /* read val */
@@ -92,14 +182,11 @@ void read_solver_data(int ncid, solver_data *sd)
   ASSERT(sd->nfaces > 0);
   ASSERT(sd->nownpoints > 0);
   ASSERT(sd->nallpoints > 0);
-  ASSERT(NGRAD > 0);
 
   /* alloc */
   sd->fpoint = check_malloc(sd->nfaces * 2 * sizeof(int));
   sd->fnormal = check_malloc(sd->nfaces * 3 * sizeof(double));
   sd->pvolume = check_malloc(sd->nallpoints * sizeof(double));
-  sd->var = check_malloc(sd->nallpoints * NGRAD * sizeof(double));
-  sd->grad = check_malloc(sd->nallpoints * NGRAD * 3 * sizeof(double));
   sd->fcolor = check_malloc(sd->ncolors * sizeof(RangeList));
 
   /* read data */
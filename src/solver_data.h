@@ -5,13 +5,29 @@
 #include <GASPI.h>
 #endif
 #include <omp.h>
+#include <string.h>
 
-#define NGRAD 7
+#include "options.h"
 
-typedef struct 
+#define NGRAD 7   // default number of transported variables
+
+/* memory layout of var/grad */
+#define LAYOUT_AOS        0  // [point][comp]
+#define LAYOUT_AOS_PADDED 1  // [point][comp], comp padded to SIMD_WIDTH
+#define LAYOUT_SOA        2  // [comp][point]
+#define LAYOUT_AOSOA      3  // [block][comp][AOSOA_BLOCK]
+
+#define SIMD_WIDTH 8
+#define AOSOA_BLOCK 8
+
+typedef struct
 {
-  int global  __attribute__((aligned(64)));
-} counter_t;
+  int type;
+  int shift;   // log2 of points per block
+  int mask;    // point index within block
+  int block;   // points per block, 0 for a single block (SoA)
+  int cstride; // distance between two components of a point
+} data_layout;
 
 typedef struct 
 {
@@ -22,17 +38,34 @@ typedef struct
 {
   int  (*fpoint)[2];
   double (*fnormal)[3];
+  float (*fnormal_sp)[3]; // reduced precision copy, see gradients_sp.c
+  int  *fslot;     // segmented face order, p1 slot in fbuffer 
+  double *fbuffer; // segmented face order, p1 contributions of a color
+  int  ncross;     // CROSS_BUFFER, cross faces computed by the thread
+  int  *cross_face;
+  int  (*cross_slot)[2]; // p0/p1 accumulation slot of a cross face
+  int  cross_slots[2];   // own slot range, zeroed per sweep
 } solver_data_local;
 
+struct solver_data_t;
+
 typedef struct RangeList_t
 {
   // next slice - linked list
   struct RangeList_t *succ;
 
+  // face kernel, specialized for ftype
+  void (*kernel)(struct RangeList_t *color, struct solver_data_t *sd);
+
   // meta data
   int  start;
   int  stop;
   int  ftype; //  face type   
+  int  batch_stop; // [start, batch_stop) conflict free face batches
+  int  nbuffer_points; // ftype 1 in segmented face order, p1 of color
+  int  *buffer_points;
+  int  nreduce_points; // CROSS_BUFFER, cross face slots added before scaling
+  int  *reduce_points;
   
   // points of color 
   int  nall_points_of_color; // incl. addpoints
@@ -53,7 +86,15 @@ typedef struct RangeList_t
 } RangeList;
 
 
-typedef struct 
+/* CSR point to face adjacency of the own points, see init_point_faces */
+typedef struct
+{
+  int     *start;       // [nownpoints + 1]
+  int     *point;       // opposite point of the face
+  double  (*normal)[3]; // face normal, signed outward of the point
+} point_faces;
+
+typedef struct solver_data_t
 {
   int     nfaces;
   int     nallfaces;
@@ -63,14 +104,85 @@ typedef struct
   int     (*fpoint)[2];
   double  (*fnormal)[3];
   double  *pvolume;
-  double  (*var)[NGRAD];
-  double  (*grad)[NGRAD][3];
+  data_layout layout;
+  int     ngrad;    // number of transported variables
+  int     var_dim;  // doubles per point in var, incl. padding
+  int     grad_dim; // doubles per point in grad, incl. padding
+  double  *var;
+  double  *grad;
+  double  *res;     // residual, var layout, see residual.c
   RangeList *fcolor;
+  point_faces pfaces; // ENGINE_CSR, limiter
   int     niter;
 } solver_data ;
 
+typedef void (*face_kernel)(RangeList *color, solver_data *sd);
+
 
-void init_solver_data(solver_data *sd, int NITER);
+/* offset of component c of point pnt in a field with dim components */
+static inline int layout_index(const data_layout *l
+			       , int dim
+			       , int pnt
+			       , int c
+			       )
+{
+  return (pnt >> l->shift) * l->block * dim + c * l->cstride + (pnt & l->mask);
+}
+
+/* gather/scatter all dim components of a point from/to a contiguous buffer */
+static inline void layout_copy_out(const data_layout *l
+				   , double *buf
+				   , const double *data
+				   , int dim
+				   , int pnt
+				   )
+{
+  if (l->cstride == 1)
+    {
+      memcpy(buf, &data[layout_index(l, dim, pnt, 0)], dim * sizeof(double));
+    }
+  else
+    {
+      int c;
+      for (c = 0; c < dim; c++)
+	{
+	  buf[c] = data[layout_index(l, dim, pnt, c)];
+	}
+    }
+}
+
+static inline void layout_copy_in(const data_layout *l
+				  , double *data
+				  , const double *buf
+				  , int dim
+				  , int pnt
+				  )
+{
+  if (l->cstride == 1)
+    {
+      memcpy(&data[layout_index(l, dim, pnt, 0)], buf, dim * sizeof(double));
+    }
+  else
+    {
+      int c;
+      for (c = 0; c < dim; c++)
+	{
+	  data[layout_index(l, dim, pnt, c)] = buf[c];
+	}
+    }
+}
+
+void init_solver_data(solver_data *sd
+		      , const solver_options *opt
+		      , int NITER
+		      );
 void read_solver_data(int ncid, solver_data *sd);
+const char* layout_name(int type);
+
+/* bytes of a field with dim components per point */
+size_t layout_size(const data_layout *l
+		   , int dim
+		   , int nallpoints
+		   );
 
 #endif
@@ -20,6 +20,8 @@
 #include <mpi.h>
 #include <omp.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #include "read_netcdf.h"
 #include "solver_data.h"
@@ -32,36 +34,101 @@
 #include "util.h"
 #include "rangelist.h"
 #include "threads.h"
+#include "schedule.h"
+#include "dataflow.h"
+#include "barrier.h"
+#include "progress.h"
+
+
+/*----------------------------------------------------------------------------
+| halo send completion. Every thread counts down its own points of a 
+| partner (remain_local), the thread which completes its share arrives 
+| at the countdown latch of the partner with its share. The thread which
+| brings the latch to zero sends. 
+|
+| A latch word holds [epoch:32][remaining:32] and is updated by CAS. The 
+| first arrival of an epoch finds the word of an older epoch and starts
+| the count from the partner total, no reset and no barrier is needed. 
+| Two latches per partner (epoch parity) allow the threads to be one 
+| epoch apart. Epochs wrap, they are only compared for equality.
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  _Atomic uint64_t slot[2];
+} __attribute__((aligned(64))) countdown_latch;
 
+static countdown_latch *send_latch = NULL;
+static countdown_latch put_latch;
 
 /* comm var for threadprivate comm */
-static volatile counter_t *inc_send = NULL; 
-static int *inc_send_local = NULL;
-#pragma omp threadprivate(inc_send_local)
+static int *remain_local = NULL;
+#pragma omp threadprivate(remain_local)
+static uint32_t *epoch_local = NULL;
+#pragma omp threadprivate(epoch_local)
 static int *sendcount_local = NULL;
 #pragma omp threadprivate(sendcount_local)
 
-/* getter/setter functions for global increments */
-int get_inc_send(int i)
+/* thread id per point, kept for rebuild_threads */
+static int *thread_pid = NULL;
+
+static void init_latch(countdown_latch *l)
 {
-  return inc_send[i].global;
+  atomic_init(&(l->slot[0]), 0);
+  atomic_init(&(l->slot[1]), 0);
 }
-int set_inc_send(int i, int val)
+
+/* true for the arrival which completes epoch e */
+static bool latch_arrive(countdown_latch *l
+			 , uint32_t e
+			 , uint32_t total
+			 , uint32_t count
+			 )
 {
-  return my_add_and_fetch(&inc_send[i].global, val);
+  _Atomic uint64_t *word = &(l->slot[e & 1]);
+  uint64_t old = atomic_load_explicit(word, memory_order_acquire), val;
+  do
+    {
+      const uint32_t remaining = ((uint32_t) (old >> 32) == e) ? (uint32_t) old : total;
+      ASSERT(remaining >= count);
+      val = ((uint64_t) e << 32) | (remaining - count);
+    }
+  while (!atomic_compare_exchange_weak_explicit(word, &old, val
+						 , memory_order_acq_rel
+						 , memory_order_acquire));
+  return (uint32_t) val == 0;
 }
 
-/* getter/setter functions for threadlocal sendcount */
-int get_sendcount_local(int i)
+/* count points of commdomain i finalized by this thread, true for the 
+   thread which completes the halo send of the epoch */
+bool thread_send_complete(comm_data *cd, int i, int count)
 {
-  return sendcount_local[i];
+  remain_local[i] -= count;
+  ASSERT(remain_local[i] >= 0);
+  if (remain_local[i] > 0)
+    {
+      return false;
+    }
+  remain_local[i] = sendcount_local[i];
+  const uint32_t e = ++epoch_local[i];
+  return latch_arrive(&(send_latch[i])
+		      , e
+		      , cd->sendcount[cd->commpartner[i]]
+		      , sendcount_local[i]
+		      );
 }
-int set_inc_send_local(int i, int val)
+
+/* getter function for the thread id per point */
+const int* get_thread_pid(void)
 {
-  inc_send_local[i] += val;
-  return inc_send_local[i];
+  return thread_pid;
 }
 
+/* getter/setter functions for threadlocal sendcount */
+int get_sendcount_local(int i)
+{
+  return sendcount_local[i];
+}
 int my_add_and_fetch(volatile int *ptr, int val)
 {
 #ifdef GCC_EXTENSION
@@ -113,6 +180,9 @@ int this_is_the_first_thread(void)
 
   if(nthreads == 1)
     return 1;
+
+  if(get_barrier_mode() != BARRIER_CENTRAL)
+    return elect_first_thread();
   
   while(shared_counter < local_next)
     _mm_pause();
@@ -133,6 +203,9 @@ int this_is_the_last_thread(void)
   if(nthreads == 1)
     return 1;
 
+  if(get_barrier_mode() != BARRIER_CENTRAL)
+    return elect_last_thread();
+
   while(shared_counter < local_next)
     _mm_pause();
 
@@ -153,32 +226,42 @@ void initiate_thread_comm_mpi(RangeList *color
     {
       int i1 = color->sendpartner[i];
       int sendcount_color = color->sendcount[i];
-      if (sendcount_color > 0 && sendcount_local[i1] > 0)
+      if (sendcount_color > 0 && sendcount_local[i1] > 0
+	  && thread_send_complete(cd, i1, sendcount_color))
 	{
-	  inc_send_local[i1] += sendcount_color;
-	  if(inc_send_local[i1] % sendcount_local[i1] == 0)
-	    {
-	      int inc_global = set_inc_send(i1, sendcount_local[i1]);
-	      int k = cd->commpartner[i1];
-	      if (inc_global % cd->sendcount[k] == 0)
-		{
 #ifndef USE_MPI_MULTI_THREADED
 #pragma omp critical
 #endif
-		  {
-		    exchange_dbl_mpi_send(cd
-					  , data
-					  , dim2
-					  , i1
-					  );
-		  }
-		}
-	    }
+	  {
+	    exchange_dbl_mpi_send(cd
+				  , data
+				  , dim2
+				  , i1
+				  );
+	  }
 	}
     }
 
 }
 
+/* progress thread, the send is handed off without a critical section */
+void initiate_thread_comm_progress(RangeList *color
+				   , comm_data *cd
+				   )
+{
+  int i;
+  for(i = 0; i < color->nsendcount; i++)
+    {
+      int i1 = color->sendpartner[i];
+      int sendcount_color = color->sendcount[i];
+      if (sendcount_color > 0 && sendcount_local[i1] > 0
+	  && thread_send_complete(cd, i1, sendcount_color))
+	{
+	  progress_push_send(i1);
+	}
+    }
+}
+
 void initiate_thread_comm_mpifence(RangeList *color
 				   , comm_data *cd
 				   , double *data
@@ -190,23 +273,15 @@ void initiate_thread_comm_mpifence(RangeList *color
     {
       int i1 = color->sendpartner[i];
       int sendcount_color = color->sendcount[i];
-      if (sendcount_color > 0 && sendcount_local[i1] > 0)
+      if (sendcount_color > 0 && sendcount_local[i1] > 0
+	  && thread_send_complete(cd, i1, sendcount_color))
 	{
-	  inc_send_local[i1] += sendcount_color;
-	  if(inc_send_local[i1] % sendcount_local[i1] == 0)
-	    {
-	      int inc_global = set_inc_send(i1, sendcount_local[i1]);
-	      int k = cd->commpartner[i1];
-	      if (inc_global % cd->sendcount[k] == 0)
-		{
 #ifndef USE_MPI_MULTI_THREADED
 #pragma omp critical
 #endif
-		  {
-		    exchange_dbl_mpidma_write(cd, data, dim2, i1);
-		  }
-		}
-	    }
+	  {
+	    exchange_dbl_mpidma_write(cd, data, dim2, i1);
+	  }
 	}
     }
 }
@@ -219,32 +294,23 @@ void initiate_thread_comm_mpipscw(RangeList *color
 				  )
 {
   int i;
-  static volatile int shared_nput = 0;
   for(i = 0; i < color->nsendcount; i++)
     {
       int i1 = color->sendpartner[i];
       int sendcount_color = color->sendcount[i];
-      if (sendcount_color > 0 && sendcount_local[i1] > 0)
+      if (sendcount_color > 0 && sendcount_local[i1] > 0
+	  && thread_send_complete(cd, i1, sendcount_color))
 	{
-	  inc_send_local[i1] += sendcount_color;
-	  if(inc_send_local[i1] % sendcount_local[i1] == 0)
-	    {
-	      int inc_global = set_inc_send(i1, sendcount_local[i1]);
-	      int k = cd->commpartner[i1];
-	      if (inc_global % cd->sendcount[k] == 0)
-		{
 #ifndef USE_MPI_MULTI_THREADED
 #pragma omp critical
 #endif
-		  {
-		    exchange_dbl_mpidma_write(cd, data, dim2, i1);
-		    if (my_add_and_fetch(&shared_nput, 1) % cd->ncommdomains == 0)
-		      {
-			mpidma_async_complete();
-		      }
-		  }
-		}
-	    }
+	  {
+	    exchange_dbl_mpidma_write(cd, data, dim2, i1);
+	    if (latch_arrive(&put_latch, epoch_local[i1], cd->ncommdomains, 1))
+	      {
+		mpidma_async_complete();
+	      }
+	  }
 	}
     }
 }
@@ -262,24 +328,16 @@ void initiate_thread_comm_gaspi(RangeList *color
     {
       int i1 = color->sendpartner[i];
       int sendcount_color = color->sendcount[i];
-      if (sendcount_color > 0 && sendcount_local[i1] > 0)
+      if (sendcount_color > 0 && sendcount_local[i1] > 0
+	  && thread_send_complete(cd, i1, sendcount_color))
 	{
 	  int buffer_id = cd->send_stage % 2;
-	  inc_send_local[i1] += sendcount_color;
-	  if(inc_send_local[i1] % sendcount_local[i1] == 0)
-	    {
-	      int inc_global = set_inc_send(i1, sendcount_local[i1]);
-	      int k = cd->commpartner[i1];
-	      if (inc_global % cd->sendcount[k] == 0)
-		{
-		  exchange_dbl_gaspi_write(cd
-					   , data
-					   , dim2
-					   , buffer_id
-					   , i1
-					   );
-		}
-	    }
+	  exchange_dbl_gaspi_write(cd
+				   , data
+				   , dim2
+				   , buffer_id
+				   , i1
+				   );
 	}
     }
 }
@@ -289,30 +347,22 @@ void initiate_thread_comm_gaspi(RangeList *color
 static void allocate_thread_private_comm_data(comm_data *cd)
 {
   int j ;
-  /* thread private increments for send/recv counter */
-#pragma omp parallel default (none) shared(cd)
-  {
-    int j1;
-    inc_send_local = check_malloc(cd->ncommdomains * sizeof(int));
-    for(j1 = 0; j1 < cd->ncommdomains; j1++)
-      {	
-	inc_send_local[j1] = 0;
-      }
-  }
 
-  /* global increments for send/recv counter */
-  inc_send = check_malloc(cd->ncommdomains * sizeof(counter_t));
+  /* countdown latches per partner, all puts of an epoch */
+  send_latch = check_malloc_aligned(MAX(cd->ncommdomains, 1) * sizeof(countdown_latch));
   for(j = 0; j < cd->ncommdomains; j++)
     {
-      inc_send[j].global = 0;
+      init_latch(&(send_latch[j]));
     }
+  init_latch(&put_latch);
 
-
-    /* set num of thread private sendcounts */
+    /* set num of thread private sendcounts, countdowns and epochs */
 #pragma omp parallel default (none) shared(cd, stdout, stderr)
     {
       int i1;
       sendcount_local = check_malloc(cd->ncommdomains * sizeof(int));
+      remain_local = check_malloc(cd->ncommdomains * sizeof(int));
+      epoch_local = check_malloc(cd->ncommdomains * sizeof(uint32_t));
       for(i1 = 0; i1 < cd->ncommdomains; i1++)
 	{
 	  sendcount_local[i1] = 0;
@@ -329,43 +379,145 @@ static void allocate_thread_private_comm_data(comm_data *cd)
 	      sendcount_local[i3] += color->sendcount[i2];
 	    }
 	}
+
+      for(i1 = 0; i1 < cd->ncommdomains; i1++)
+	{
+	  remain_local[i1] = sendcount_local[i1];
+	  epoch_local[i1] = 0;
+	}
     }
 }
 
 
-void init_threads(comm_data *cd
-		  , solver_data *sd
-		  , int NTHREADS
-		  )
+static void free_thread_private_comm_data(void)
 {
-  int *pid = check_malloc(sd->nallpoints * sizeof(int));
-  int *htype = check_malloc(sd->nallpoints * sizeof(int));
+  check_free(send_latch);
+  send_latch = NULL;
+#pragma omp parallel default (none)
+  {
+    check_free(sendcount_local);
+    check_free(remain_local);
+    check_free(epoch_local);
+    sendcount_local = NULL;
+    remain_local = NULL;
+    epoch_local = NULL;
+  }
+}
 
-  /* meta data for threadprivate rangelist, reorder face data */
-  init_thread_meta_data(pid, htype, cd, sd, NTHREADS);
 
-  /* free old rangelist */
-  check_free(sd->fcolor->all_points_of_color);
-  check_free(sd->fcolor);
+/* thread rangelist, thread communication of the thread id per point pid */
+static void build_threads(comm_data *cd
+			  , solver_data *sd
+			  , int *pid
+			  , int *htype
+			  , int NTHREADS
+			  )
+{
+  /* faces per thread and face group */
+  face_buckets fb;
+  init_face_buckets(&fb, sd, pid, htype, NTHREADS);
+  startup_phase("face_buckets");
+
+  /* accumulation slots of the cross faces computed once */
+  if (get_cross_faces() == CROSS_BUFFER)
+    {
+      init_cross_buffers(sd, pid, NTHREADS);
+      startup_phase("cross_buffers");
+    }
 
   /* assign cross edge type, first/last points of color etc.*/
-#pragma omp parallel default (none) shared(pid, htype, cd, sd, stderr)
+#pragma omp parallel default (none) shared(pid, htype, cd, sd, fb, stderr)
   {
     int const tid = omp_get_thread_num();
-    init_thread_rangelist(cd, sd, tid, pid, htype);
+    init_thread_rangelist(cd, sd, tid, pid, htype, &fb);
   }
+  free_face_buckets(&fb);
+  startup_phase("thread_rangelist");
 
   /* init thread communication */
   init_thread_comm(cd, sd);
   allocate_thread_private_comm_data(cd);
+  startup_phase("thread_comm");
 
   /* sanity check */
   test_thread_rangelist(sd);
   eval_thread_comm(cd);
+  startup_phase("rangelist_check");
+}
+
+
+void init_threads(comm_data *cd
+		  , solver_data *sd
+		  , int NTHREADS
+		  )
+{
+  int *pid = check_malloc(sd->nallpoints * sizeof(int));
+  int *htype = check_malloc(sd->nallpoints * sizeof(int));
+
+  /* meta data for threadprivate rangelist, reorder face data */
+  init_thread_meta_data(pid, htype, cd, sd, NTHREADS);
+  startup_phase("thread_meta_data");
+
+  /* the preprocessed colors (sd->fcolor) are kept for rebalance_threads */
+  build_threads(cd, sd, pid, htype, NTHREADS);
+
+  thread_pid = pid;
+  check_free(htype);
+
+
+}
+
+
+void rebalance_threads(comm_data *cd
+		       , solver_data *sd
+		       , const double *rate
+		       )
+{
+  const int nthreads = omp_get_max_threads();
+  int *htype = check_malloc(sd->nallpoints * sizeof(int));
+  ASSERT(thread_pid != NULL);
+
+  /* the task tables refer to the old colors */
+  free_schedule();
+  free_dataflow();
+
+#pragma omp parallel default (none)
+  {
+    free_thread_rangelist();
+  }
+  free_thread_private_comm_data();
+
+  /* rates per point of the old thread ids */
+  set_thread_rates(sd, thread_pid, rate);
+  init_thread_meta_data(thread_pid, htype, cd, sd, nthreads);
+  build_threads(cd, sd, thread_pid, htype, nthreads);
 
-  check_free(pid);
   check_free(htype);
+}
+
+
+void rebuild_threads(comm_data *cd
+		     , solver_data *sd
+		     , int nfaces_in_color
+		     )
+{
+  ASSERT(thread_pid != NULL);
+  set_faces_in_color(nfaces_in_color);
+
+  /* the task tables refer to the old colors */
+  free_schedule();
+  free_dataflow();
+
+#pragma omp parallel default (none) shared(sd, thread_pid, stderr)
+  {
+    int const tid = omp_get_thread_num();
+    rebuild_thread_rangelist(sd, tid, thread_pid);
+  }
 
+  /* thread communication, per thread totals are unchanged */
+  init_thread_comm(cd, sd);
 
+  /* sanity check */
+  test_thread_rangelist(sd);
 }
 
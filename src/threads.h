@@ -21,6 +21,10 @@ void initiate_thread_comm_gaspi(RangeList *color
 				, int dim2
 				);
  
+void initiate_thread_comm_progress(RangeList *color
+				   , comm_data *cd
+				   );
+
 void initiate_thread_comm_mpifence(RangeList *color
 				   , comm_data *cd
 				   , double *data
@@ -40,9 +44,9 @@ int my_fetch_and_add(volatile int *ptr, int val);
 int this_is_the_first_thread(void);
 int this_is_the_last_thread(void);
 
-/* getter functions for global increments */
-int get_inc_send(int i);
-int set_inc_send(int i, int val);
+/* count points of commdomain i finalized by this thread, true for the 
+   thread which completes the halo send of the current epoch */
+bool thread_send_complete(comm_data *cd, int i, int count);
 
 /* getter functions for stage counters */
 int get_thread_stage(int i);
@@ -52,7 +56,6 @@ int  get_thread_stage_local(int i);
 void inc_thread_stage_local(int i, int val);
 
 int get_sendcount_local(int i);
-int set_inc_send_local(int i, int val);
 
 static __inline void _mm_pause (void)
 {
@@ -10,8 +10,11 @@
  *                 christian.simmendinger@t-systems.com
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include "error_handling.h"
 #include "solver_data.h"
@@ -39,6 +42,18 @@ void *check_malloc(size_t bytes)
 }
 
 
+/* cache line aligned, for SIMD loads and to avoid false sharing */
+void *check_malloc_aligned(size_t bytes)
+{
+  void *tmp = NULL;
+  ASSERT(bytes > 0);
+  int ret = posix_memalign(&tmp, 64, bytes);
+  ASSERT(ret == 0);
+  ASSERT(tmp != NULL);
+
+  return tmp;
+}
+
 
 void *check_realloc(void *old, size_t bytes)
 {
@@ -87,5 +102,50 @@ double now()
 }
 
 
+static int nstartup = 0;
+static const char *startup_name[MAX_STARTUP_PHASES];
+static double startup_time[MAX_STARTUP_PHASES];
+static double startup_clock = 0.0;
+
+/* a phase which is run again accumulates */
+void startup_phase(const char *name)
+{
+  const double t = now();
+  int i;
+  if (name != NULL)
+    {
+      i = 0;
+      while (i < nstartup && strcmp(startup_name[i], name) != 0)
+	{
+	  i++;
+	}
+      if (i == nstartup && nstartup < MAX_STARTUP_PHASES)
+	{
+	  startup_name[nstartup] = name;
+	  startup_time[nstartup] = 0.0;
+	  nstartup++;
+	}
+      if (i < nstartup)
+	{
+	  startup_time[i] += t - startup_clock;
+	}
+    }
+  startup_clock = t;
+}
+
+int get_startup_nphases(void)
+{
+  return nstartup;
+}
 
+const char* get_startup_phase_name(int i)
+{
+  ASSERT(i >= 0 && i < nstartup);
+  return startup_name[i];
+}
 
+double get_startup_phase_time(int i)
+{
+  ASSERT(i >= 0 && i < nstartup);
+  return startup_time[i];
+}
@@ -6,6 +6,7 @@
 
 void  check_free(void *ptr);
 void *check_malloc(size_t bytes);
+void *check_malloc_aligned(size_t bytes);
 void *check_realloc(void *old, size_t bytes);
 
 void sort_median(double *begin, double *end);
@@ -18,4 +19,16 @@ void sort_faces(int pm[]
 
 double now();
 
+/* startup time breakdown. Closes the current phase under name, the 
+   first call (name NULL) starts the clock */
+#define MAX_STARTUP_PHASES 32
+
+void startup_phase(const char *name);
+
+int get_startup_nphases(void);
+
+const char* get_startup_phase_name(int i);
+
+double get_startup_phase_time(int i);
+
 #endif